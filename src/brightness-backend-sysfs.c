@@ -0,0 +1,616 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "brightness-backend-sysfs.h"
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define DEFAULT_BACKLIGHT_DIR "/sys/class/backlight"
+
+#define LOGIND_BUS_NAME "org.freedesktop.login1"
+#define LOGIND_SESSION_PATH "/org/freedesktop/login1/session/auto"
+#define LOGIND_SESSION_IFACE "org.freedesktop.login1.Session"
+
+typedef struct
+{
+  char * name;
+  char * brightness_path;
+  char * actual_brightness_path;
+  int max_brightness;
+  int brightness;
+
+  GFileMonitor * brightness_monitor;
+  GFileMonitor * actual_brightness_monitor;
+
+  /* the kernel's own changes, e.g. from firmware hotkeys, don't show
+     up in a file monitor; they're signalled with POLLPRI instead */
+  int actual_brightness_fd;
+  guint actual_brightness_tag;
+
+  gboolean use_logind;
+  GCancellable * cancellable;
+  GDBusConnection * system_bus;
+
+  /* like IndicatorPowerBrightness, keep at most one SetBrightness
+     call in flight and only send the newest queued value */
+  gboolean write_in_flight;
+  gboolean have_queued_value;
+  int queued_value;
+}
+IndicatorPowerBrightnessBackendSysfsPrivate;
+
+typedef IndicatorPowerBrightnessBackendSysfsPrivate priv_t;
+
+#define get_priv(o) ((priv_t*)indicator_power_brightness_backend_sysfs_get_instance_private(o))
+
+/***
+****  GObject boilerplate
+***/
+
+static void indicator_power_brightness_backend_interface_init (
+                                IndicatorPowerBrightnessBackendInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+  IndicatorPowerBrightnessBackendSysfs,
+  indicator_power_brightness_backend_sysfs,
+  G_TYPE_OBJECT,
+  G_ADD_PRIVATE(IndicatorPowerBrightnessBackendSysfs)
+  G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND,
+                         indicator_power_brightness_backend_interface_init))
+
+/***
+****  sysfs helpers
+***/
+
+static gboolean
+read_int (const char * path, int * setme)
+{
+  gchar * contents = NULL;
+  gboolean success = FALSE;
+
+  if (g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      char * end = NULL;
+      const long val = strtol (contents, &end, 10);
+
+      if (end != contents)
+        {
+          *setme = (int) val;
+          success = TRUE;
+        }
+
+      g_free (contents);
+    }
+
+  return success;
+}
+
+/* When a machine has more than one backlight, prefer the one
+   that knows the most about the hardware, same as logind does */
+static int
+get_backlight_type_rank (const char * dir)
+{
+  gchar * path = g_build_filename (dir, "type", NULL);
+  gchar * type = NULL;
+  int rank = 0;
+
+  if (g_file_get_contents (path, &type, NULL, NULL))
+    {
+      g_strstrip (type);
+
+      if (!g_strcmp0 (type, "firmware"))
+        rank = 3;
+      else if (!g_strcmp0 (type, "platform"))
+        rank = 2;
+      else if (!g_strcmp0 (type, "raw"))
+        rank = 1;
+
+      g_free (type);
+    }
+
+  g_free (path);
+  return rank;
+}
+
+static gboolean
+probe (IndicatorPowerBrightnessBackendSysfs * self, const char * backlight_dir)
+{
+  priv_t * const p = get_priv (self);
+  GDir * dir;
+  const char * name;
+  gchar * best_name = NULL;
+  int best_rank = -1;
+  int best_max = 0;
+
+  if ((dir = g_dir_open (backlight_dir, 0, NULL)) == NULL)
+    return FALSE;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar * subdir = g_build_filename (backlight_dir, name, NULL);
+      gchar * path = g_build_filename (subdir, "max_brightness", NULL);
+      int max = 0;
+
+      if (read_int (path, &max) && (max > 0))
+        {
+          const int rank = get_backlight_type_rank (subdir);
+
+          /* break ties by name so the choice doesn't depend on readdir() */
+          if ((rank > best_rank) || ((rank == best_rank) && (g_strcmp0 (name, best_name) < 0)))
+            {
+              g_free (best_name);
+              best_name = g_strdup (name);
+              best_rank = rank;
+              best_max = max;
+            }
+        }
+
+      g_free (path);
+      g_free (subdir);
+    }
+
+  g_dir_close (dir);
+
+  if (best_name == NULL)
+    return FALSE;
+
+  p->name = best_name;
+  p->max_brightness = best_max;
+  p->brightness_path = g_build_filename (backlight_dir, best_name, "brightness", NULL);
+  p->actual_brightness_path = g_build_filename (backlight_dir, best_name, "actual_brightness", NULL);
+
+  /* some drivers don't provide actual_brightness */
+  if (!g_file_test (p->actual_brightness_path, G_FILE_TEST_EXISTS))
+    {
+      g_free (p->actual_brightness_path);
+      p->actual_brightness_path = g_strdup (p->brightness_path);
+    }
+
+  read_int (p->actual_brightness_path, &p->brightness);
+  g_debug ("using backlight '%s', brightness %d of %d", p->name, p->brightness, p->max_brightness);
+
+  return TRUE;
+}
+
+/***
+****  Watching for external changes
+***/
+
+static void
+update_brightness (IndicatorPowerBrightnessBackendSysfs * self, int brightness)
+{
+  priv_t * const p = get_priv (self);
+
+  if (brightness != p->brightness)
+    {
+      p->brightness = brightness;
+      indicator_power_brightness_backend_emit_changed (INDICATOR_POWER_BRIGHTNESS_BACKEND(self));
+    }
+}
+
+static void
+on_backlight_file_changed (GFileMonitor      * monitor    G_GNUC_UNUSED,
+                           GFile             * file       G_GNUC_UNUSED,
+                           GFile             * other_file G_GNUC_UNUSED,
+                           GFileMonitorEvent   event_type,
+                           gpointer            gself)
+{
+  IndicatorPowerBrightnessBackendSysfs * const self = INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(gself);
+  priv_t * const p = get_priv (self);
+  int brightness;
+
+  if ((event_type != G_FILE_MONITOR_EVENT_CHANGED) &&
+      (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT) &&
+      (event_type != G_FILE_MONITOR_EVENT_CREATED))
+    return;
+
+  if (read_int (p->actual_brightness_path, &brightness))
+    update_brightness (self, brightness);
+}
+
+/* sysfs_notify() wakes pollers with POLLPRI; reading from the start
+   of the same fd both gets the new value and rearms the notification */
+static gboolean
+read_actual_brightness_fd (int fd, int * setme)
+{
+  char buf[32];
+  char * end = NULL;
+  ssize_t n;
+  long val;
+
+  do
+    n = pread (fd, buf, sizeof(buf) - 1, 0);
+  while ((n == -1) && (errno == EINTR));
+
+  if (n <= 0)
+    return FALSE;
+
+  buf[n] = '\0';
+  val = strtol (buf, &end, 10);
+  if (end == buf)
+    return FALSE;
+
+  *setme = (int) val;
+  return TRUE;
+}
+
+static gboolean
+on_actual_brightness_notify (gint         fd,
+                             GIOCondition condition G_GNUC_UNUSED,
+                             gpointer     gself)
+{
+  int brightness;
+
+  if (read_actual_brightness_fd (fd, &brightness))
+    update_brightness (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(gself), brightness);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+watch_actual_brightness (IndicatorPowerBrightnessBackendSysfs * self)
+{
+  priv_t * const p = get_priv (self);
+  int brightness;
+
+  p->actual_brightness_fd = open (p->actual_brightness_path, O_RDONLY | O_CLOEXEC);
+  if (p->actual_brightness_fd == -1)
+    {
+      g_debug ("Unable to open '%s': %s", p->actual_brightness_path, g_strerror (errno));
+      return;
+    }
+
+  /* the first read arms it */
+  read_actual_brightness_fd (p->actual_brightness_fd, &brightness);
+  p->actual_brightness_tag = g_unix_fd_add (p->actual_brightness_fd,
+                                            G_IO_PRI | G_IO_ERR,
+                                            on_actual_brightness_notify,
+                                            self);
+}
+
+static GFileMonitor *
+create_monitor (IndicatorPowerBrightnessBackendSysfs * self, const char * path)
+{
+  GFile * file = g_file_new_for_path (path);
+  GError * error = NULL;
+  GFileMonitor * monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
+
+  if (monitor != NULL)
+    {
+      g_signal_connect (monitor, "changed", G_CALLBACK(on_backlight_file_changed), self);
+    }
+  else
+    {
+      g_debug ("Unable to monitor '%s': %s", path, error->message);
+      g_error_free (error);
+    }
+
+  g_object_unref (file);
+  return monitor;
+}
+
+/***
+****  Writing
+***/
+
+static void write_brightness (IndicatorPowerBrightnessBackendSysfs * self, int brightness);
+
+/* my_set_brightness() assumes the write will work, so when it doesn't,
+   the backlight file won't change and nothing else would correct it */
+static void
+resync_brightness (IndicatorPowerBrightnessBackendSysfs * self)
+{
+  priv_t * const p = get_priv (self);
+  int brightness;
+
+  if (read_int (p->actual_brightness_path, &brightness))
+    update_brightness (self, brightness);
+}
+
+static void
+write_brightness_to_sysfs (IndicatorPowerBrightnessBackendSysfs * self, int brightness)
+{
+  priv_t * const p = get_priv (self);
+  FILE * fp;
+
+  /* sysfs attributes must be written in place, so no g_file_set_contents() */
+  if ((fp = fopen (p->brightness_path, "w")) == NULL)
+    {
+      g_warning ("Unable to open '%s' for writing", p->brightness_path);
+      resync_brightness (self);
+      return;
+    }
+
+  fprintf (fp, "%d\n", brightness);
+  fclose (fp);
+}
+
+static void
+on_set_brightness_response (GObject      * bus,
+                            GAsyncResult * res,
+                            gpointer       gself)
+{
+  IndicatorPowerBrightnessBackendSysfs * self;
+  GError * error;
+  GVariant * v;
+  priv_t * p;
+  gboolean failed = FALSE;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish (G_DBUS_CONNECTION(bus), res, &error);
+  g_clear_pointer (&v, g_variant_unref);
+  if (error != NULL)
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_error_free (error);
+          return;
+        }
+
+      /* e.g. the session isn't active, or isn't allowed to */
+      g_warning ("Unable to call logind SetBrightness: %s", error->message);
+      g_error_free (error);
+      failed = TRUE;
+    }
+
+  self = INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(gself);
+  p = get_priv (self);
+  p->write_in_flight = FALSE;
+
+  if (p->have_queued_value)
+    {
+      p->have_queued_value = FALSE;
+      write_brightness (self, p->queued_value);
+    }
+  else if (failed)
+    {
+      resync_brightness (self);
+    }
+}
+
+static void
+write_brightness (IndicatorPowerBrightnessBackendSysfs * self, int brightness)
+{
+  priv_t * const p = get_priv (self);
+
+  if (!p->use_logind)
+    {
+      write_brightness_to_sysfs (self, brightness);
+      return;
+    }
+
+  /* queue it until the bus is ready or the previous call finishes */
+  if (p->write_in_flight || (p->system_bus == NULL))
+    {
+      p->queued_value = brightness;
+      p->have_queued_value = TRUE;
+      return;
+    }
+
+  p->write_in_flight = TRUE;
+  g_dbus_connection_call (p->system_bus,
+                          LOGIND_BUS_NAME,
+                          LOGIND_SESSION_PATH,
+                          LOGIND_SESSION_IFACE,
+                          "SetBrightness",
+                          g_variant_new ("(ssu)", "backlight", p->name, (guint32)brightness),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1, /* default timeout */
+                          p->cancellable,
+                          on_set_brightness_response,
+                          self);
+}
+
+static void
+on_system_bus_ready (GObject      * source_object G_GNUC_UNUSED,
+                     GAsyncResult * res,
+                     gpointer       gself)
+{
+  GError * error;
+  GDBusConnection * bus;
+
+  error = NULL;
+  bus = g_bus_get_finish (res, &error);
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Unable to get system bus: %s", error->message);
+
+      g_error_free (error);
+    }
+  else
+    {
+      priv_t * const p = get_priv (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(gself));
+
+      p->system_bus = bus;
+
+      if (p->have_queued_value)
+        {
+          p->have_queued_value = FALSE;
+          write_brightness (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(gself), p->queued_value);
+        }
+    }
+}
+
+/***
+****  IndicatorPowerBrightnessBackend virtual functions
+***/
+
+static gboolean
+my_get_range (IndicatorPowerBrightnessBackend * backend, int * min, int * max)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(backend));
+
+  *min = 0;
+  *max = p->max_brightness;
+  return p->max_brightness > 0;
+}
+
+static int
+my_get_brightness (IndicatorPowerBrightnessBackend * backend)
+{
+  return get_priv (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(backend))->brightness;
+}
+
+static void
+my_set_brightness (IndicatorPowerBrightnessBackend * backend, int brightness)
+{
+  IndicatorPowerBrightnessBackendSysfs * const self = INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(backend);
+  priv_t * const p = get_priv (self);
+
+  brightness = CLAMP (brightness, 0, p->max_brightness);
+
+  if (brightness == p->brightness && !p->write_in_flight)
+    return;
+
+  /* the file monitor will tell us if the hardware disagrees */
+  p->brightness = brightness;
+  write_brightness (self, brightness);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(o));
+
+  if (p->cancellable != NULL)
+    {
+      g_cancellable_cancel (p->cancellable);
+      g_clear_object (&p->cancellable);
+    }
+
+  if (p->brightness_monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->brightness_monitor, o);
+      g_clear_object (&p->brightness_monitor);
+    }
+
+  if (p->actual_brightness_monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->actual_brightness_monitor, o);
+      g_clear_object (&p->actual_brightness_monitor);
+    }
+
+  if (p->actual_brightness_tag != 0)
+    {
+      g_source_remove (p->actual_brightness_tag);
+      p->actual_brightness_tag = 0;
+    }
+
+  if (p->actual_brightness_fd != -1)
+    {
+      close (p->actual_brightness_fd);
+      p->actual_brightness_fd = -1;
+    }
+
+  g_clear_object (&p->system_bus);
+
+  G_OBJECT_CLASS (indicator_power_brightness_backend_sysfs_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(o));
+
+  g_free (p->name);
+  g_free (p->brightness_path);
+  g_free (p->actual_brightness_path);
+
+  G_OBJECT_CLASS (indicator_power_brightness_backend_sysfs_parent_class)->finalize (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_brightness_backend_sysfs_class_init (IndicatorPowerBrightnessBackendSysfsClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+}
+
+static void
+indicator_power_brightness_backend_interface_init (IndicatorPowerBrightnessBackendInterface * iface)
+{
+  iface->get_range = my_get_range;
+  iface->get_brightness = my_get_brightness;
+  iface->set_brightness = my_set_brightness;
+}
+
+static void
+indicator_power_brightness_backend_sysfs_init (IndicatorPowerBrightnessBackendSysfs * self)
+{
+  priv_t * const p = get_priv (self);
+
+  p->cancellable = g_cancellable_new ();
+  p->actual_brightness_fd = -1;
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerBrightnessBackend *
+indicator_power_brightness_backend_sysfs_new (const char * backlight_dir,
+                                              gboolean     use_logind)
+{
+  IndicatorPowerBrightnessBackendSysfs * self;
+  priv_t * p;
+
+  self = g_object_new (INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND_SYSFS, NULL);
+  p = get_priv (self);
+
+  if (!probe (self, backlight_dir != NULL ? backlight_dir : DEFAULT_BACKLIGHT_DIR))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  p->brightness_monitor = create_monitor (self, p->brightness_path);
+  if (g_strcmp0 (p->brightness_path, p->actual_brightness_path))
+    p->actual_brightness_monitor = create_monitor (self, p->actual_brightness_path);
+  watch_actual_brightness (self);
+
+  p->use_logind = use_logind;
+  if (use_logind)
+    g_bus_get (G_BUS_TYPE_SYSTEM, p->cancellable, on_system_bus_ready, self);
+
+  return INDICATOR_POWER_BRIGHTNESS_BACKEND (self);
+}
+
+const char *
+indicator_power_brightness_backend_sysfs_get_name (IndicatorPowerBrightnessBackendSysfs * self)
+{
+  g_return_val_if_fail (INDICATOR_IS_POWER_BRIGHTNESS_BACKEND_SYSFS(self), NULL);
+
+  return get_priv (self)->name;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS__H__
+#define __INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS__H__
+
+#include <glib-object.h> /* parent class */
+
+#include "brightness-backend.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND_SYSFS \
+  (indicator_power_brightness_backend_sysfs_get_type())
+
+#define INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+                               INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND_SYSFS, \
+                               IndicatorPowerBrightnessBackendSysfs))
+
+#define INDICATOR_IS_POWER_BRIGHTNESS_BACKEND_SYSFS(o) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+                               INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND_SYSFS))
+
+typedef struct _IndicatorPowerBrightnessBackendSysfs
+                IndicatorPowerBrightnessBackendSysfs;
+typedef struct _IndicatorPowerBrightnessBackendSysfsClass
+                IndicatorPowerBrightnessBackendSysfsClass;
+
+/**
+ * An IndicatorPowerBrightnessBackend which reads the backlight
+ * from /sys/class/backlight and writes it through logind.
+ */
+struct _IndicatorPowerBrightnessBackendSysfs
+{
+  GObject parent_instance;
+};
+
+struct _IndicatorPowerBrightnessBackendSysfsClass
+{
+  GObjectClass parent_class;
+};
+
+GType indicator_power_brightness_backend_sysfs_get_type (void);
+
+/**
+ * Looks for a backlight in backlight_dir, or in /sys/class/backlight if NULL.
+ *
+ * If use_logind is TRUE, new values are written with logind's
+ * Session.SetBrightness(); otherwise they're written to sysfs directly.
+ *
+ * Returns NULL if no usable backlight was found.
+ */
+IndicatorPowerBrightnessBackend * indicator_power_brightness_backend_sysfs_new (const char * backlight_dir,
+                                                                                gboolean     use_logind);
+
+const char * indicator_power_brightness_backend_sysfs_get_name (IndicatorPowerBrightnessBackendSysfs * self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS__H__ */
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "brightness-backend.h"
+
+enum
+{
+  SIGNAL_CHANGED,
+  SIGNAL_LAST
+};
+
+static guint signals[SIGNAL_LAST] = { 0 };
+
+G_DEFINE_INTERFACE (IndicatorPowerBrightnessBackend,
+                    indicator_power_brightness_backend,
+                    0)
+
+static void
+indicator_power_brightness_backend_default_init (IndicatorPowerBrightnessBackendInterface * klass)
+{
+  signals[SIGNAL_CHANGED] = g_signal_new (
+      "changed",
+      G_TYPE_FROM_CLASS(klass),
+      G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (IndicatorPowerBrightnessBackendInterface, changed),
+      NULL, NULL,
+      g_cclosure_marshal_VOID__VOID,
+      G_TYPE_NONE, 0);
+}
+
+/***
+****  PUBLIC API
+***/
+
+/**
+ * Get the range of raw brightness values the backlight accepts.
+ *
+ * Return value: FALSE if the range isn't known (yet)
+ */
+gboolean
+indicator_power_brightness_backend_get_range (IndicatorPowerBrightnessBackend * self,
+                                              int                             * min,
+                                              int                             * max)
+{
+  IndicatorPowerBrightnessBackendInterface * iface;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_BRIGHTNESS_BACKEND (self), FALSE);
+  iface = INDICATOR_POWER_BRIGHTNESS_BACKEND_GET_INTERFACE (self);
+
+  if (iface->get_range != NULL)
+    return iface->get_range (self, min, max);
+
+  return FALSE;
+}
+
+/**
+ * Get the backlight's current raw brightness.
+ */
+int
+indicator_power_brightness_backend_get_brightness (IndicatorPowerBrightnessBackend * self)
+{
+  IndicatorPowerBrightnessBackendInterface * iface;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_BRIGHTNESS_BACKEND (self), 0);
+  iface = INDICATOR_POWER_BRIGHTNESS_BACKEND_GET_INTERFACE (self);
+
+  if (iface->get_brightness != NULL)
+    return iface->get_brightness (self);
+
+  return 0;
+}
+
+/**
+ * Ask the backlight to change its raw brightness.
+ *
+ * This may be asynchronous; "changed" is emitted
+ * if the new value differs from what was requested.
+ */
+void
+indicator_power_brightness_backend_set_brightness (IndicatorPowerBrightnessBackend * self,
+                                                   int                               brightness)
+{
+  IndicatorPowerBrightnessBackendInterface * iface;
+
+  g_return_if_fail (INDICATOR_IS_POWER_BRIGHTNESS_BACKEND (self));
+  iface = INDICATOR_POWER_BRIGHTNESS_BACKEND_GET_INTERFACE (self);
+
+  if (iface->set_brightness != NULL)
+    iface->set_brightness (self, brightness);
+}
+
+/**
+ * Emits the "changed" signal.
+ *
+ * This should only be called by subclasses.
+ */
+void
+indicator_power_brightness_backend_emit_changed (IndicatorPowerBrightnessBackend * self)
+{
+  g_return_if_fail (INDICATOR_IS_POWER_BRIGHTNESS_BACKEND (self));
+
+  g_signal_emit (self, signals[SIGNAL_CHANGED], 0, NULL);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_BRIGHTNESS_BACKEND__H__
+#define __INDICATOR_POWER_BRIGHTNESS_BACKEND__H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND \
+  (indicator_power_brightness_backend_get_type ())
+
+#define INDICATOR_POWER_BRIGHTNESS_BACKEND(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+                               INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND, \
+                               IndicatorPowerBrightnessBackend))
+
+#define INDICATOR_IS_POWER_BRIGHTNESS_BACKEND(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND))
+
+#define INDICATOR_POWER_BRIGHTNESS_BACKEND_GET_INTERFACE(inst) \
+  (G_TYPE_INSTANCE_GET_INTERFACE ((inst), \
+                                  INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND, \
+                                  IndicatorPowerBrightnessBackendInterface))
+
+typedef struct _IndicatorPowerBrightnessBackend
+                IndicatorPowerBrightnessBackend;
+
+typedef struct _IndicatorPowerBrightnessBackendInterface
+                IndicatorPowerBrightnessBackendInterface;
+
+/**
+ * An interface class for an object that reads and writes
+ * the raw brightness of a display's backlight.
+ *
+ * IndicatorPowerBrightness talks to powerd and Unity.Screen unless
+ * it's given one of these, in which case it uses the backend instead.
+ */
+struct _IndicatorPowerBrightnessBackendInterface
+{
+  GTypeInterface parent_iface;
+
+  /* signals */
+  void (*changed) (IndicatorPowerBrightnessBackend * self);
+
+  /* virtual functions */
+  gboolean (*get_range)      (IndicatorPowerBrightnessBackend * self, int * min, int * max);
+  int      (*get_brightness) (IndicatorPowerBrightnessBackend * self);
+  void     (*set_brightness) (IndicatorPowerBrightnessBackend * self, int brightness);
+};
+
+GType indicator_power_brightness_backend_get_type (void);
+
+/***
+****
+***/
+
+gboolean indicator_power_brightness_backend_get_range      (IndicatorPowerBrightnessBackend * self,
+                                                            int                             * min,
+                                                            int                             * max);
+
+int      indicator_power_brightness_backend_get_brightness (IndicatorPowerBrightnessBackend * self);
+
+void     indicator_power_brightness_backend_set_brightness (IndicatorPowerBrightnessBackend * self,
+                                                            int                               brightness);
+
+void     indicator_power_brightness_backend_emit_changed   (IndicatorPowerBrightnessBackend * self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_BRIGHTNESS_BACKEND__H__ */
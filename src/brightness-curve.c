@@ -0,0 +1,190 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "brightness-curve.h"
+
+#include <math.h> /* pow(), cbrt() */
+
+/* Panels with up to this many raw levels get one table entry per level,
+   which makes brightness -> percentage -> brightness lossless.
+   Bigger ranges are sampled and linearly interpolated. */
+#define MAX_KNOTS 4096
+
+/* resolution of the percentage -> brightness table */
+#define N_STEPS 1024
+
+struct _IndicatorPowerBrightnessCurve
+{
+  int min;
+  int max;
+
+  /* percentage[i] is the slider position for raw brightness
+     min + i*(max-min)/(n_knots-1) */
+  int n_knots;
+  double * percentage;
+
+  /* brightness[i] is the lowest raw brightness whose
+     percentage is at least i/N_STEPS */
+  int brightness[N_STEPS+1];
+};
+
+/***
+****  The curves: relative luminance -> perceived lightness, both in [0..1]
+***/
+
+static double
+luminance_to_lightness (IndicatorPowerBrightnessCurveType type,
+                        double                            gamma,
+                        double                            y)
+{
+  switch (type)
+    {
+      case INDICATOR_POWER_BRIGHTNESS_CURVE_GAMMA:
+        return pow (y, 1.0/gamma);
+
+      case INDICATOR_POWER_BRIGHTNESS_CURVE_CIE_LIGHTNESS:
+        /* CIE 1976 L*, scaled from [0..100] */
+        if (y <= 216.0/24389.0)
+          return y * (24389.0/27.0) / 100.0;
+        return (116.0 * cbrt (y) - 16.0) / 100.0;
+
+      default:
+        return y;
+    }
+}
+
+/***
+****  Lookups
+***/
+
+static double
+knot_to_percentage (const IndicatorPowerBrightnessCurve * curve, int brightness)
+{
+  const double pos = (brightness - curve->min) * (double)(curve->n_knots - 1) / (curve->max - curve->min);
+  const int i = (int) pos;
+
+  if (i >= curve->n_knots - 1)
+    return curve->percentage[curve->n_knots - 1];
+
+  return curve->percentage[i] + (pos - i) * (curve->percentage[i+1] - curve->percentage[i]);
+}
+
+double
+indicator_power_brightness_curve_to_percentage (const IndicatorPowerBrightnessCurve * curve,
+                                                int                                   brightness)
+{
+  g_return_val_if_fail (curve != NULL, 0.0);
+
+  if (brightness <= curve->min)
+    return 0.0;
+  if (brightness >= curve->max)
+    return 1.0;
+
+  return knot_to_percentage (curve, brightness);
+}
+
+int
+indicator_power_brightness_curve_to_brightness (const IndicatorPowerBrightnessCurve * curve,
+                                                double                                percentage)
+{
+  int i;
+  int lo;
+  int hi;
+
+  g_return_val_if_fail (curve != NULL, 0);
+
+  if (!(percentage > 0.0))
+    return curve->min;
+  if (percentage >= 1.0)
+    return curve->max;
+
+  /* the table narrows it down to one step's worth of raw levels... */
+  i = (int)(percentage * N_STEPS);
+  lo = i > 0 ? curve->brightness[i] - 1 : curve->min;
+  hi = curve->brightness[i+1];
+
+  /* ...then find the last level at or below the percentage */
+  while (hi - lo > 1)
+    {
+      const int mid = lo + (hi - lo) / 2;
+
+      if (knot_to_percentage (curve, mid) <= percentage)
+        lo = mid;
+      else
+        hi = mid;
+    }
+
+  /* and round to whichever neighbour is closer */
+  if ((hi <= curve->max) &&
+      (knot_to_percentage (curve, hi) - percentage < percentage - knot_to_percentage (curve, lo)))
+    return hi;
+
+  return MAX (lo, curve->min);
+}
+
+/***
+****  Instantiation
+***/
+
+IndicatorPowerBrightnessCurve *
+indicator_power_brightness_curve_new (IndicatorPowerBrightnessCurveType type,
+                                      double                            gamma,
+                                      int                               min,
+                                      int                               max)
+{
+  IndicatorPowerBrightnessCurve * curve;
+  int i;
+  int b;
+
+  g_return_val_if_fail (min < max, NULL);
+
+  if (!(gamma > 0.0))
+    gamma = 1.0;
+
+  curve = g_new0 (IndicatorPowerBrightnessCurve, 1);
+  curve->min = min;
+  curve->max = max;
+  curve->n_knots = MIN (max - min, MAX_KNOTS) + 1;
+  curve->percentage = g_new (double, curve->n_knots);
+
+  for (i=0; i<curve->n_knots; ++i)
+    {
+      const double y = i / (double)(curve->n_knots - 1);
+      curve->percentage[i] = luminance_to_lightness (type, gamma, y);
+    }
+
+  for (i=0, b=min; i<=N_STEPS; ++i)
+    {
+      const double target = i / (double)N_STEPS;
+
+      while ((b < max) && (knot_to_percentage (curve, b) < target))
+        ++b;
+
+      curve->brightness[i] = b;
+    }
+
+  return curve;
+}
+
+void
+indicator_power_brightness_curve_free (IndicatorPowerBrightnessCurve * curve)
+{
+  if (curve != NULL)
+    {
+      g_free (curve->percentage);
+      g_free (curve);
+    }
+}
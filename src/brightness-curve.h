@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDICATOR_POWER_BRIGHTNESS_CURVE__H
+#define INDICATOR_POWER_BRIGHTNESS_CURVE__H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  INDICATOR_POWER_BRIGHTNESS_CURVE_LINEAR,
+  INDICATOR_POWER_BRIGHTNESS_CURVE_GAMMA,
+  INDICATOR_POWER_BRIGHTNESS_CURVE_CIE_LIGHTNESS
+}
+IndicatorPowerBrightnessCurveType;
+
+/**
+ * Maps between a slider percentage and a backlight's raw brightness.
+ *
+ * The curve is sampled into lookup tables when it's created,
+ * so the conversions are cheap enough for the slider's hot path.
+ */
+typedef struct _IndicatorPowerBrightnessCurve IndicatorPowerBrightnessCurve;
+
+/* gamma is only used by INDICATOR_POWER_BRIGHTNESS_CURVE_GAMMA */
+IndicatorPowerBrightnessCurve * indicator_power_brightness_curve_new (IndicatorPowerBrightnessCurveType type,
+                                                                      double                            gamma,
+                                                                      int                               min,
+                                                                      int                               max);
+
+void   indicator_power_brightness_curve_free          (IndicatorPowerBrightnessCurve * curve);
+
+double indicator_power_brightness_curve_to_percentage (const IndicatorPowerBrightnessCurve * curve,
+                                                       int                                   brightness);
+
+int    indicator_power_brightness_curve_to_brightness (const IndicatorPowerBrightnessCurve * curve,
+                                                       double                                percentage);
+
+G_END_DECLS
+
+#endif /* INDICATOR_POWER_BRIGHTNESS_CURVE__H */
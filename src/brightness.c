@@ -18,6 +18,8 @@
  */
 
 #include "brightness.h"
+#include "brightness-backend.h"
+#include "brightness-curve.h"
 #include "dbus-powerd.h"
 
 #include <gio/gio.h>
@@ -28,12 +30,26 @@
 #define KEY_BRIGHTNESS "brightness"
 #define KEY_NEED_DEFAULT "brightness-needs-hardware-default"
 
+#define INDICATOR_SCHEMA_NAME "org.ayatana.indicator.power"
+#define KEY_CURVE "brightness-curve"
+#define KEY_GAMMA "brightness-gamma"
+#define KEY_RAMP_DURATION "brightness-ramp-duration"
+#define KEY_RAMP_RATE "brightness-ramp-rate"
+
+/* ramping defaults, used if our schema isn't installed */
+#define DEFAULT_RAMP_DURATION_MSEC 200
+#define DEFAULT_RAMP_RATE 60
+
+/* how long the brightness must stay put before we save it to GSettings */
+#define PERSIST_DELAY_MSEC 500
+
 enum
 {
   PROP_0,
   PROP_PERCENTAGE,
   PROP_AUTO,
   PROP_AUTO_SUPPORTED,
+  PROP_BACKEND,
   LAST_PROP
 };
 
@@ -46,6 +62,25 @@ typedef struct
 
   GSettings * settings;
 
+  /* our own settings: the curve and the ramp */
+  GSettings * indicator_settings;
+
+  /* maps between slider percentages and raw brightness */
+  IndicatorPowerBrightnessCurve * curve;
+
+  /* ramping from one brightness to another. The last value
+     written is ramp_from until the first step is written. */
+  guint ramp_tag;
+  int ramp_from;
+  int ramp_to;
+  gint64 ramp_start_usec;
+  gint64 ramp_duration_usec;
+  gboolean have_last_written;
+  int last_written;
+
+  /* if set, used instead of powerd and Unity.Screen */
+  IndicatorPowerBrightnessBackend * backend;
+
   DbusPowerd * powerd_proxy;
   char * powerd_name_owner;
 
@@ -58,6 +93,18 @@ typedef struct
   gint powerd_default_value;
   gboolean powerd_ab_supported;
   gboolean have_powerd_params;
+
+  /* brightness writes: at most one setUserBrightness call is in flight.
+     While it's pending, newer values replace each other in queued_value
+     and only the latest one gets sent. */
+  gboolean write_in_flight;
+  gboolean have_queued_value;
+  int queued_value;
+  guint dropped_writes;
+
+  /* GSettings persistence waits until the value settles */
+  guint persist_tag;
+  int persist_value;
 }
 IndicatorPowerBrightnessPrivate;
 
@@ -96,6 +143,10 @@ my_get_property(GObject     * o,
         g_value_set_boolean(value, p->powerd_ab_supported);
         break;
 
+      case PROP_BACKEND:
+        g_value_set_object(value, p->backend);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(o, property_id, pspec);
     }
@@ -121,29 +172,66 @@ my_set_property(GObject       * o,
           g_settings_set_boolean (p->settings, KEY_AUTO, g_value_get_boolean(value));
         break;
 
+      case PROP_BACKEND:
+        p->backend = g_value_dup_object(value);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(o, property_id, pspec);
     }
 }
 
+static void persist_brightness_now(IndicatorPowerBrightness*);
+static void write_brightness(IndicatorPowerBrightness*, int);
+static void flush_uscreen_user_brightness(IndicatorPowerBrightness*);
+
 static void
 my_dispose(GObject * o)
 {
   IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(o);
   priv_t * p = get_priv(self);
 
+  /* don't leave the backlight halfway through a ramp... */
+  if (p->ramp_tag != 0)
+    {
+      g_source_remove(p->ramp_tag);
+      p->ramp_tag = 0;
+      write_brightness(self, p->ramp_to);
+    }
+
+  /* ...or lose a value that hasn't been saved yet */
+  if (p->persist_tag != 0)
+    persist_brightness_now(self);
+
   if (p->cancellable != NULL)
     {
       g_cancellable_cancel(p->cancellable);
       g_clear_object(&p->cancellable);
     }
 
+  /* the ramp's last value may be waiting behind a write
+     that just got cancelled, so send it on its own */
+  flush_uscreen_user_brightness(self);
+
   if (p->powerd_proxy != NULL)
     {
       g_signal_handlers_disconnect_by_data(p->powerd_proxy, o);
       g_clear_object(&p->powerd_proxy);
     }
 
+  if (p->backend != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->backend, o);
+      g_clear_object(&p->backend);
+    }
+
+  if (p->indicator_settings != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->indicator_settings, o);
+      g_clear_object(&p->indicator_settings);
+    }
+
+  g_clear_pointer(&p->curve, indicator_power_brightness_curve_free);
   g_clear_object(&p->settings);
   g_clear_object(&p->system_bus);
   g_clear_pointer(&p->powerd_name_owner, g_free);
@@ -155,46 +243,68 @@ my_dispose(GObject * o)
 ****  Percentage <-> Brightness Int conversion helpers
 ***/
 
-static gdouble
-brightness_to_percentage(IndicatorPowerBrightness * self, int brightness)
+static gboolean
+get_brightness_range(IndicatorPowerBrightness * self, int * lo, int * hi)
 {
-  const priv_t * p;
-  gdouble percentage;
+  const priv_t * p = get_priv(self);
+
+  if (p->backend != NULL)
+    return indicator_power_brightness_backend_get_range(p->backend, lo, hi) && (*lo < *hi);
 
-  p = get_priv(self);
   if (p->have_powerd_params)
     {
-      const int lo = p->powerd_min;
-      const int hi = p->powerd_max;
-      percentage = (brightness-lo) / (double)(hi-lo);
+      *lo = p->powerd_min;
+      *hi = p->powerd_max;
+      return TRUE;
     }
-  else
+
+  return FALSE;
+}
+
+/* Rebuild the lookup tables whenever the range or the curve changes,
+   so that the conversions below are just table lookups */
+static void
+update_curve(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+  IndicatorPowerBrightnessCurveType type = INDICATOR_POWER_BRIGHTNESS_CURVE_LINEAR;
+  double gamma = 1.0;
+  int lo, hi;
+
+  g_clear_pointer(&p->curve, indicator_power_brightness_curve_free);
+
+  if (!get_brightness_range(self, &lo, &hi) || (lo >= hi))
+    return;
+
+  if (p->indicator_settings != NULL)
     {
-      percentage = 0;
+      type = g_settings_get_enum(p->indicator_settings, KEY_CURVE);
+      gamma = g_settings_get_double(p->indicator_settings, KEY_GAMMA);
     }
 
-  return percentage;
+  p->curve = indicator_power_brightness_curve_new(type, gamma, lo, hi);
+}
+
+static gdouble
+brightness_to_percentage(IndicatorPowerBrightness * self, int brightness)
+{
+  const priv_t * p = get_priv(self);
+
+  if (p->curve == NULL)
+    return 0;
+
+  return indicator_power_brightness_curve_to_percentage(p->curve, brightness);
 }
 
 static int
 percentage_to_brightness(IndicatorPowerBrightness * self, double percentage)
 {
-  const priv_t * p;
-  int brightness;
+  const priv_t * p = get_priv(self);
 
-  p = get_priv(self);
-  if (p->have_powerd_params)
-    {
-      const int lo = p->powerd_min;
-      const int hi = p->powerd_max;
-      brightness = (int)(lo + (percentage*(hi-lo)));
-    }
-  else
-    {
-      brightness = 0;
-    }
+  if (p->curve == NULL)
+    return 0;
 
-  return brightness;
+  return indicator_power_brightness_curve_to_brightness(p->curve, percentage);
 }
 
 /**
@@ -236,6 +346,8 @@ on_powerd_brightness_params_ready(GObject      * oproxy,
               p->powerd_default_value,
               (int)p->powerd_ab_supported);
  
+      update_curve(self);
+
       if (old_ab_supported != p->powerd_ab_supported)
         g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_AUTO_SUPPORTED]);
 
@@ -279,6 +391,7 @@ on_powerd_name_owner_changed(GDBusProxy * powerd_proxy,
   if (g_strcmp0(p->powerd_name_owner, owner))
     {
       p->have_powerd_params = FALSE;
+      update_curve(INDICATOR_POWER_BRIGHTNESS(gself));
 
       if (owner != NULL)
         {
@@ -298,6 +411,10 @@ on_powerd_brightness_changed(DbusPowerd * powerd_proxy,
                              GParamSpec * pspec         G_GNUC_UNUSED,
                              gpointer     gself)
 {
+  /* don't let a ramp's intermediate steps move the slider */
+  if (get_priv(INDICATOR_POWER_BRIGHTNESS(gself))->ramp_tag != 0)
+    return;
+
   set_brightness_local(gself, dbus_powerd_get_brightness(powerd_proxy));
 }
 
@@ -344,27 +461,42 @@ on_powerd_proxy_ready(GObject      * source_object G_GNUC_UNUSED,
  * Used to set the backlight brightness via setUserBrightness
  */
 
-/* setUserBrightness doesn't return anything,
-   so this function is just to check for bus error messages */
+static void set_uscreen_user_brightness(IndicatorPowerBrightness*, int);
+
+/* setUserBrightness doesn't return anything, so this function
+   checks for bus error messages and sends the next queued value */
 static void
 on_set_uscreen_user_brightness_result(GObject      * system_bus,
                                       GAsyncResult * res,
-                                      gpointer       gself        G_GNUC_UNUSED)
+                                      gpointer       gself)
 {
   GError * error;
   GVariant * v;
+  priv_t * p;
 
   error = NULL;
   v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(system_bus), res, &error);
+  g_clear_pointer(&v, g_variant_unref);
   if (error != NULL)
     {
-      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        g_warning("Unable to call uscreen.setBrightness: %s", error->message);
+      if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_error_free(error);
+          return;
+        }
 
+      g_warning("Unable to call uscreen.setBrightness: %s", error->message);
       g_error_free(error);
     }
 
-  g_clear_pointer(&v, g_variant_unref);
+  p = get_priv(INDICATOR_POWER_BRIGHTNESS(gself));
+  p->write_in_flight = FALSE;
+
+  if (p->have_queued_value)
+    {
+      p->have_queued_value = FALSE;
+      set_uscreen_user_brightness(INDICATOR_POWER_BRIGHTNESS(gself), p->queued_value);
+    }
 }
 
 static void
@@ -373,6 +505,23 @@ set_uscreen_user_brightness(IndicatorPowerBrightness * self,
 {
   priv_t * p = get_priv(self);
 
+  if (p->write_in_flight)
+    {
+      if (p->have_queued_value)
+        p->dropped_writes++;
+
+      p->queued_value = value;
+      p->have_queued_value = TRUE;
+      return;
+    }
+
+  if (p->system_bus == NULL)
+    {
+      g_debug("No system bus yet; not sending brightness %d", value);
+      return;
+    }
+
+  p->write_in_flight = TRUE;
   g_dbus_connection_call(p->system_bus,
                          "com.canonical.Unity.Screen",
                          "/com/canonical/Unity/Screen",
@@ -387,6 +536,31 @@ set_uscreen_user_brightness(IndicatorPowerBrightness * self,
                          self);
 }
 
+/* Sends the queued value with no cancellable and no reply handler,
+   for when we're going away and can't wait for the in-flight write */
+static void
+flush_uscreen_user_brightness(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (!p->have_queued_value || (p->system_bus == NULL))
+    return;
+
+  p->have_queued_value = FALSE;
+  g_dbus_connection_call(p->system_bus,
+                         "com.canonical.Unity.Screen",
+                         "/com/canonical/Unity/Screen",
+                         "com.canonical.Unity.Screen",
+                         "setUserBrightness",
+                         g_variant_new("(i)", p->queued_value),
+                         NULL, /* no return args */
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1, /* default timeout */
+                         NULL,
+                         NULL,
+                         NULL);
+}
+
 /***
 ****
 ***/
@@ -408,17 +582,136 @@ on_brightness_changed_in_schema(GSettings * settings,
                        g_settings_get_int(settings, key));
 }
 
+static void
+persist_brightness_now(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (p->persist_tag != 0)
+    {
+      g_source_remove(p->persist_tag);
+      p->persist_tag = 0;
+    }
+
+  if ((p->settings != NULL) && (g_settings_get_int(p->settings, KEY_BRIGHTNESS) != p->persist_value))
+    g_settings_set_int(p->settings, KEY_BRIGHTNESS, p->persist_value);
+
+  if (p->dropped_writes > 0)
+    g_debug("brightness settled at %d; %u intermediate writes dropped so far", p->persist_value, p->dropped_writes);
+}
+
+static gboolean
+on_persist_timer(gpointer gself)
+{
+  IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(gself);
+
+  get_priv(self)->persist_tag = 0;
+  persist_brightness_now(self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/***
+****  Ramping
+***/
+
+static void
+write_brightness(IndicatorPowerBrightness * self, int brightness)
+{
+  priv_t * p = get_priv(self);
+
+  p->last_written = brightness;
+  p->have_last_written = TRUE;
+
+  if (p->backend != NULL)
+    indicator_power_brightness_backend_set_brightness(p->backend, brightness);
+  else
+    set_uscreen_user_brightness(self, brightness);
+}
+
+static gboolean
+on_ramp_timer(gpointer gself)
+{
+  IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(gself);
+  priv_t * p = get_priv(self);
+  const gint64 elapsed = g_get_monotonic_time() - p->ramp_start_usec;
+  int brightness;
+
+  if (elapsed >= p->ramp_duration_usec)
+    {
+      p->ramp_tag = 0;
+      write_brightness(self, p->ramp_to);
+      return G_SOURCE_REMOVE;
+    }
+
+  brightness = p->ramp_from + (int)(((gint64)(p->ramp_to - p->ramp_from) * elapsed) / p->ramp_duration_usec);
+  if (brightness != p->last_written)
+    write_brightness(self, brightness);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Move the backlight to brightness over brightness-ramp-duration,
+   writing at most brightness-ramp-rate times per second.
+   If a ramp is already running, it's retargeted from wherever it is now. */
+static void
+ramp_brightness(IndicatorPowerBrightness * self, int brightness)
+{
+  priv_t * p = get_priv(self);
+  guint duration_msec = DEFAULT_RAMP_DURATION_MSEC;
+  guint rate = DEFAULT_RAMP_RATE;
+
+  if (p->indicator_settings != NULL)
+    {
+      duration_msec = g_settings_get_uint(p->indicator_settings, KEY_RAMP_DURATION);
+      rate = g_settings_get_uint(p->indicator_settings, KEY_RAMP_RATE);
+    }
+
+  /* jump if ramping's disabled or we don't know where we're starting from */
+  if ((duration_msec == 0) || (rate == 0) || !p->have_last_written || (p->last_written == brightness))
+    {
+      if (p->ramp_tag != 0)
+        {
+          g_source_remove(p->ramp_tag);
+          p->ramp_tag = 0;
+        }
+
+      if (!p->have_last_written || (p->last_written != brightness))
+        write_brightness(self, brightness);
+      return;
+    }
+
+  p->ramp_from = p->last_written;
+  p->ramp_to = brightness;
+  p->ramp_start_usec = g_get_monotonic_time();
+  p->ramp_duration_usec = duration_msec * G_GINT64_CONSTANT(1000);
+
+  if (p->ramp_tag == 0)
+    p->ramp_tag = g_timeout_add(MAX(1000u / rate, 1u), on_ramp_timer, self);
+}
+
+/***
+****
+***/
+
 static void
 set_brightness_global(IndicatorPowerBrightness * self, int brightness)
 {
   priv_t * p = get_priv(self);
 
-  set_uscreen_user_brightness(self, brightness);
+  ramp_brightness(self, brightness);
+
+  /* update our state now, but wait for the value to settle before saving */
+  set_brightness_local(self, brightness);
 
   if (p->settings != NULL)
-    g_settings_set_int(p->settings, KEY_BRIGHTNESS, brightness);
-  else
-    set_brightness_local(self, brightness);
+    {
+      p->persist_value = brightness;
+
+      if (p->persist_tag != 0)
+        g_source_remove(p->persist_tag);
+      p->persist_tag = g_timeout_add(PERSIST_DELAY_MSEC, on_persist_timer, self);
+    }
 }
 
 static void
@@ -427,6 +720,32 @@ on_auto_changed_in_schema(IndicatorPowerBrightness * self)
   g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_AUTO]);
 }
 
+static void
+on_curve_changed_in_schema(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  update_curve(self);
+
+  /* same raw brightness, different slider position */
+  if (p->backend != NULL)
+    set_brightness_local(self, indicator_power_brightness_backend_get_brightness(p->backend));
+  else if (p->powerd_proxy != NULL)
+    set_brightness_local(self, dbus_powerd_get_brightness(p->powerd_proxy));
+}
+
+static void
+on_backend_changed(IndicatorPowerBrightnessBackend * backend,
+                   gpointer                          gself)
+{
+  /* don't let a ramp's intermediate steps move the slider */
+  if (get_priv(INDICATOR_POWER_BRIGHTNESS(gself))->ramp_tag != 0)
+    return;
+
+  set_brightness_local(INDICATOR_POWER_BRIGHTNESS(gself),
+                       indicator_power_brightness_backend_get_brightness(backend));
+}
+
 
 /***
 ****  Instantiation
@@ -441,13 +760,36 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
   p = get_priv(self);
   p->cancellable = g_cancellable_new();
 
+  /* the curve is ours, but fall back to linear if our schema's missing */
   schema = g_settings_schema_source_lookup(g_settings_schema_source_get_default(),
-                                           SCHEMA_NAME,
+                                           INDICATOR_SCHEMA_NAME,
                                            TRUE);
+  if (schema != NULL)
+    {
+      if (g_settings_schema_has_key(schema, KEY_CURVE))
+        {
+          p->indicator_settings = g_settings_new(INDICATOR_SCHEMA_NAME);
+          g_signal_connect_swapped(p->indicator_settings, "changed::" KEY_CURVE,
+                                   G_CALLBACK(on_curve_changed_in_schema), self);
+          g_signal_connect_swapped(p->indicator_settings, "changed::" KEY_GAMMA,
+                                   G_CALLBACK(on_curve_changed_in_schema), self);
+        }
+      g_settings_schema_unref(schema);
+    }
+}
+
+/* "brightness" is in powerd's scale, so it's only used with powerd.
+   It's only spec'ed for the phone profile, so fail gracefully
+   & silently if we don't have the schema for it. */
+static void
+init_powerd_settings(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+  GSettingsSchema * schema;
 
-  /* "brightness" is only spec'ed for the phone profile,
-     so fail gracefully & silently if we don't have the
-     schema for it. */
+  schema = g_settings_schema_source_lookup(g_settings_schema_source_get_default(),
+                                           SCHEMA_NAME,
+                                           TRUE);
   if (schema != NULL)
     {
       if (g_settings_schema_has_key(schema, KEY_BRIGHTNESS))
@@ -460,14 +802,34 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
         }
       g_settings_schema_unref(schema);
     }
+}
 
-  dbus_powerd_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-                                 G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES,
-                                 "com.canonical.powerd",
-                                 "/com/canonical/powerd",
-                                 p->cancellable,
-                                 on_powerd_proxy_ready,
-                                 self);
+static void
+my_constructed(GObject * o)
+{
+  IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(o);
+  priv_t * p = get_priv(self);
+
+  if (p->backend != NULL)
+    {
+      g_signal_connect(p->backend, "changed",
+                       G_CALLBACK(on_backend_changed), self);
+      update_curve(self);
+      on_backend_changed(p->backend, self);
+    }
+  else
+    {
+      init_powerd_settings(self);
+      dbus_powerd_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+                                     G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES,
+                                     "com.canonical.powerd",
+                                     "/com/canonical/powerd",
+                                     p->cancellable,
+                                     on_powerd_proxy_ready,
+                                     self);
+    }
+
+  G_OBJECT_CLASS(indicator_power_brightness_parent_class)->constructed(o);
 }
 
 static void
@@ -476,6 +838,7 @@ indicator_power_brightness_class_init(IndicatorPowerBrightnessClass * klass)
   GObjectClass * object_class = G_OBJECT_CLASS(klass);
 
   object_class->dispose = my_dispose;
+  object_class->constructed = my_constructed;
   object_class->get_property = my_get_property;
   object_class->set_property = my_set_property;
 
@@ -504,6 +867,13 @@ indicator_power_brightness_class_init(IndicatorPowerBrightnessClass * klass)
     FALSE,
     G_PARAM_READABLE|G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_BACKEND] = g_param_spec_object(
+    "backend",
+    "Backend",
+    "The backlight backend to use instead of powerd, or NULL",
+    INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND,
+    G_PARAM_READWRITE|G_PARAM_CONSTRUCT_ONLY|G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties(object_class, LAST_PROP, properties);
 }
 
@@ -519,6 +889,18 @@ indicator_power_brightness_new(void)
   return INDICATOR_POWER_BRIGHTNESS(o);
 }
 
+IndicatorPowerBrightness *
+indicator_power_brightness_new_with_backend(IndicatorPowerBrightnessBackend * backend)
+{
+  gpointer o;
+
+  g_return_val_if_fail(INDICATOR_IS_POWER_BRIGHTNESS_BACKEND(backend), NULL);
+
+  o = g_object_new(INDICATOR_TYPE_POWER_BRIGHTNESS, "backend", backend, NULL);
+
+  return INDICATOR_POWER_BRIGHTNESS(o);
+}
+
 void
 indicator_power_brightness_set_percentage(IndicatorPowerBrightness * self,
                                           double                     percentage)
@@ -535,3 +917,11 @@ indicator_power_brightness_get_percentage(IndicatorPowerBrightness * self)
 
   return get_priv(self)->percentage;
 }
+
+guint
+indicator_power_brightness_get_dropped_writes(IndicatorPowerBrightness * self)
+{
+  g_return_val_if_fail(INDICATOR_IS_POWER_BRIGHTNESS(self), 0);
+
+  return get_priv(self)->dropped_writes;
+}
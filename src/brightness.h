@@ -23,6 +23,8 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "brightness-backend.h"
+
 G_BEGIN_DECLS
 
 /* standard GObject macros */
@@ -58,10 +60,15 @@ GType indicator_power_brightness_get_type(void);
 
 IndicatorPowerBrightness * indicator_power_brightness_new(void);
 
+IndicatorPowerBrightness * indicator_power_brightness_new_with_backend(IndicatorPowerBrightnessBackend * backend);
+
 void indicator_power_brightness_set_percentage(IndicatorPowerBrightness * self, double percentage);
 
 double indicator_power_brightness_get_percentage(IndicatorPowerBrightness * self);
 
+/* how many brightness values were replaced by newer ones before being sent */
+guint indicator_power_brightness_get_dropped_writes(IndicatorPowerBrightness * self);
+
 G_END_DECLS
 
 #endif /* INDICATOR_POWER_BRIGHTNESS__H */
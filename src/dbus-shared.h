@@ -24,4 +24,12 @@
 #define BUS_NAME "org.ayatana.indicator.power"
 #define BUS_PATH "/org/ayatana/indicator/power"
 
+/* an optional action group holding the "_header" action's parts as separate
+   actions: "title", "label", "accessible-desc", "icon" and "visible" */
+#define BUS_HEADER_PATH BUS_PATH "/header"
+
+/* the same actions as BUS_PATH but without "_header", for panels
+   that watch BUS_HEADER_PATH instead */
+#define BUS_ACTIONS_PATH BUS_PATH "/actions"
+
 #endif /* DBUS_SHARED_H */
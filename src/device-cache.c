@@ -0,0 +1,309 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "device-cache.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+
+/***
+****  On-disk format
+****
+****  A serialized (ua(suudb)) GVariant: the format version, then the
+****  devices' object path, kind, state, percentage and power_supply.
+****  It's in host byte order, so a swapped file fails the version check.
+***/
+
+#define CACHE_FILENAME "devices"
+#define CACHE_VERSION 1
+#define CACHE_TYPE "(ua(suudb))"
+#define CACHE_DEVICE_TYPE "(suudb)"
+
+/***
+****
+***/
+
+typedef struct
+{
+  char * dir;
+  char * path;
+
+  GVariant * written; /* the last snapshot that was written */
+  GVariant * pending; /* the newest snapshot, if it's waiting to be written */
+  gint64 last_write_time;
+  guint write_timer;
+}
+IndicatorPowerDeviceCachePrivate;
+
+typedef IndicatorPowerDeviceCachePrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerDeviceCache,
+                           indicator_power_device_cache,
+                           G_TYPE_OBJECT)
+
+#define get_priv(o) ((priv_t*)indicator_power_device_cache_get_instance_private(o))
+
+/***
+****
+***/
+
+static GVariant *
+create_snapshot (GList * devices)
+{
+  GVariantBuilder b;
+  GList * l;
+
+  g_variant_builder_init (&b, G_VARIANT_TYPE("a"CACHE_DEVICE_TYPE));
+
+  for (l=devices; l!=NULL; l=l->next)
+    {
+      const IndicatorPowerDevice * device = l->data;
+      const char * object_path = indicator_power_device_get_object_path (device);
+
+      g_variant_builder_add (&b, CACHE_DEVICE_TYPE,
+                             object_path ? object_path : "",
+                             (guint32) indicator_power_device_get_kind (device),
+                             (guint32) indicator_power_device_get_state (device),
+                             indicator_power_device_get_percentage (device),
+                             indicator_power_device_get_power_supply (device));
+    }
+
+  return g_variant_ref_sink (g_variant_new ("(u@a"CACHE_DEVICE_TYPE")",
+                                            (guint32) CACHE_VERSION,
+                                            g_variant_builder_end (&b)));
+}
+
+static void
+write_snapshot (IndicatorPowerDeviceCache * self, GVariant * snapshot)
+{
+  priv_t * const p = get_priv (self);
+  GError * error = NULL;
+
+  p->last_write_time = g_get_monotonic_time ();
+
+  if ((p->written != NULL) && g_variant_equal (p->written, snapshot))
+    return;
+
+  if (g_mkdir_with_parents (p->dir, 0700) == -1)
+    g_debug ("%s: unable to create: %s", p->dir, g_strerror (errno));
+
+  if (!g_file_set_contents (p->path,
+                            g_variant_get_data (snapshot),
+                            (gssize) g_variant_get_size (snapshot),
+                            &error))
+    {
+      g_debug ("%s: unable to save devices: %s", p->path, error->message);
+      g_error_free (error);
+    }
+
+  g_clear_pointer (&p->written, g_variant_unref);
+  p->written = g_variant_ref (snapshot);
+}
+
+static gboolean
+on_write_timer (gpointer gself)
+{
+  IndicatorPowerDeviceCache * self = INDICATOR_POWER_DEVICE_CACHE (gself);
+
+  get_priv(self)->write_timer = 0;
+  indicator_power_device_cache_flush (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/***
+****  GObject boilerplate
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  IndicatorPowerDeviceCache * const self = INDICATOR_POWER_DEVICE_CACHE(o);
+
+  /* don't lose the newest snapshot to the rate limit */
+  indicator_power_device_cache_flush (self);
+
+  G_OBJECT_CLASS (indicator_power_device_cache_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_CACHE(o));
+
+  g_clear_pointer (&p->pending, g_variant_unref);
+  g_clear_pointer (&p->written, g_variant_unref);
+  g_free (p->path);
+  g_free (p->dir);
+
+  G_OBJECT_CLASS (indicator_power_device_cache_parent_class)->finalize (o);
+}
+
+static void
+indicator_power_device_cache_init (IndicatorPowerDeviceCache * self G_GNUC_UNUSED)
+{
+}
+
+static void
+indicator_power_device_cache_class_init (IndicatorPowerDeviceCacheClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerDeviceCache *
+indicator_power_device_cache_new (const char * dir)
+{
+  IndicatorPowerDeviceCache * self = g_object_new (INDICATOR_TYPE_POWER_DEVICE_CACHE, NULL);
+  priv_t * const p = get_priv (self);
+
+  p->dir = dir != NULL ? g_strdup (dir)
+                       : g_build_filename (g_get_user_cache_dir (), "ayatana-indicator-power", NULL);
+  p->path = g_build_filename (p->dir, CACHE_FILENAME, NULL);
+
+  return self;
+}
+
+GList *
+indicator_power_device_cache_load (IndicatorPowerDeviceCache * self)
+{
+  priv_t * p;
+  gchar * contents;
+  gsize length;
+  GError * error;
+  GBytes * bytes;
+  GVariant * snapshot;
+  GVariant * devices;
+  guint32 version;
+  GVariantIter iter;
+  const char * object_path;
+  guint32 kind;
+  guint32 state;
+  gdouble percentage;
+  gboolean power_supply;
+  GList * ret;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE_CACHE(self), NULL);
+  p = get_priv (self);
+
+  error = NULL;
+  if (!g_file_get_contents (p->path, &contents, &length, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_debug ("%s: unable to load devices: %s", p->path, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  /* untrusted, so GVariant validates it as it's read */
+  bytes = g_bytes_new_take (contents, length);
+  snapshot = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE(CACHE_TYPE), bytes, FALSE));
+  g_bytes_unref (bytes);
+
+  g_variant_get (snapshot, "(u@a"CACHE_DEVICE_TYPE")", &version, &devices);
+
+  ret = NULL;
+  if (version != CACHE_VERSION)
+    {
+      g_debug ("%s: ignoring snapshot with version %u", p->path, (unsigned int) version);
+    }
+  else
+    {
+      g_variant_iter_init (&iter, devices);
+      while (g_variant_iter_loop (&iter, "(&suudb)", &object_path, &kind, &state, &percentage, &power_supply))
+        {
+          if (!*object_path || (kind >= UP_DEVICE_KIND_LAST) || (state >= UP_DEVICE_STATE_LAST))
+            continue;
+
+          ret = g_list_prepend (ret, indicator_power_device_new (object_path,
+                                                                 (UpDeviceKind) kind,
+                                                                 CLAMP (percentage, 0.0, 100.0),
+                                                                 (UpDeviceState) state,
+                                                                 0,
+                                                                 power_supply));
+        }
+    }
+
+  /* what's on disk needn't be written again */
+  if (ret != NULL)
+    {
+      g_clear_pointer (&p->written, g_variant_unref);
+      p->written = g_variant_ref (snapshot);
+    }
+
+  g_variant_unref (devices);
+  g_variant_unref (snapshot);
+  return g_list_reverse (ret);
+}
+
+void
+indicator_power_device_cache_save (IndicatorPowerDeviceCache * self,
+                                   GList                     * devices)
+{
+  priv_t * p;
+  gint64 elapsed_usec;
+  const gint64 interval_usec = INDICATOR_POWER_DEVICE_CACHE_MIN_INTERVAL_SEC * G_USEC_PER_SEC;
+
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_CACHE(self));
+  p = get_priv (self);
+
+  g_clear_pointer (&p->pending, g_variant_unref);
+  p->pending = create_snapshot (devices);
+
+  /* already waiting; the timer will write the newest snapshot */
+  if (p->write_timer != 0)
+    return;
+
+  elapsed_usec = g_get_monotonic_time () - p->last_write_time;
+  if ((p->last_write_time == 0) || (elapsed_usec >= interval_usec))
+    {
+      indicator_power_device_cache_flush (self);
+    }
+  else
+    {
+      const guint delay_sec = (guint) ((interval_usec - elapsed_usec + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC);
+
+      p->write_timer = g_timeout_add_seconds (delay_sec, on_write_timer, self);
+    }
+}
+
+void
+indicator_power_device_cache_flush (IndicatorPowerDeviceCache * self)
+{
+  priv_t * p;
+
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_CACHE(self));
+  p = get_priv (self);
+
+  if (p->write_timer != 0)
+    {
+      g_source_remove (p->write_timer);
+      p->write_timer = 0;
+    }
+
+  if (p->pending != NULL)
+    {
+      write_snapshot (self, p->pending);
+      g_clear_pointer (&p->pending, g_variant_unref);
+    }
+}
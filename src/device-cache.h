@@ -0,0 +1,80 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_DEVICE_CACHE_H__
+#define __INDICATOR_POWER_DEVICE_CACHE_H__
+
+#include <glib-object.h>
+
+#include "device.h"
+
+G_BEGIN_DECLS
+
+/* standard GObject macros */
+#define INDICATOR_POWER_DEVICE_CACHE(o)      (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_DEVICE_CACHE, IndicatorPowerDeviceCache))
+#define INDICATOR_TYPE_POWER_DEVICE_CACHE    (indicator_power_device_cache_get_type())
+#define INDICATOR_IS_POWER_DEVICE_CACHE(o)   (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_DEVICE_CACHE))
+
+typedef struct _IndicatorPowerDeviceCache         IndicatorPowerDeviceCache;
+typedef struct _IndicatorPowerDeviceCacheClass    IndicatorPowerDeviceCacheClass;
+
+/* the snapshot is written at most this often */
+#define INDICATOR_POWER_DEVICE_CACHE_MIN_INTERVAL_SEC 30
+
+/**
+ * The last known set of devices, kept on disk so that the next
+ * session can paint its header before the device provider has
+ * finished enumerating.
+ *
+ * The snapshot only holds what the header and menu need. Time
+ * remaining isn't kept, since it's meaningless by the time the
+ * snapshot is read back.
+ */
+struct _IndicatorPowerDeviceCache
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerDeviceCacheClass
+{
+  GObjectClass parent_class;
+};
+
+/***
+****
+***/
+
+GType indicator_power_device_cache_get_type (void);
+
+/* dir is for tests; pass NULL to use $XDG_CACHE_HOME/ayatana-indicator-power */
+IndicatorPowerDeviceCache * indicator_power_device_cache_new (const char * dir);
+
+/* Returns a new list of the snapshot's devices, or NULL if there isn't one.
+   Free the list with g_list_free_full (devices, g_object_unref). */
+GList * indicator_power_device_cache_load (IndicatorPowerDeviceCache * self);
+
+/* Snapshots the devices. If the last write was too recent,
+   the write is deferred and only the newest snapshot is kept. */
+void indicator_power_device_cache_save (IndicatorPowerDeviceCache * self,
+                                        GList                     * devices);
+
+/* Writes a deferred snapshot now, if there is one */
+void indicator_power_device_cache_flush (IndicatorPowerDeviceCache * self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEVICE_CACHE_H__ */
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbus-device.h"
+#include "dbus-shared.h"
+#include "device.h"
+#include "device-exporter.h"
+
+#include <gio/gio.h>
+
+#include <string.h> /* strrchr() */
+
+#define DEVICES_PATH BUS_PATH"/devices"
+
+typedef struct
+{
+  GDBusObjectManagerServer * manager;
+  IndicatorPowerDevice * device;
+  GDBusObjectSkeleton * object;
+  DbusDevice * skeleton;
+}
+Export;
+
+typedef struct
+{
+  GDBusObjectManagerServer * manager;
+
+  /* device object path --> Export */
+  GHashTable * exports;
+}
+IndicatorPowerDeviceExporterPrivate;
+
+typedef IndicatorPowerDeviceExporterPrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerDeviceExporter,
+                           indicator_power_device_exporter,
+                           G_TYPE_OBJECT)
+
+#define get_priv(o) ((priv_t*)indicator_power_device_exporter_get_instance_private(o))
+
+/***
+****  Exports
+***/
+
+static void
+export_sync (Export * export)
+{
+  IndicatorPowerDevice * const device = export->device;
+  DbusDevice * const skel = export->skeleton;
+
+  /* the skeleton only emits PropertiesChanged for values that
+     differ, and batches them up until the next idle */
+  dbus_device_set_source (skel, indicator_power_device_get_object_path (device));
+  dbus_device_set_kind (skel, indicator_power_device_get_kind (device));
+  dbus_device_set_state (skel, indicator_power_device_get_state (device));
+  dbus_device_set_percentage (skel, indicator_power_device_get_percentage (device));
+  dbus_device_set_time_remaining (skel, (guint64) indicator_power_device_get_time (device));
+  dbus_device_set_energy_rate (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE));
+  dbus_device_set_energy (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_ENERGY));
+  dbus_device_set_energy_full (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL));
+  dbus_device_set_energy_full_design (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL_DESIGN));
+  dbus_device_set_voltage (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_VOLTAGE));
+  dbus_device_set_temperature (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_TEMPERATURE));
+  dbus_device_set_capacity (skel, indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_CAPACITY));
+}
+
+static void
+export_set_device (Export * export, IndicatorPowerDevice * device)
+{
+  if (export->device == device)
+    return;
+
+  if (export->device != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (export->device, export);
+      g_clear_object (&export->device);
+    }
+
+  export->device = g_object_ref (device);
+  g_signal_connect_swapped (export->device, "notify", G_CALLBACK(export_sync), export);
+  export_sync (export);
+}
+
+/* D-Bus object paths only allow [A-Za-z0-9_], so name
+   the object after the device path's last element */
+static char *
+make_object_path (const char * device_path)
+{
+  const char * name;
+  GString * path;
+
+  name = strrchr (device_path, '/');
+  name = name != NULL ? name + 1 : device_path;
+  if (*name == '\0')
+    name = "device";
+
+  path = g_string_new (DEVICES_PATH"/");
+  for (; *name != '\0'; ++name)
+    g_string_append_c (path, g_ascii_isalnum (*name) ? *name : '_');
+
+  return g_string_free (path, FALSE);
+}
+
+static Export *
+export_new (GDBusObjectManagerServer * manager, const char * device_path)
+{
+  Export * export;
+  char * object_path;
+
+  export = g_new0 (Export, 1);
+  export->manager = manager;
+  export->skeleton = dbus_device_skeleton_new ();
+
+  object_path = make_object_path (device_path);
+  export->object = g_dbus_object_skeleton_new (object_path);
+  g_free (object_path);
+  g_dbus_object_skeleton_add_interface (export->object, G_DBUS_INTERFACE_SKELETON(export->skeleton));
+
+  /* appends a suffix if two devices' names collide */
+  g_dbus_object_manager_server_export_uniquely (manager, export->object);
+
+  return export;
+}
+
+static void
+export_free (gpointer gexport)
+{
+  Export * export = gexport;
+
+  if (export->device != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (export->device, export);
+      g_clear_object (&export->device);
+    }
+
+  g_dbus_object_manager_server_unexport (export->manager,
+                                         g_dbus_object_get_object_path (G_DBUS_OBJECT(export->object)));
+  g_clear_object (&export->object);
+  g_clear_object (&export->skeleton);
+
+  g_free (export);
+}
+
+static gboolean
+is_stale (gpointer key, gpointer value G_GNUC_UNUSED, gpointer current_paths)
+{
+  return !g_hash_table_contains (current_paths, key);
+}
+
+/***
+****  GObject boilerplate
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_EXPORTER(o));
+
+  if (p->exports != NULL)
+    g_hash_table_remove_all (p->exports);
+
+  g_clear_object (&p->manager);
+
+  G_OBJECT_CLASS (indicator_power_device_exporter_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_EXPORTER(o));
+
+  g_hash_table_destroy (p->exports);
+
+  G_OBJECT_CLASS (indicator_power_device_exporter_parent_class)->finalize (o);
+}
+
+static void
+indicator_power_device_exporter_init (IndicatorPowerDeviceExporter * self)
+{
+  priv_t * const p = get_priv (self);
+
+  p->manager = g_dbus_object_manager_server_new (DEVICES_PATH);
+  p->exports = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, export_free);
+}
+
+static void
+indicator_power_device_exporter_class_init (IndicatorPowerDeviceExporterClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerDeviceExporter *
+indicator_power_device_exporter_new (void)
+{
+  return g_object_new (INDICATOR_TYPE_POWER_DEVICE_EXPORTER, NULL);
+}
+
+void
+indicator_power_device_exporter_set_bus (IndicatorPowerDeviceExporter * self,
+                                         GDBusConnection              * bus)
+{
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_EXPORTER(self));
+  g_return_if_fail ((bus == NULL) || G_IS_DBUS_CONNECTION(bus));
+
+  g_dbus_object_manager_server_set_connection (get_priv(self)->manager, bus);
+}
+
+void
+indicator_power_device_exporter_set_devices (IndicatorPowerDeviceExporter * self,
+                                             GList                        * devices)
+{
+  priv_t * p;
+  GHashTable * current_paths;
+  GList * l;
+
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_EXPORTER(self));
+  p = get_priv (self);
+
+  current_paths = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (l=devices; l!=NULL; l=l->next)
+    {
+      IndicatorPowerDevice * device = INDICATOR_POWER_DEVICE(l->data);
+      const char * device_path = indicator_power_device_get_object_path (device);
+      Export * export;
+
+      if ((device_path == NULL) || (*device_path == '\0'))
+        continue;
+
+      if (!(export = g_hash_table_lookup (p->exports, device_path)))
+        {
+          export = export_new (p->manager, device_path);
+          g_hash_table_insert (p->exports, g_strdup (device_path), export);
+        }
+
+      export_set_device (export, device);
+      g_hash_table_add (current_paths, (gpointer)device_path);
+    }
+
+  g_hash_table_foreach_remove (p->exports, is_stale, current_paths);
+  g_hash_table_destroy (current_paths);
+}
+
+GDBusObjectManager *
+indicator_power_device_exporter_get_object_manager (IndicatorPowerDeviceExporter * self)
+{
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE_EXPORTER(self), NULL);
+
+  return G_DBUS_OBJECT_MANAGER (get_priv(self)->manager);
+}
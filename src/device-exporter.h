@@ -0,0 +1,67 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_DEVICE_EXPORTER_H__
+#define __INDICATOR_POWER_DEVICE_EXPORTER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* standard GObject macros */
+#define INDICATOR_POWER_DEVICE_EXPORTER(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_DEVICE_EXPORTER, IndicatorPowerDeviceExporter))
+#define INDICATOR_TYPE_POWER_DEVICE_EXPORTER  (indicator_power_device_exporter_get_type())
+#define INDICATOR_IS_POWER_DEVICE_EXPORTER(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_DEVICE_EXPORTER))
+
+typedef struct _IndicatorPowerDeviceExporter         IndicatorPowerDeviceExporter;
+typedef struct _IndicatorPowerDeviceExporterClass    IndicatorPowerDeviceExporterClass;
+
+/**
+ * Exports each device as a read-only org.ayatana.indicator.power.Device
+ * object below an org.freedesktop.DBus.ObjectManager, so that clients
+ * can read its properties and follow their changes.
+ */
+struct _IndicatorPowerDeviceExporter
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerDeviceExporterClass
+{
+  GObjectClass parent_class;
+};
+
+/***
+****
+***/
+
+GType indicator_power_device_exporter_get_type (void);
+
+IndicatorPowerDeviceExporter * indicator_power_device_exporter_new (void);
+
+void indicator_power_device_exporter_set_bus (IndicatorPowerDeviceExporter * self,
+                                              GDBusConnection              * connection);
+
+/* devices is a GList of IndicatorPowerDevice* */
+void indicator_power_device_exporter_set_devices (IndicatorPowerDeviceExporter * self,
+                                                  GList                        * devices);
+
+GDBusObjectManager * indicator_power_device_exporter_get_object_manager (IndicatorPowerDeviceExporter * self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEVICE_EXPORTER_H__ */
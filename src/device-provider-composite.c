@@ -0,0 +1,331 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-composite.h"
+
+#include <string.h> /* strlen(), strrchr() */
+
+#define UPOWER_DEVICES_PATH "/org/freedesktop/UPower/devices/"
+
+typedef struct
+{
+  IndicatorPowerDeviceProvider * provider;
+  int priority;
+}
+Child;
+
+typedef struct
+{
+  /* Child*, highest priority first */
+  GSList * children;
+
+  /* the merged devices, rebuilt when a child's changed */
+  GList * devices;
+  gboolean dirty;
+
+  /* coalesces children's devices-changed signals */
+  guint emit_tag;
+}
+IndicatorPowerDeviceProviderCompositePrivate;
+
+typedef IndicatorPowerDeviceProviderCompositePrivate priv_t;
+
+#define get_priv(o) ((priv_t*)indicator_power_device_provider_composite_get_instance_private(o))
+
+/***
+****  GObject boilerplate
+***/
+
+static void indicator_power_device_provider_interface_init (
+                                IndicatorPowerDeviceProviderInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+  IndicatorPowerDeviceProviderComposite,
+  indicator_power_device_provider_composite,
+  G_TYPE_OBJECT,
+  G_ADD_PRIVATE(IndicatorPowerDeviceProviderComposite)
+  G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_DEVICE_PROVIDER,
+                         indicator_power_device_provider_interface_init))
+
+/***
+****  Device identity
+***/
+
+/* UPower names its objects "<kind>_<native name>" */
+static const char * const upower_kind_prefixes[] =
+{
+  "line_power_", "battery_", "ups_", "monitor_", "mouse_", "keyboard_",
+  "pda_", "phone_", "media_player_", "tablet_", "computer_",
+  "gaming_input_", "pen_", "touchpad_", "modem_", "network_", "headset_",
+  "speakers_", "headphones_", "video_", "other_audio_", "remote_control_",
+  "printer_", "scanner_", "camera_", "wearable_", "toy_", "bluetooth_generic_"
+};
+
+/* A key that's the same for a device no matter which provider reports it:
+   the kernel's name for it, spelled the way UPower spells object paths.
+   So "/org/freedesktop/UPower/devices/mouse_hid_00_1f_battery" and
+   "/sys/class/power_supply/hid-00:1f-battery" are the same device. */
+static char *
+get_identity (const IndicatorPowerDevice * device)
+{
+  const char * path = indicator_power_device_get_object_path (device);
+  const char * name;
+  char * identity;
+  char * c;
+
+  if (path == NULL)
+    return g_strdup ("");
+
+  name = strrchr (path, '/');
+  name = name != NULL ? name + 1 : path;
+
+  if (g_str_has_prefix (path, UPOWER_DEVICES_PATH))
+    {
+      guint i;
+
+      for (i=0; i<G_N_ELEMENTS(upower_kind_prefixes); ++i)
+        {
+          if (g_str_has_prefix (name, upower_kind_prefixes[i]))
+            {
+              name += strlen (upower_kind_prefixes[i]);
+              break;
+            }
+        }
+    }
+
+  identity = g_strdup (name);
+  for (c=identity; *c!='\0'; ++c)
+    if (!g_ascii_isalnum (*c))
+      *c = '_';
+
+  return identity;
+}
+
+/***
+****  Merging
+***/
+
+static void
+merge (IndicatorPowerDeviceProviderComposite * self)
+{
+  priv_t * const p = get_priv (self);
+  GHashTable * seen;
+  GList * merged = NULL;
+  GSList * l;
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (l=p->children; l!=NULL; l=l->next)
+    {
+      const Child * const child = l->data;
+      GList * devices = indicator_power_device_provider_get_devices (child->provider);
+      GList * d;
+
+      for (d=devices; d!=NULL; d=d->next)
+        {
+          char * identity = get_identity (d->data);
+
+          if (g_hash_table_contains (seen, identity))
+            {
+              g_free (identity);
+            }
+          else
+            {
+              g_hash_table_add (seen, identity);
+              merged = g_list_prepend (merged, g_object_ref (d->data));
+            }
+        }
+
+      g_list_free_full (devices, g_object_unref);
+    }
+
+  g_hash_table_destroy (seen);
+
+  g_list_free_full (p->devices, g_object_unref);
+  p->devices = g_list_reverse (merged);
+  p->dirty = FALSE;
+}
+
+static gboolean
+on_emit_idle (gpointer gself)
+{
+  IndicatorPowerDeviceProviderComposite * const self = INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE (gself);
+  priv_t * const p = get_priv (self);
+
+  p->emit_tag = 0;
+
+  if (p->dirty)
+    merge (self);
+
+  indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+  return G_SOURCE_REMOVE;
+}
+
+/* Merge and emit once the main loop's done dispatching, so that changes
+   from several providers, or several from one, emit one devices-changed.
+   Each provider's changes are merged when it makes them; no provider
+   waits on the others. */
+static void
+merge_soon (IndicatorPowerDeviceProviderComposite * self)
+{
+  priv_t * const p = get_priv (self);
+
+  p->dirty = TRUE;
+
+  if (p->emit_tag == 0)
+    p->emit_tag = g_idle_add (on_emit_idle, self);
+}
+
+/***
+****  IndicatorPowerDeviceProvider virtual functions
+***/
+
+static GList *
+my_get_devices (IndicatorPowerDeviceProvider * provider)
+{
+  IndicatorPowerDeviceProviderComposite * const self = INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE (provider);
+  priv_t * const p = get_priv (self);
+
+  /* don't hand out a stale list while a merge is pending */
+  if (p->dirty)
+    merge (self);
+
+  return g_list_copy_deep (p->devices, (GCopyFunc)g_object_ref, NULL);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+child_free (gpointer gchild, gpointer gself)
+{
+  Child * const child = gchild;
+
+  g_signal_handlers_disconnect_by_data (child->provider, gself);
+  g_object_unref (child->provider);
+  g_free (child);
+}
+
+static void
+my_dispose (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE(o));
+
+  if (p->emit_tag != 0)
+    {
+      g_source_remove (p->emit_tag);
+      p->emit_tag = 0;
+    }
+
+  g_slist_foreach (p->children, child_free, o);
+  g_slist_free (p->children);
+  p->children = NULL;
+
+  g_list_free_full (p->devices, g_object_unref);
+  p->devices = NULL;
+
+  G_OBJECT_CLASS (indicator_power_device_provider_composite_parent_class)->dispose (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_device_provider_composite_class_init (IndicatorPowerDeviceProviderCompositeClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+}
+
+static void
+indicator_power_device_provider_interface_init (IndicatorPowerDeviceProviderInterface * iface)
+{
+  iface->get_devices = my_get_devices;
+}
+
+static void
+indicator_power_device_provider_composite_init (IndicatorPowerDeviceProviderComposite * self G_GNUC_UNUSED)
+{
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerDeviceProvider *
+indicator_power_device_provider_composite_new (void)
+{
+  gpointer o = g_object_new (INDICATOR_TYPE_POWER_DEVICE_PROVIDER_COMPOSITE, NULL);
+
+  return INDICATOR_POWER_DEVICE_PROVIDER (o);
+}
+
+void
+indicator_power_device_provider_composite_add (IndicatorPowerDeviceProviderComposite * self,
+                                               IndicatorPowerDeviceProvider          * provider,
+                                               int                                     priority)
+{
+  priv_t * p;
+  Child * child;
+  GSList * l;
+  gint position;
+
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER_COMPOSITE (self));
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER (provider));
+  p = get_priv (self);
+
+  child = g_new0 (Child, 1);
+  child->provider = g_object_ref (provider);
+  child->priority = priority;
+
+  /* ties go to whichever provider was added first */
+  for (l=p->children, position=0; l!=NULL; l=l->next, ++position)
+    if (((Child*)l->data)->priority < priority)
+      break;
+  p->children = g_slist_insert (p->children, child, position);
+
+  g_signal_connect_swapped (provider, "devices-changed", G_CALLBACK(merge_soon), self);
+  merge_soon (self);
+}
+
+void
+indicator_power_device_provider_composite_remove (IndicatorPowerDeviceProviderComposite * self,
+                                                  IndicatorPowerDeviceProvider          * provider)
+{
+  priv_t * p;
+  GSList * l;
+
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER_COMPOSITE (self));
+  p = get_priv (self);
+
+  for (l=p->children; l!=NULL; l=l->next)
+    {
+      Child * const child = l->data;
+
+      if (child->provider == provider)
+        {
+          p->children = g_slist_delete_link (p->children, l);
+          child_free (child, self);
+          merge_soon (self);
+          break;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE__H__
+#define __INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE__H__
+
+#include <glib-object.h> /* parent class */
+
+#include "device-provider.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_DEVICE_PROVIDER_COMPOSITE \
+  (indicator_power_device_provider_composite_get_type())
+
+#define INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+                               INDICATOR_TYPE_POWER_DEVICE_PROVIDER_COMPOSITE, \
+                               IndicatorPowerDeviceProviderComposite))
+
+#define INDICATOR_IS_POWER_DEVICE_PROVIDER_COMPOSITE(o) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+                               INDICATOR_TYPE_POWER_DEVICE_PROVIDER_COMPOSITE))
+
+typedef struct _IndicatorPowerDeviceProviderComposite
+                IndicatorPowerDeviceProviderComposite;
+typedef struct _IndicatorPowerDeviceProviderCompositeClass
+                IndicatorPowerDeviceProviderCompositeClass;
+
+/**
+ * An IndicatorPowerDeviceProvider which merges the devices of other providers.
+ *
+ * A device reported by more than one provider, e.g. a battery seen both
+ * by UPower and in sysfs, is only listed once, from the provider with
+ * the highest priority. Each provider's changes are merged as soon as
+ * it reports them, and a burst of them causes one devices-changed.
+ */
+struct _IndicatorPowerDeviceProviderComposite
+{
+  GObject parent_instance;
+};
+
+struct _IndicatorPowerDeviceProviderCompositeClass
+{
+  GObjectClass parent_class;
+};
+
+GType indicator_power_device_provider_composite_get_type (void);
+
+IndicatorPowerDeviceProvider * indicator_power_device_provider_composite_new (void);
+
+/* higher priorities win when two providers report the same device */
+void indicator_power_device_provider_composite_add    (IndicatorPowerDeviceProviderComposite * self,
+                                                       IndicatorPowerDeviceProvider          * provider,
+                                                       int                                     priority);
+
+void indicator_power_device_provider_composite_remove (IndicatorPowerDeviceProviderComposite * self,
+                                                       IndicatorPowerDeviceProvider          * provider);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE__H__ */
@@ -105,3 +105,16 @@ indicator_power_device_provider_add_device (IndicatorPowerDeviceProviderMock * p
 
   g_signal_connect_swapped (device, "notify", G_CALLBACK(indicator_power_device_provider_emit_devices_changed), provider);
 }
+
+void
+indicator_power_device_provider_remove_device (IndicatorPowerDeviceProviderMock * provider,
+                                               IndicatorPowerDevice             * device)
+{
+  GList * l = g_list_find (provider->devices, device);
+
+  g_return_if_fail (l != NULL);
+
+  g_signal_handlers_disconnect_by_data (device, provider);
+  provider->devices = g_list_delete_link (provider->devices, l);
+  g_object_unref (device);
+}
@@ -0,0 +1,618 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-sysfs.h"
+#include "uevent.h"
+
+#include <glib-unix.h> /* g_unix_fd_add() */
+
+#include <errno.h>
+#include <math.h> /* fabs() */
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <linux/netlink.h>
+
+#define DEFAULT_POWER_SUPPLY_DIR "/sys/class/power_supply"
+
+/* Many batteries only send a uevent when their status changes,
+   so their charge has to be polled. UPower does the same. */
+#define POLL_INTERVAL_SEC 30
+
+/* the kernel's own UEVENT_BUFFER_SIZE is 2048 */
+#define UEVENT_BUFFER_SIZE 4096
+
+/* the kernel's netlink multicast group; udev rebroadcasts on group 2 */
+#define UEVENT_GROUP_KERNEL 1
+
+/***
+****  private struct
+***/
+
+typedef struct
+{
+  char * dir;
+
+  int uevent_fd;
+  guint uevent_tag;
+
+  guint poll_tag;
+
+  /* power_supply name --> IndicatorPowerDevice */
+  GHashTable * devices;
+}
+IndicatorPowerDeviceProviderSysfsPrivate;
+
+typedef IndicatorPowerDeviceProviderSysfsPrivate priv_t;
+
+#define get_priv(o) ((priv_t*)indicator_power_device_provider_sysfs_get_instance_private(o))
+
+/***
+****  GObject boilerplate
+***/
+
+static void indicator_power_device_provider_interface_init (
+                                IndicatorPowerDeviceProviderInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+  IndicatorPowerDeviceProviderSysfs,
+  indicator_power_device_provider_sysfs,
+  G_TYPE_OBJECT,
+  G_ADD_PRIVATE(IndicatorPowerDeviceProviderSysfs)
+  G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_DEVICE_PROVIDER,
+                         indicator_power_device_provider_interface_init))
+
+/***
+****  Mapping power_supply properties onto IndicatorPowerDevice
+***/
+
+/* sysfs reports micro-units: uWh, uAh, uW, uA, uV */
+static gboolean
+get_micro (const IndicatorPowerUevent * uevent,
+           IndicatorPowerUeventKey      key,
+           gdouble                    * setme)
+{
+  gint64 i;
+
+  if (!indicator_power_uevent_get_int (uevent, key, &i))
+    return FALSE;
+
+  *setme = (gdouble)i / 1000000.0;
+  return TRUE;
+}
+
+static UpDeviceKind
+get_kind (IndicatorPowerDeviceProviderSysfs * self,
+          const IndicatorPowerUevent        * uevent,
+          const char                        * name)
+{
+  gchar * path;
+  gchar * type = NULL;
+  UpDeviceKind kind = UP_DEVICE_KIND_UNKNOWN;
+
+  if (indicator_power_uevent_has (uevent, INDICATOR_POWER_UEVENT_TYPE))
+    return uevent->kind;
+
+  /* kernels before 5.8 leave POWER_SUPPLY_TYPE out of the uevent */
+  path = g_build_filename (get_priv(self)->dir, name, "type", NULL);
+  if (g_file_get_contents (path, &type, NULL, NULL))
+    {
+      g_strstrip (type);
+      kind = indicator_power_uevent_parse_type (type, strlen (type));
+      g_free (type);
+    }
+
+  g_free (path);
+  return kind;
+}
+
+typedef struct
+{
+  UpDeviceKind kind;
+  UpDeviceState state;
+  gdouble percentage;
+  guint64 time;
+  gboolean power_supply;
+  gdouble metrics[INDICATOR_POWER_DEVICE_N_METRICS];
+}
+Reading;
+
+static void
+get_reading (IndicatorPowerDeviceProviderSysfs * self,
+             const IndicatorPowerUevent        * uevent,
+             const char                        * name,
+             Reading                           * r)
+{
+  gdouble energy = 0;
+  gdouble energy_full = 0;
+  gdouble energy_full_design = 0;
+  gdouble rate = 0;
+  gdouble voltage = 0;
+  gdouble d;
+  gint64 i;
+
+  memset (r, 0, sizeof(Reading));
+  r->kind = get_kind (self, uevent, name);
+  r->state = uevent->state;
+
+  /* peripherals like wireless mice report POWER_SUPPLY_SCOPE=Device */
+  r->power_supply = !uevent->device_scope;
+
+  if (r->kind == UP_DEVICE_KIND_LINE_POWER)
+    return;
+
+  get_micro (uevent, INDICATOR_POWER_UEVENT_VOLTAGE_NOW, &voltage);
+
+  /* some drivers report energy, others report charge */
+  if (!get_micro (uevent, INDICATOR_POWER_UEVENT_ENERGY_NOW, &energy) &&
+      get_micro (uevent, INDICATOR_POWER_UEVENT_CHARGE_NOW, &d))
+    energy = d * voltage;
+
+  if (!get_micro (uevent, INDICATOR_POWER_UEVENT_ENERGY_FULL, &energy_full) &&
+      get_micro (uevent, INDICATOR_POWER_UEVENT_CHARGE_FULL, &d))
+    energy_full = d * voltage;
+
+  if (!get_micro (uevent, INDICATOR_POWER_UEVENT_ENERGY_FULL_DESIGN, &energy_full_design) &&
+      get_micro (uevent, INDICATOR_POWER_UEVENT_CHARGE_FULL_DESIGN, &d))
+    energy_full_design = d * voltage;
+
+  /* some drivers sign the current by direction */
+  if (!get_micro (uevent, INDICATOR_POWER_UEVENT_POWER_NOW, &rate) &&
+      get_micro (uevent, INDICATOR_POWER_UEVENT_CURRENT_NOW, &d))
+    rate = d * voltage;
+  rate = fabs (rate);
+
+  if (indicator_power_uevent_get_int (uevent, INDICATOR_POWER_UEVENT_CAPACITY, &i))
+    r->percentage = (gdouble)i;
+  else if (energy_full > 0)
+    r->percentage = 100.0 * energy / energy_full;
+  r->percentage = CLAMP (r->percentage, 0.0, 100.0);
+
+  /* prefer the driver's own estimate */
+  if ((r->state == UP_DEVICE_STATE_DISCHARGING) &&
+      indicator_power_uevent_get_int (uevent, INDICATOR_POWER_UEVENT_TIME_TO_EMPTY_NOW, &i) && (i > 0))
+    r->time = (guint64) i;
+  else if ((r->state == UP_DEVICE_STATE_CHARGING) &&
+           indicator_power_uevent_get_int (uevent, INDICATOR_POWER_UEVENT_TIME_TO_FULL_NOW, &i) && (i > 0))
+    r->time = (guint64) i;
+  else if ((r->state == UP_DEVICE_STATE_DISCHARGING) && (rate > 0))
+    r->time = (guint64) (3600.0 * energy / rate);
+  else if ((r->state == UP_DEVICE_STATE_CHARGING) && (rate > 0) && (energy_full > energy))
+    r->time = (guint64) (3600.0 * (energy_full - energy) / rate);
+
+  r->metrics[INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE] = rate;
+  r->metrics[INDICATOR_POWER_DEVICE_METRIC_ENERGY] = energy;
+  r->metrics[INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL] = energy_full;
+  r->metrics[INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL_DESIGN] = energy_full_design;
+  r->metrics[INDICATOR_POWER_DEVICE_METRIC_VOLTAGE] = voltage;
+  if (indicator_power_uevent_get_int (uevent, INDICATOR_POWER_UEVENT_TEMP, &i))
+    r->metrics[INDICATOR_POWER_DEVICE_METRIC_TEMPERATURE] = (gdouble)i / 10.0; /* tenths of a degree */
+  if (energy_full_design > 0)
+    r->metrics[INDICATOR_POWER_DEVICE_METRIC_CAPACITY] = 100.0 * energy_full / energy_full_design;
+}
+
+static const char * const metric_properties[INDICATOR_POWER_DEVICE_N_METRICS] =
+{
+  INDICATOR_POWER_DEVICE_ENERGY_RATE,
+  INDICATOR_POWER_DEVICE_ENERGY,
+  INDICATOR_POWER_DEVICE_ENERGY_FULL,
+  INDICATOR_POWER_DEVICE_ENERGY_FULL_DESIGN,
+  INDICATOR_POWER_DEVICE_VOLTAGE,
+  INDICATOR_POWER_DEVICE_TEMPERATURE,
+  INDICATOR_POWER_DEVICE_CAPACITY
+};
+
+/* Updates or creates the named device from its power_supply properties.
+   Like the UPower provider, returns FALSE if only the metrics changed
+   so that they don't cause a devices-changed. */
+static gboolean
+update_device (IndicatorPowerDeviceProviderSysfs * self,
+               const IndicatorPowerUevent        * uevent,
+               const char                        * name)
+{
+  priv_t * const p = get_priv (self);
+  IndicatorPowerDevice * device;
+  Reading r;
+  gboolean changed;
+  gint64 present;
+  int i;
+
+  get_reading (self, uevent, name, &r);
+
+  /* a battery bay with no battery in it */
+  if ((r.kind == UP_DEVICE_KIND_UNKNOWN) ||
+      (indicator_power_uevent_get_int (uevent, INDICATOR_POWER_UEVENT_PRESENT, &present) && !present))
+    return g_hash_table_remove (p->devices, name);
+
+  if ((device = g_hash_table_lookup (p->devices, name)) == NULL)
+    {
+      gchar * path = g_build_filename (p->dir, name, NULL);
+      device = indicator_power_device_new (path,
+                                           r.kind,
+                                           r.percentage,
+                                           r.state,
+                                           (time_t) r.time,
+                                           r.power_supply);
+      g_hash_table_insert (p->devices, g_strdup (name), device);
+      g_free (path);
+      changed = TRUE;
+    }
+  else
+    {
+      guint64 old_time = 0;
+
+      g_object_get (device, INDICATOR_POWER_DEVICE_TIME, &old_time, NULL);
+
+      changed = (indicator_power_device_get_kind (device) != r.kind) ||
+                (indicator_power_device_get_state (device) != r.state) ||
+                (indicator_power_device_get_percentage (device) != r.percentage) ||
+                (indicator_power_device_get_power_supply (device) != r.power_supply) ||
+                (old_time != r.time);
+
+      if (changed)
+        g_object_set (device, INDICATOR_POWER_DEVICE_KIND, (gint)r.kind,
+                              INDICATOR_POWER_DEVICE_STATE, (gint)r.state,
+                              INDICATOR_POWER_DEVICE_PERCENTAGE, r.percentage,
+                              INDICATOR_POWER_DEVICE_TIME, r.time,
+                              INDICATOR_POWER_DEVICE_POWER_SUPPLY, r.power_supply,
+                              NULL);
+    }
+
+  g_object_freeze_notify (G_OBJECT(device));
+  for (i=0; i<INDICATOR_POWER_DEVICE_N_METRICS; ++i)
+    g_object_set (device, metric_properties[i], r.metrics[i], NULL);
+  g_object_thaw_notify (G_OBJECT(device));
+
+  return changed;
+}
+
+/***
+****  Reading sysfs
+***/
+
+static gboolean
+refresh_device_from_file (IndicatorPowerDeviceProviderSysfs * self,
+                          const char                        * name)
+{
+  gchar * path;
+  gchar * contents = NULL;
+  gsize len = 0;
+  gboolean changed;
+
+  path = g_build_filename (get_priv(self)->dir, name, "uevent", NULL);
+
+  if (g_file_get_contents (path, &contents, &len, NULL))
+    {
+      IndicatorPowerUevent uevent;
+
+      indicator_power_uevent_parse (&uevent, contents, len, '\n');
+      changed = update_device (self, &uevent, name);
+      g_free (contents);
+    }
+  else
+    {
+      changed = g_hash_table_remove (get_priv(self)->devices, name);
+    }
+
+  g_free (path);
+  return changed;
+}
+
+/* Rereads every power supply, dropping the ones that went away.
+   Returns TRUE if the device list or a device's state changed. */
+static gboolean
+refresh_all (IndicatorPowerDeviceProviderSysfs * self)
+{
+  priv_t * const p = get_priv (self);
+  GHashTable * seen;
+  GHashTableIter iter;
+  gpointer name;
+  GDir * dir;
+  gboolean changed = FALSE;
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if ((dir = g_dir_open (p->dir, 0, NULL)) != NULL)
+    {
+      const char * entry;
+
+      while ((entry = g_dir_read_name (dir)))
+        {
+          g_hash_table_add (seen, g_strdup (entry));
+          changed |= refresh_device_from_file (self, entry);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_hash_table_iter_init (&iter, p->devices);
+  while (g_hash_table_iter_next (&iter, &name, NULL))
+    {
+      if (!g_hash_table_contains (seen, name))
+        {
+          g_hash_table_iter_remove (&iter);
+          changed = TRUE;
+        }
+    }
+
+  g_hash_table_destroy (seen);
+  return changed;
+}
+
+static void
+emit_devices_changed (IndicatorPowerDeviceProviderSysfs * self)
+{
+  indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+}
+
+static gboolean
+on_poll_timer (gpointer gself)
+{
+  IndicatorPowerDeviceProviderSysfs * const self = INDICATOR_POWER_DEVICE_PROVIDER_SYSFS (gself);
+
+  if (refresh_all (self))
+    emit_devices_changed (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/***
+****  uevents
+***/
+
+static int
+open_uevent_socket (void)
+{
+  struct sockaddr_nl addr;
+  int fd;
+
+  fd = socket (AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (fd == -1)
+    {
+      g_warning ("Unable to open a uevent socket: %s", g_strerror (errno));
+      return -1;
+    }
+
+  memset (&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = UEVENT_GROUP_KERNEL;
+  if (bind (fd, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+    {
+      g_warning ("Unable to listen for uevents: %s", g_strerror (errno));
+      close (fd);
+      return -1;
+    }
+
+  return fd;
+}
+
+static gboolean
+handle_uevent (IndicatorPowerDeviceProviderSysfs * self,
+               char                              * buf,
+               gsize                               len)
+{
+  IndicatorPowerUevent uevent;
+  const char * name;
+
+  indicator_power_uevent_parse (&uevent, buf, len, '\0');
+
+  if (g_strcmp0 (uevent.subsystem, "power_supply"))
+    return FALSE;
+
+  if (((name = uevent.name) == NULL) &&
+      (uevent.devpath != NULL) &&
+      ((name = strrchr (uevent.devpath, '/')) != NULL))
+    ++name;
+
+  if ((name == NULL) || (*name == '\0') || (strchr (name, '/') != NULL))
+    {
+      g_debug ("Ignoring a power_supply uevent without a usable name");
+      return FALSE;
+    }
+
+  if (!g_strcmp0 (uevent.action, "remove"))
+    return g_hash_table_remove (get_priv(self)->devices, name);
+
+  /* power_supply uevents carry all of the device's properties,
+     so there's no need to go back to sysfs */
+  if (!g_strcmp0 (uevent.action, "add") || !g_strcmp0 (uevent.action, "change"))
+    return update_device (self, &uevent, name);
+
+  return FALSE;
+}
+
+static gboolean
+on_uevent_ready (gint fd, GIOCondition condition, gpointer gself)
+{
+  IndicatorPowerDeviceProviderSysfs * const self = INDICATOR_POWER_DEVICE_PROVIDER_SYSFS (gself);
+  gboolean changed = FALSE;
+  char buf[UEVENT_BUFFER_SIZE];
+
+  if (condition & (G_IO_HUP | G_IO_ERR))
+    {
+      g_warning ("uevent socket closed; falling back to polling");
+      get_priv(self)->uevent_tag = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  /* drain the socket so a burst of events causes one devices-changed */
+  for (;;)
+    {
+      struct sockaddr_storage addr;
+      socklen_t addrlen = sizeof(addr);
+      ssize_t n;
+
+      /* unnamed senders, like a socketpair's, leave addr untouched */
+      addr.ss_family = AF_UNSPEC;
+      /* leave room for the parser's trailing NUL */
+      n = recvfrom (fd, buf, sizeof(buf) - 1, 0, (struct sockaddr*)&addr, &addrlen);
+
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            g_debug ("Unable to read a uevent: %s", g_strerror (errno));
+
+          break;
+        }
+
+      if (n == 0)
+        break;
+
+      /* only trust the kernel */
+      if ((addr.ss_family == AF_NETLINK) && (((struct sockaddr_nl*)&addr)->nl_pid != 0))
+        continue;
+
+      changed |= handle_uevent (self, buf, (gsize)n);
+    }
+
+  if (changed)
+    emit_devices_changed (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/***
+****  IndicatorPowerDeviceProvider virtual functions
+***/
+
+static GList *
+my_get_devices (IndicatorPowerDeviceProvider * provider)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_PROVIDER_SYSFS(provider));
+  GList * devices;
+
+  devices = g_hash_table_get_values (p->devices);
+  g_list_foreach (devices, (GFunc)g_object_ref, NULL);
+  return devices;
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_PROVIDER_SYSFS(o));
+
+  if (p->uevent_tag != 0)
+    {
+      g_source_remove (p->uevent_tag);
+      p->uevent_tag = 0;
+    }
+
+  if (p->uevent_fd != -1)
+    {
+      close (p->uevent_fd);
+      p->uevent_fd = -1;
+    }
+
+  if (p->poll_tag != 0)
+    {
+      g_source_remove (p->poll_tag);
+      p->poll_tag = 0;
+    }
+
+  g_hash_table_remove_all (p->devices);
+
+  G_OBJECT_CLASS (indicator_power_device_provider_sysfs_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_DEVICE_PROVIDER_SYSFS(o));
+
+  g_hash_table_destroy (p->devices);
+  g_free (p->dir);
+
+  G_OBJECT_CLASS (indicator_power_device_provider_sysfs_parent_class)->finalize (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_device_provider_sysfs_class_init (IndicatorPowerDeviceProviderSysfsClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+}
+
+static void
+indicator_power_device_provider_interface_init (IndicatorPowerDeviceProviderInterface * iface)
+{
+  iface->get_devices = my_get_devices;
+}
+
+static void
+indicator_power_device_provider_sysfs_init (IndicatorPowerDeviceProviderSysfs * self)
+{
+  priv_t * const p = get_priv (self);
+
+  p->uevent_fd = -1;
+
+  p->devices = g_hash_table_new_full (g_str_hash,
+                                      g_str_equal,
+                                      g_free,
+                                      g_object_unref);
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerDeviceProvider *
+indicator_power_device_provider_sysfs_new (const char * power_supply_dir,
+                                           int          uevent_fd)
+{
+  IndicatorPowerDeviceProviderSysfs * self;
+  priv_t * p;
+  GError * error = NULL;
+
+  self = g_object_new (INDICATOR_TYPE_POWER_DEVICE_PROVIDER_SYSFS, NULL);
+  p = get_priv (self);
+
+  p->dir = g_strdup (power_supply_dir != NULL ? power_supply_dir : DEFAULT_POWER_SUPPLY_DIR);
+  refresh_all (self);
+
+  p->uevent_fd = uevent_fd != -1 ? uevent_fd : open_uevent_socket ();
+  if (p->uevent_fd != -1)
+    {
+      if (g_unix_set_fd_nonblocking (p->uevent_fd, TRUE, &error))
+        {
+          p->uevent_tag = g_unix_fd_add (p->uevent_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, on_uevent_ready, self);
+        }
+      else
+        {
+          g_warning ("Unable to listen for uevents: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
+  p->poll_tag = g_timeout_add_seconds (POLL_INTERVAL_SEC, on_poll_timer, self);
+
+  return INDICATOR_POWER_DEVICE_PROVIDER (self);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_DEVICE_PROVIDER_SYSFS__H__
+#define __INDICATOR_POWER_DEVICE_PROVIDER_SYSFS__H__
+
+#include <glib-object.h> /* parent class */
+
+#include "device-provider.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_DEVICE_PROVIDER_SYSFS \
+  (indicator_power_device_provider_sysfs_get_type())
+
+#define INDICATOR_POWER_DEVICE_PROVIDER_SYSFS(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+                               INDICATOR_TYPE_POWER_DEVICE_PROVIDER_SYSFS, \
+                               IndicatorPowerDeviceProviderSysfs))
+
+#define INDICATOR_IS_POWER_DEVICE_PROVIDER_SYSFS(o) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+                               INDICATOR_TYPE_POWER_DEVICE_PROVIDER_SYSFS))
+
+typedef struct _IndicatorPowerDeviceProviderSysfs
+                IndicatorPowerDeviceProviderSysfs;
+typedef struct _IndicatorPowerDeviceProviderSysfsClass
+                IndicatorPowerDeviceProviderSysfsClass;
+
+/**
+ * An IndicatorPowerDeviceProvider which reads the kernel's
+ * /sys/class/power_supply directly, for systems without UPower.
+ */
+struct _IndicatorPowerDeviceProviderSysfs
+{
+  GObject parent_instance;
+};
+
+struct _IndicatorPowerDeviceProviderSysfsClass
+{
+  GObjectClass parent_class;
+};
+
+GType indicator_power_device_provider_sysfs_get_type (void);
+
+/**
+ * Reads devices from power_supply_dir, or /sys/class/power_supply if NULL.
+ *
+ * Change events are read from uevent_fd, which the provider takes
+ * ownership of. Pass -1 to listen to the kernel's netlink uevents;
+ * tests pass one end of a socketpair instead.
+ */
+IndicatorPowerDeviceProvider * indicator_power_device_provider_sysfs_new (const char * power_supply_dir,
+                                                                          int          uevent_fd);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEVICE_PROVIDER_SYSFS__H__ */
@@ -28,6 +28,10 @@
 
 #define DISPLAY_DEVICE_PATH "/org/freedesktop/UPower/devices/DisplayDevice"
 
+#define LOGIND_BUS_NAME "org.freedesktop.login1"
+#define LOGIND_IFACE    "org.freedesktop.login1.Manager"
+#define LOGIND_PATH     "/org/freedesktop/login1"
+
 /***
 ****  private struct
 ***/
@@ -46,6 +50,15 @@ typedef struct
   /* when this timer fires, the queued_paths will be refreshed */
   guint queued_paths_timer;
 
+  /* after a resume: when the system's power supplies were asked
+     to refresh, and how many of those answers are outstanding.
+     Each resume gets a new generation so that answers to an earlier
+     resume's refreshes aren't counted against this one's */
+  gint64 resume_time;
+  guint resume_pending;
+  guint resume_generation;
+  guint resume_idle;
+
   GSList* subscriptions;
 
   guint name_tag;
@@ -76,10 +89,59 @@ G_DEFINE_TYPE_WITH_CODE (
 ****  UPOWER DBUS
 ***/
 
+/* UPower's electrical readings. These don't change what the menus show,
+   so changes to them alone don't emit devices-changed. */
+static const struct
+{
+  const char * key;
+  const char * property;
+}
+upower_metrics[] =
+{
+  { "EnergyRate",       INDICATOR_POWER_DEVICE_ENERGY_RATE },
+  { "Energy",           INDICATOR_POWER_DEVICE_ENERGY },
+  { "EnergyFull",       INDICATOR_POWER_DEVICE_ENERGY_FULL },
+  { "EnergyFullDesign", INDICATOR_POWER_DEVICE_ENERGY_FULL_DESIGN },
+  { "Voltage",          INDICATOR_POWER_DEVICE_VOLTAGE },
+  { "Temperature",      INDICATOR_POWER_DEVICE_TEMPERATURE },
+  { "Capacity",         INDICATOR_POWER_DEVICE_CAPACITY }
+};
+
+static const char *
+get_metric_property (const char * key)
+{
+  guint i;
+
+  for (i=0; i<G_N_ELEMENTS(upower_metrics); ++i)
+    if (!g_strcmp0 (key, upower_metrics[i].key))
+      return upower_metrics[i].property;
+
+  return NULL;
+}
+
+static void
+set_metrics_from_dict (IndicatorPowerDevice * device, GVariant * dict)
+{
+  guint i;
+
+  g_object_freeze_notify (G_OBJECT(device));
+
+  for (i=0; i<G_N_ELEMENTS(upower_metrics); ++i)
+    {
+      gdouble d;
+
+      if (g_variant_lookup (dict, upower_metrics[i].key, "d", &d))
+        g_object_set (device, upower_metrics[i].property, d, NULL);
+    }
+
+  g_object_thaw_notify (G_OBJECT(device));
+}
+
 struct device_get_all_data
 {
   char * path;
   IndicatorPowerDeviceProviderUPower * self;
+  guint resume_generation; /* 0 if this isn't a resume refresh */
 };
 
 static void
@@ -88,6 +150,23 @@ emit_devices_changed (IndicatorPowerDeviceProviderUPower * self)
   indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
 }
 
+static void
+on_resume_refresh_done (IndicatorPowerDeviceProviderUPower * self,
+                        guint                                generation)
+{
+  priv_t * p = get_priv(self);
+
+  if ((generation == 0) || (generation != p->resume_generation))
+    return;
+
+  if ((p->resume_pending == 0) || (--p->resume_pending > 0))
+    return;
+
+  g_debug ("resume: power supplies refreshed after %.1f ms",
+           (g_get_monotonic_time() - p->resume_time) / 1000.0);
+  p->resume_time = 0;
+}
+
 static void
 on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
 {
@@ -100,8 +179,12 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
   if (error != NULL)
     {
       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        g_warning ("Error getting properties for UPower device '%s': %s",
-                   data->path, error->message);
+        {
+          g_warning ("Error getting properties for UPower device '%s': %s",
+                     data->path, error->message);
+
+          on_resume_refresh_done (data->self, data->resume_generation);
+        }
 
       g_error_free (error);
     }
@@ -152,7 +235,11 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
           g_object_unref (device);
         }
 
+      set_metrics_from_dict (device, dict);
+
       emit_devices_changed (data->self);
+
+      on_resume_refresh_done (data->self, data->resume_generation);
       g_variant_unref (dict);
       g_variant_unref (response);
     }
@@ -163,7 +250,8 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
 
 static void
 update_device_from_object_path (IndicatorPowerDeviceProviderUPower * self,
-                                const char                         * path)
+                                const char                         * path,
+                                guint                                resume_generation)
 {
   priv_t * p = get_priv(self);
   struct device_get_all_data * data;
@@ -177,6 +265,7 @@ update_device_from_object_path (IndicatorPowerDeviceProviderUPower * self,
   data = g_slice_new (struct device_get_all_data);
   data->path = g_strdup (path);
   data->self = self;
+  data->resume_generation = resume_generation;
 
   g_dbus_connection_call(p->bus,
                          BUS_NAME,
@@ -216,7 +305,7 @@ on_queued_paths_timer(gpointer gself)
   /* create new devices for all the queued paths */
   g_hash_table_iter_init (&iter, p->queued_paths);
   while (g_hash_table_iter_next (&iter, &path, NULL))
-    update_device_from_object_path (self, path);
+    update_device_from_object_path (self, path, 0);
 
   /* cleanup */
   g_hash_table_remove_all (p->queued_paths);
@@ -265,16 +354,24 @@ on_enumerate_devices_response(GObject       * bus,
       GVariant * ao;
       GVariantIter iter;
       const gchar * path;
+      guint n_queued = 0;
 
       ao = g_variant_get_child_value(v, 0);
       g_variant_iter_init(&iter, ao);
       path = NULL;
       while(g_variant_iter_loop(&iter, "o", &path)) {
         // Android: Ignore batt_therm devices since they give wrong values
-        if (!g_str_has_suffix(path, "batt_therm"))
+        if (!g_str_has_suffix(path, "batt_therm")) {
           refresh_device_soon (gself, path);
+          ++n_queued;
+        }
       }
 
+      /* nothing to fetch, so say now that there's nothing
+         instead of leaving listeners waiting for devices */
+      if (n_queued == 0)
+        emit_devices_changed (gself);
+
       g_variant_unref(ao);
     }
 
@@ -317,7 +414,16 @@ on_device_properties_changed(GDBusConnection * connection     G_GNUC_UNUSED,
       g_variant_iter_init(&iter, dict);
       while (g_variant_iter_next(&iter, "{sv}", &key, &value))
         {
-          if (!g_strcmp0(key, "TimeToFull") || !g_strcmp0(key, "TimeToEmpty"))
+          const char* metric_property = get_metric_property(key);
+
+          if (metric_property != NULL)
+            {
+              if (g_variant_is_of_type(value, G_VARIANT_TYPE_DOUBLE))
+                g_object_set(device,
+                             metric_property, g_variant_get_double(value),
+                             NULL);
+            }
+          else if (!g_strcmp0(key, "TimeToFull") || !g_strcmp0(key, "TimeToEmpty"))
             {
               const gint64 i = g_variant_get_int64(value);
               if (i != 0)
@@ -379,6 +485,85 @@ get_path_from_nth_child(GVariant* parameters, gsize i)
   return path;
 }
 
+/*
+ * After a resume, every reading is stale. The system's own batteries and
+ * line power decide what the header shows, so they're fetched right away;
+ * peripherals join the usual batch once the main loop has nothing better
+ * to do.
+ */
+
+static gboolean
+on_resume_idle (gpointer gself)
+{
+  IndicatorPowerDeviceProviderUPower * self;
+  priv_t * p;
+  GHashTableIter iter;
+  gpointer path;
+  gpointer device;
+
+  self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER (gself);
+  p = get_priv(self);
+  p->resume_idle = 0;
+
+  g_hash_table_iter_init (&iter, p->devices);
+  while (g_hash_table_iter_next (&iter, &path, &device))
+    if (!indicator_power_device_get_power_supply (device))
+      refresh_device_soon (self, path);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+refresh_after_resume (IndicatorPowerDeviceProviderUPower * self)
+{
+  priv_t * p = get_priv(self);
+  GHashTableIter iter;
+  gpointer path;
+  gpointer device;
+
+  p->resume_time = g_get_monotonic_time();
+  p->resume_pending = 0;
+  if (++p->resume_generation == 0)
+    p->resume_generation = 1;
+
+  g_hash_table_iter_init (&iter, p->devices);
+  while (g_hash_table_iter_next (&iter, &path, &device))
+    {
+      if (indicator_power_device_get_power_supply (device))
+        {
+          g_hash_table_remove (p->queued_paths, path);
+          update_device_from_object_path (self, path, p->resume_generation);
+          ++p->resume_pending;
+        }
+    }
+
+  g_debug ("resume: refreshing %u power supplies now, peripherals later",
+           p->resume_pending);
+
+  if (p->resume_idle == 0)
+    p->resume_idle = g_idle_add_full (G_PRIORITY_LOW, on_resume_idle, self, NULL);
+}
+
+static void
+on_prepare_for_sleep (GDBusConnection * connection     G_GNUC_UNUSED,
+                      const gchar     * sender_name    G_GNUC_UNUSED,
+                      const gchar     * object_path    G_GNUC_UNUSED,
+                      const gchar     * interface_name G_GNUC_UNUSED,
+                      const gchar     * signal_name    G_GNUC_UNUSED,
+                      GVariant        * parameters,
+                      gpointer          gself)
+{
+  gboolean going_to_sleep = FALSE;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE("(b)")))
+    return;
+
+  g_variant_get (parameters, "(b)", &going_to_sleep);
+
+  if (!going_to_sleep)
+    refresh_after_resume (INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself));
+}
+
 static void
 on_upower_signal(GDBusConnection * connection     G_GNUC_UNUSED,
                  const gchar     * sender_name    G_GNUC_UNUSED,
@@ -411,12 +596,8 @@ on_upower_signal(GDBusConnection * connection     G_GNUC_UNUSED,
     }
   else if (!g_strcmp0(signal_name, "Resuming")) /* UPower < 0.99 */
     {
-      GHashTableIter iter;
-      gpointer device_path = NULL;
-      g_debug("Resumed from hibernate/sleep; queueing all devices for a refresh");
-      g_hash_table_iter_init (&iter, p->devices);
-      while (g_hash_table_iter_next (&iter, &device_path, NULL))
-        refresh_device_soon (self, device_path);
+      g_debug("Resumed from hibernate/sleep");
+      refresh_after_resume (self);
     }
 }
 
@@ -461,6 +642,19 @@ on_bus_name_appeared(GDBusConnection * bus,
                                            NULL);
   p->subscriptions = g_slist_prepend(p->subscriptions, GUINT_TO_POINTER(tag));
 
+  /* UPower >= 0.99 doesn't say when the system resumes, but logind does */
+  tag = g_dbus_connection_signal_subscribe(p->bus,
+                                           LOGIND_BUS_NAME,
+                                           LOGIND_IFACE,
+                                           "PrepareForSleep",
+                                           LOGIND_PATH,
+                                           NULL /*arg0*/,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           on_prepare_for_sleep,
+                                           self,
+                                           NULL);
+  p->subscriptions = g_slist_prepend(p->subscriptions, GUINT_TO_POINTER(tag));
+
   /* rebuild our devices list */
   g_dbus_connection_call(p->bus,
                          BUS_NAME,
@@ -496,6 +690,13 @@ on_bus_name_vanished(GDBusConnection * connection G_GNUC_UNUSED,
       g_source_remove(p->queued_paths_timer);
       p->queued_paths_timer = 0;
     }
+  if (p->resume_idle != 0)
+    {
+      g_source_remove(p->resume_idle);
+      p->resume_idle = 0;
+    }
+  p->resume_pending = 0;
+  p->resume_time = 0;
   emit_devices_changed (self);
 
   /* clear the bus subscriptions */
@@ -615,14 +816,6 @@ indicator_power_device_provider_upower_init (IndicatorPowerDeviceProviderUPower
                                           g_str_equal,
                                           g_free,
                                           NULL);
-
-  p->name_tag = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-                                 BUS_NAME,
-                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
-                                 on_bus_name_appeared,
-                                 on_bus_name_vanished,
-                                 self,
-                                 NULL);
 }
 
 /***
@@ -634,5 +827,33 @@ indicator_power_device_provider_upower_new(void)
 {
   gpointer o = g_object_new (INDICATOR_TYPE_POWER_DEVICE_PROVIDER_UPOWER, NULL);
 
+  get_priv(o)->name_tag = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
+                                           BUS_NAME,
+                                           G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                           on_bus_name_appeared,
+                                           on_bus_name_vanished,
+                                           o,
+                                           NULL);
+
+  return INDICATOR_POWER_DEVICE_PROVIDER (o);
+}
+
+IndicatorPowerDeviceProvider *
+indicator_power_device_provider_upower_new_for_bus(GDBusConnection * bus)
+{
+  gpointer o;
+
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION(bus), NULL);
+
+  o = g_object_new (INDICATOR_TYPE_POWER_DEVICE_PROVIDER_UPOWER, NULL);
+
+  get_priv(o)->name_tag = g_bus_watch_name_on_connection(bus,
+                                                         BUS_NAME,
+                                                         G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                         on_bus_name_appeared,
+                                                         on_bus_name_vanished,
+                                                         o,
+                                                         NULL);
+
   return INDICATOR_POWER_DEVICE_PROVIDER (o);
 }
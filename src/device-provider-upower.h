@@ -21,6 +21,7 @@
 #define __INDICATOR_POWER_DEVICE_PROVIDER_UPOWER__H__
 
 #include <glib-object.h> /* parent class */
+#include <gio/gio.h>
 
 #include "device-provider.h"
 
@@ -65,6 +66,9 @@ GType indicator_power_device_provider_upower_get_type (void);
 
 IndicatorPowerDeviceProvider * indicator_power_device_provider_upower_new (void);
 
+/* Watches for UPower on the given connection instead of the system bus */
+IndicatorPowerDeviceProvider * indicator_power_device_provider_upower_new_for_bus (GDBusConnection * bus);
+
 G_END_DECLS
 
 #endif /* __INDICATOR_POWER_DEVICE_PROVIDER_UPOWER__H__ */
@@ -31,6 +31,7 @@ License along with this library. If not, see
 #include <gio/gio.h>
 
 #include "device.h"
+#include "estimator.h"
 
 struct _IndicatorPowerDevicePrivate
 {
@@ -45,8 +46,17 @@ struct _IndicatorPowerDevicePrivate
      This is used when generating the time-remaining string. */
   GTimer * inestimable;
   gboolean power_supply;
+
+  /* floats are plenty for these, and keep each device small */
+  gfloat metrics[INDICATOR_POWER_DEVICE_N_METRICS];
+
+  /* fills in the time-remaining when the provider doesn't report one */
+  IndicatorPowerEstimator * estimator;
 };
 
+/* estimates less trustworthy than this aren't shown */
+#define MIN_ESTIMATE_CONFIDENCE 0.5
+
 /* Properties */
 /* Enum for the properties so that they can be quickly found and looked up. */
 enum {
@@ -57,9 +67,19 @@ enum {
   PROP_PERCENTAGE,
   PROP_TIME,
   PROP_POWER_SUPPLY,
+  /* these follow IndicatorPowerDeviceMetric's order */
+  PROP_ENERGY_RATE,
+  PROP_ENERGY,
+  PROP_ENERGY_FULL,
+  PROP_ENERGY_FULL_DESIGN,
+  PROP_VOLTAGE,
+  PROP_TEMPERATURE,
+  PROP_CAPACITY,
   N_PROPERTIES
 };
 
+#define METRIC_FOR_PROP(prop_id) ((IndicatorPowerDeviceMetric)((prop_id) - PROP_ENERGY_RATE))
+
 static GParamSpec * properties[N_PROPERTIES];
 
 /* GObject stuff */
@@ -124,6 +144,55 @@ indicator_power_device_class_init (IndicatorPowerDeviceClass *klass)
                                                         FALSE,
                                                         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_ENERGY_RATE] = g_param_spec_double (INDICATOR_POWER_DEVICE_ENERGY_RATE,
+                                                      "energy rate",
+                                                      "Power draw, in W",
+                                                      -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                      0.0,
+                                                      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ENERGY] = g_param_spec_double (INDICATOR_POWER_DEVICE_ENERGY,
+                                                 "energy",
+                                                 "Energy left, in Wh",
+                                                 -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                 0.0,
+                                                 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ENERGY_FULL] = g_param_spec_double (INDICATOR_POWER_DEVICE_ENERGY_FULL,
+                                                      "energy full",
+                                                      "Energy when full, in Wh",
+                                                      -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                      0.0,
+                                                      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ENERGY_FULL_DESIGN] = g_param_spec_double (INDICATOR_POWER_DEVICE_ENERGY_FULL_DESIGN,
+                                                             "energy full design",
+                                                             "Designed energy when full, in Wh",
+                                                             -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                             0.0,
+                                                             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_VOLTAGE] = g_param_spec_double (INDICATOR_POWER_DEVICE_VOLTAGE,
+                                                  "voltage",
+                                                  "Voltage, in V",
+                                                  -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                  0.0,
+                                                  G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_TEMPERATURE] = g_param_spec_double (INDICATOR_POWER_DEVICE_TEMPERATURE,
+                                                      "temperature",
+                                                      "Temperature, in degrees Celsius",
+                                                      -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                      0.0,
+                                                      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_CAPACITY] = g_param_spec_double (INDICATOR_POWER_DEVICE_CAPACITY,
+                                                   "capacity",
+                                                   "Energy full as a percentage of energy full design",
+                                                   -G_MAXDOUBLE, G_MAXDOUBLE,
+                                                   0.0,
+                                                   G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, N_PROPERTIES, properties);
 }
 
@@ -140,6 +209,7 @@ indicator_power_device_init (IndicatorPowerDevice *self)
   priv->percentage = 0.0;
   priv->time = 0;
   priv->power_supply = FALSE;
+  priv->estimator = indicator_power_estimator_new ();
 
   self->priv = priv;
 }
@@ -162,6 +232,7 @@ indicator_power_device_finalize (GObject *object)
   IndicatorPowerDevicePrivate * priv = self->priv;
 
   g_clear_pointer (&priv->object_path, g_free);
+  g_clear_pointer (&priv->estimator, indicator_power_estimator_free);
 
   G_OBJECT_CLASS (indicator_power_device_parent_class)->finalize (object);
 }
@@ -170,6 +241,19 @@ indicator_power_device_finalize (GObject *object)
 ****
 ***/
 
+/* the reported time remaining, or our own estimate if there isn't one */
+static time_t
+get_time_remaining (const IndicatorPowerDevicePrivate * p)
+{
+  if (p->time > 0)
+    return p->time;
+
+  if (indicator_power_estimator_get_confidence (p->estimator) >= MIN_ESTIMATE_CONFIDENCE)
+    return indicator_power_estimator_get_time (p->estimator);
+
+  return 0;
+}
+
 static void
 get_property (GObject * o, guint  prop_id, GValue * value, GParamSpec * pspec)
 {
@@ -202,6 +286,16 @@ get_property (GObject * o, guint  prop_id, GValue * value, GParamSpec * pspec)
         g_value_set_boolean (value, priv->power_supply);
         break;
 
+      case PROP_ENERGY_RATE:
+      case PROP_ENERGY:
+      case PROP_ENERGY_FULL:
+      case PROP_ENERGY_FULL_DESIGN:
+      case PROP_VOLTAGE:
+      case PROP_TEMPERATURE:
+      case PROP_CAPACITY:
+        g_value_set_double (value, priv->metrics[METRIC_FOR_PROP(prop_id)]);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(o, prop_id, pspec);
         break;
@@ -241,18 +335,34 @@ set_property (GObject * o, guint prop_id, const GValue * value, GParamSpec * psp
         p->power_supply = g_value_get_boolean (value);
         break;
 
+      case PROP_ENERGY_RATE:
+      case PROP_ENERGY:
+      case PROP_ENERGY_FULL:
+      case PROP_ENERGY_FULL_DESIGN:
+      case PROP_VOLTAGE:
+      case PROP_TEMPERATURE:
+      case PROP_CAPACITY:
+        p->metrics[METRIC_FOR_PROP(prop_id)] = (gfloat) g_value_get_double (value);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(o, prop_id, pspec);
         break;
     }
 
+  if ((prop_id == PROP_STATE) || (prop_id == PROP_PERCENTAGE))
+    indicator_power_estimator_add_sample (p->estimator,
+                                          g_get_monotonic_time (),
+                                          p->percentage,
+                                          p->state);
+
   /**
    * Check to see if the time-remaining value is estimable.
    * When it first becomes inestimable, kick off a timer because
    * we need to track that to generate the appropriate title text.
    */
 
-  const gboolean is_inestimable = (p->time == 0)
+  const gboolean is_inestimable = (get_time_remaining (p) == 0)
                                && (p->state != UP_DEVICE_STATE_FULLY_CHARGED)
                                && (p->percentage > 0);
 
@@ -317,7 +427,32 @@ indicator_power_device_get_time (const IndicatorPowerDevice * device)
   g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), (time_t)0);
   /* LCOV_EXCL_STOP */
 
-  return device->priv->time;
+  return get_time_remaining (device->priv);
+}
+
+gdouble
+indicator_power_device_get_time_confidence (const IndicatorPowerDevice * device)
+{
+  /* LCOV_EXCL_START */
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), 0.0);
+  /* LCOV_EXCL_STOP */
+
+  if (device->priv->time > 0)
+    return 1.0;
+
+  return indicator_power_estimator_get_confidence (device->priv->estimator);
+}
+
+gdouble
+indicator_power_device_get_metric (const IndicatorPowerDevice * device,
+                                   IndicatorPowerDeviceMetric   metric)
+{
+  /* LCOV_EXCL_START */
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), 0.0);
+  g_return_val_if_fail (metric < INDICATOR_POWER_DEVICE_N_METRICS, 0.0);
+  /* LCOV_EXCL_STOP */
+
+  return device->priv->metrics[metric];
 }
 
 gboolean
@@ -590,10 +725,11 @@ get_brief_time_remaining (const IndicatorPowerDevice * device)
 {
   gchar * str = NULL;
   const IndicatorPowerDevicePrivate * p = device->priv;
+  const time_t seconds = get_time_remaining (p);
 
-  if (p->time > 0)
+  if (seconds > 0)
     {
-      int minutes = p->time / 60;
+      int minutes = seconds / 60;
       const int hours = minutes / 60;
       minutes %= 60;
 
@@ -628,10 +764,11 @@ get_expanded_time_remaining (const IndicatorPowerDevice * device)
 {
   char * str = NULL;
   const IndicatorPowerDevicePrivate * p = device->priv;
+  const time_t seconds = get_time_remaining (p);
 
-  if (p->time && ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING)))
+  if (seconds && ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING)))
     {
-      int minutes = p->time / 60;
+      int minutes = seconds / 60;
       const int hours = minutes / 60;
       minutes %= 60;
 
@@ -665,10 +802,11 @@ get_accessible_time_remaining (const IndicatorPowerDevice * device)
 {
   char * str = NULL;
   const IndicatorPowerDevicePrivate * p = device->priv;
+  const time_t seconds = get_time_remaining (p);
 
-  if (p->time && ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING)))
+  if (seconds && ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING)))
     {
-      guint minutes = (guint)p->time / 60u;
+      guint minutes = (guint)seconds / 60u;
       const guint hours = minutes / 60u;
       minutes %= 60;
 
@@ -730,7 +868,7 @@ time_is_relevant (const IndicatorPowerDevice * device)
   if (p->state == UP_DEVICE_STATE_CHARGING)
     return TRUE;
 
-  if ((p->state == UP_DEVICE_STATE_DISCHARGING) && (p->time<(24*60*60)))
+  if ((p->state == UP_DEVICE_STATE_DISCHARGING) && (get_time_remaining (p)<(24*60*60)))
     return TRUE;
 
   return FALSE;
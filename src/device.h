@@ -46,6 +46,28 @@ typedef struct _IndicatorPowerDevicePrivate IndicatorPowerDevicePrivate;
 #define INDICATOR_POWER_DEVICE_TIME         "time"
 #define INDICATOR_POWER_DEVICE_POWER_SUPPLY "power-supply"
 
+#define INDICATOR_POWER_DEVICE_ENERGY_RATE        "energy-rate"
+#define INDICATOR_POWER_DEVICE_ENERGY             "energy"
+#define INDICATOR_POWER_DEVICE_ENERGY_FULL        "energy-full"
+#define INDICATOR_POWER_DEVICE_ENERGY_FULL_DESIGN "energy-full-design"
+#define INDICATOR_POWER_DEVICE_VOLTAGE            "voltage"
+#define INDICATOR_POWER_DEVICE_TEMPERATURE        "temperature"
+#define INDICATOR_POWER_DEVICE_CAPACITY           "capacity"
+
+/* Electrical readings, in UPower's units. 0 if the provider doesn't know. */
+typedef enum
+{
+  INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE,        /* W */
+  INDICATOR_POWER_DEVICE_METRIC_ENERGY,             /* Wh */
+  INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL,        /* Wh */
+  INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL_DESIGN, /* Wh */
+  INDICATOR_POWER_DEVICE_METRIC_VOLTAGE,            /* V */
+  INDICATOR_POWER_DEVICE_METRIC_TEMPERATURE,        /* degrees Celsius */
+  INDICATOR_POWER_DEVICE_METRIC_CAPACITY,           /* % of the design capacity */
+  INDICATOR_POWER_DEVICE_N_METRICS
+}
+IndicatorPowerDeviceMetric;
+
 typedef enum
 {
   UP_DEVICE_KIND_UNKNOWN,
@@ -123,7 +145,10 @@ UpDeviceState indicator_power_device_get_state             (const IndicatorPower
 const gchar * indicator_power_device_get_object_path       (const IndicatorPowerDevice * device);
 gdouble       indicator_power_device_get_percentage        (const IndicatorPowerDevice * device);
 time_t        indicator_power_device_get_time              (const IndicatorPowerDevice * device);
+gdouble       indicator_power_device_get_time_confidence   (const IndicatorPowerDevice * device);
 gboolean      indicator_power_device_get_power_supply      (const IndicatorPowerDevice * device);
+gdouble       indicator_power_device_get_metric            (const IndicatorPowerDevice * device,
+                                                            IndicatorPowerDeviceMetric   metric);
 
 GStrv         indicator_power_device_get_icon_names        (const IndicatorPowerDevice * device);
 GIcon       * indicator_power_device_get_gicon             (const IndicatorPowerDevice * device);
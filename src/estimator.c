@@ -0,0 +1,195 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "estimator.h"
+
+#include <math.h> /* pow(), sqrt() */
+
+/* weight of the newest rate in the moving averages */
+#define ALPHA 0.3
+
+struct _IndicatorPowerEstimator
+{
+  UpDeviceState state;
+  gdouble percentage;
+
+  /* where the percentage last changed. Percentages are quantized,
+     so the time of the first change after a reset is the earliest
+     point that an interval can be measured from. */
+  gboolean have_anchor;
+  gint64 anchor_time;
+  gdouble anchor_percentage;
+
+  /* in percent per second, always positive */
+  guint n_rates;
+  gdouble rate;
+  gdouble rate_variance;
+};
+
+/***
+****
+***/
+
+static gboolean
+is_estimable_state (UpDeviceState state)
+{
+  return (state == UP_DEVICE_STATE_CHARGING) || (state == UP_DEVICE_STATE_DISCHARGING);
+}
+
+static void
+set_anchor (IndicatorPowerEstimator * self, gint64 time_usec, gdouble percentage)
+{
+  self->have_anchor = TRUE;
+  self->anchor_time = time_usec;
+  self->anchor_percentage = percentage;
+}
+
+static void
+add_rate (IndicatorPowerEstimator * self, gdouble rate)
+{
+  if (self->n_rates == 0)
+    {
+      self->rate = rate;
+      self->rate_variance = 0.0;
+    }
+  else
+    {
+      /* incremental exponentially-weighted mean and variance */
+      const gdouble diff = rate - self->rate;
+      const gdouble incr = ALPHA * diff;
+
+      self->rate += incr;
+      self->rate_variance = (1.0 - ALPHA) * (self->rate_variance + diff * incr);
+    }
+
+  self->n_rates++;
+}
+
+/***
+****
+***/
+
+IndicatorPowerEstimator *
+indicator_power_estimator_new (void)
+{
+  IndicatorPowerEstimator * self = g_new (IndicatorPowerEstimator, 1);
+
+  indicator_power_estimator_reset (self);
+
+  return self;
+}
+
+void
+indicator_power_estimator_free (IndicatorPowerEstimator * self)
+{
+  g_free (self);
+}
+
+void
+indicator_power_estimator_reset (IndicatorPowerEstimator * self)
+{
+  g_return_if_fail (self != NULL);
+
+  self->state = UP_DEVICE_STATE_UNKNOWN;
+  self->percentage = 0.0;
+  self->have_anchor = FALSE;
+  self->anchor_time = 0;
+  self->anchor_percentage = 0.0;
+  self->n_rates = 0;
+  self->rate = 0.0;
+  self->rate_variance = 0.0;
+}
+
+void
+indicator_power_estimator_add_sample (IndicatorPowerEstimator * self,
+                                      gint64                    time_usec,
+                                      gdouble                   percentage,
+                                      UpDeviceState             state)
+{
+  gdouble delta;
+  gint64 elapsed;
+
+  g_return_if_fail (self != NULL);
+
+  /* a new direction needs a new rate */
+  if (state != self->state)
+    {
+      indicator_power_estimator_reset (self);
+      self->state = state;
+      self->percentage = percentage;
+      return;
+    }
+
+  if (!is_estimable_state (state) || (percentage == self->percentage))
+    return;
+
+  self->percentage = percentage;
+
+  if (!self->have_anchor)
+    {
+      set_anchor (self, time_usec, percentage);
+      return;
+    }
+
+  delta = percentage - self->anchor_percentage;
+  if (state == UP_DEVICE_STATE_DISCHARGING)
+    delta = -delta;
+  elapsed = time_usec - self->anchor_time;
+
+  /* a jump the wrong way (e.g. a recalibration) isn't a rate;
+     just measure the next interval from here */
+  if ((delta > 0.0) && (elapsed > 0))
+    add_rate (self, delta / ((gdouble)elapsed / G_USEC_PER_SEC));
+
+  set_anchor (self, time_usec, percentage);
+}
+
+time_t
+indicator_power_estimator_get_time (const IndicatorPowerEstimator * self)
+{
+  gdouble remaining;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  if ((self->n_rates == 0) || (self->rate <= 0.0))
+    return 0;
+
+  remaining = self->state == UP_DEVICE_STATE_CHARGING
+            ? 100.0 - self->percentage
+            : self->percentage;
+
+  return (time_t)(MAX (remaining, 0.0) / self->rate);
+}
+
+gdouble
+indicator_power_estimator_get_confidence (const IndicatorPowerEstimator * self)
+{
+  gdouble warmup;
+  gdouble variation;
+
+  g_return_val_if_fail (self != NULL, 0.0);
+
+  if ((self->n_rates == 0) || (self->rate <= 0.0))
+    return 0.0;
+
+  /* grows 0.3, 0.51, 0.66... as more rates are averaged in */
+  warmup = 1.0 - pow (1.0 - ALPHA, self->n_rates);
+
+  /* coefficient of variation */
+  variation = sqrt (self->rate_variance) / self->rate;
+
+  return warmup / (1.0 + variation);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDICATOR_POWER_ESTIMATOR__H
+#define INDICATOR_POWER_ESTIMATOR__H
+
+#include <glib.h>
+#include <time.h>
+
+#include "device.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Estimates a device's time remaining from its percentage changes,
+ * for providers that don't report one.
+ *
+ * Each percentage change updates an exponentially-weighted moving
+ * average of the charge rate, and of its variance, in O(1). The
+ * confidence grows with the number of updates and shrinks as the
+ * rate gets noisier.
+ */
+typedef struct _IndicatorPowerEstimator IndicatorPowerEstimator;
+
+IndicatorPowerEstimator * indicator_power_estimator_new        (void);
+
+void    indicator_power_estimator_free           (IndicatorPowerEstimator * estimator);
+
+void    indicator_power_estimator_reset          (IndicatorPowerEstimator * estimator);
+
+/* time_usec is from a monotonic clock, e.g. g_get_monotonic_time() */
+void    indicator_power_estimator_add_sample     (IndicatorPowerEstimator * estimator,
+                                                  gint64                    time_usec,
+                                                  gdouble                   percentage,
+                                                  UpDeviceState             state);
+
+/* seconds until empty or full, or 0 if there's no estimate yet */
+time_t  indicator_power_estimator_get_time       (const IndicatorPowerEstimator * estimator);
+
+/* how far to trust the estimate, from 0 (not at all) to 1 */
+gdouble indicator_power_estimator_get_confidence (const IndicatorPowerEstimator * estimator);
+
+G_END_DECLS
+
+#endif /* INDICATOR_POWER_ESTIMATOR__H */
@@ -17,86 +17,542 @@
  *   Marius Gripsgard <marius@ubports.com>
  */
 
+
 #include "flashlight.h"
 
 #include <gio/gio.h>
-#include <stdio.h>
+
+#include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
-#define QCOM_ENABLE "255"
-#define QCOM_DISABLE "0"
+#define DEFAULT_LEDS_DIR "/sys/class/leds"
+
+/* LEDs we know about, in order of preference. If none of
+   these are present, any LED named *torch* or *flash* is used. */
+static const char * const known_leds[] = { "torch-light",
+                                           "led:flash_torch",
+                                           "flashlight",
+                                           "torch-light0",
+                                           "torch-light1" };
+
+/* some Qualcomm devices need this toggled as well */
+#define QCOM_SWITCH_LED "led:switch"
+
+/* used if the LED doesn't tell us its max_brightness */
+#define DEFAULT_ON_BRIGHTNESS 255
+
+enum
+{
+  PROP_0,
+  PROP_ACTIVE,
+  LAST_PROP
+};
+
+static GParamSpec* properties[LAST_PROP];
 
-const size_t qcom_sysfs_size = 5;
-const char* const qcom_sysfs[] = {"/sys/class/leds/torch-light/brightness",
-                                  "/sys/class/leds/led:flash_torch/brightness",
-                                  "/sys/class/leds/flashlight/brightness",
-                                  "/sys/class/leds/torch-light0/brightness",
-                                  "/sys/class/leds/torch-light1/brightness"};
+typedef struct
+{
+  char * brightness_path;
+  char * state_path; /* whichever file says if it's on; see probe() */
+  int brightness_fd;
+  int switch_fd;
+  int on_brightness;
+
+  GFileMonitor * monitor;
+
+  gboolean active;
+  gboolean write_in_flight;
+}
+IndicatorPowerFlashlightPrivate;
+
+typedef IndicatorPowerFlashlightPrivate priv_t;
 
-const char* qcom_torch_enable = "/sys/class/leds/led:switch/brightness";
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerFlashlight,
+                           indicator_power_flashlight,
+                           G_TYPE_OBJECT)
 
-char* flash_sysfs_path = NULL;
-gboolean activated = 0;
+#define get_priv(o) ((priv_t*)indicator_power_flashlight_get_instance_private(o))
 
-int
-set_sysfs_path()
+/***
+****  sysfs helpers
+***/
+
+static gboolean
+read_int(const char * path, int * setme)
 {
-  for (size_t i = 0; i < qcom_sysfs_size; i++) {
-    if (access(qcom_sysfs[i], F_OK ) != -1){
-        flash_sysfs_path = (char*)qcom_sysfs[i];
-        return 1;
+  gchar * contents = NULL;
+  gboolean success = FALSE;
+
+  if (g_file_get_contents(path, &contents, NULL, NULL))
+    {
+      char * end = NULL;
+      const long val = strtol(contents, &end, 10);
+
+      if (end != contents)
+        {
+          *setme = (int) val;
+          success = TRUE;
+        }
+
+      g_free(contents);
     }
-  }
-  return 0;
+
+  return success;
+}
+
+static int
+open_for_writing(const char * path)
+{
+  const int fd = open(path, O_WRONLY|O_CLOEXEC);
+
+  if (fd < 0)
+    g_debug("Unable to open '%s' for writing: %s", path, g_strerror(errno));
+
+  return fd;
+}
+
+/* sysfs attributes are rewritten from the start each time */
+static gboolean
+write_int(int fd, int value)
+{
+  char buf[16];
+  const int len = g_snprintf(buf, sizeof(buf), "%d\n", value);
+
+  const ssize_t n = pwrite(fd, buf, len, 0);
+
+  if (n != len)
+    {
+      /* a short write has no errno of its own */
+      if (n >= 0)
+        errno = EIO;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* g_ptr_array_sort() passes pointers to the elements */
+static int
+compare_names(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0(*(const char * const *)a, *(const char * const *)b);
+}
+
+static gchar *
+find_led(const char * leds_dir)
+{
+  GDir * dir;
+  GPtrArray * names;
+  const char * name;
+  gchar * found = NULL;
+  guint i;
+
+  for (i=0; i<G_N_ELEMENTS(known_leds); ++i)
+    {
+      gchar * path = g_build_filename(leds_dir, known_leds[i], "brightness", NULL);
+      const gboolean exists = g_file_test(path, G_FILE_TEST_EXISTS);
+      g_free(path);
+
+      if (exists)
+        return g_strdup(known_leds[i]);
+    }
+
+  if ((dir = g_dir_open(leds_dir, 0, NULL)) == NULL)
+    return NULL;
+
+  names = g_ptr_array_new_with_free_func(g_free);
+  while ((name = g_dir_read_name(dir)))
+    if (strstr(name, "torch") || strstr(name, "flash"))
+      g_ptr_array_add(names, g_strdup(name));
+  g_dir_close(dir);
+
+  /* sort so the choice doesn't depend on readdir() */
+  g_ptr_array_sort(names, compare_names);
+  for (i=0; (found == NULL) && (i<names->len); ++i)
+    {
+      gchar * path = g_build_filename(leds_dir, g_ptr_array_index(names, i), "brightness", NULL);
+
+      if (g_file_test(path, G_FILE_TEST_EXISTS))
+        found = g_strdup(g_ptr_array_index(names, i));
+
+      g_free(path);
+    }
+
+  g_ptr_array_free(names, TRUE);
+  return found;
+}
+
+/***
+****  Watching for external changes
+***/
+
+static void
+update_active_from_sysfs(IndicatorPowerFlashlight * self)
+{
+  priv_t * p = get_priv(self);
+  int brightness;
+
+  if (read_int(p->state_path, &brightness) && (p->active != (brightness > 0)))
+    {
+      p->active = brightness > 0;
+      g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_ACTIVE]);
+    }
+}
+
+static void
+on_brightness_file_changed(GFileMonitor      * monitor    G_GNUC_UNUSED,
+                           GFile             * file       G_GNUC_UNUSED,
+                           GFile             * other_file G_GNUC_UNUSED,
+                           GFileMonitorEvent   event_type,
+                           gpointer            gself)
+{
+  if ((event_type == G_FILE_MONITOR_EVENT_CHANGED) ||
+      (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT))
+    update_active_from_sysfs(INDICATOR_POWER_FLASHLIGHT(gself));
+}
+
+/***
+****  Probing
+***/
+
+static void
+probe(IndicatorPowerFlashlight * self, const char * leds_dir)
+{
+  priv_t * p = get_priv(self);
+  gchar * led;
+  gchar * path;
+  GFile * file;
+  GError * error;
+  int brightness;
+  int max_brightness;
+
+  if ((led = find_led(leds_dir)) == NULL)
+    return;
+
+  p->brightness_path = g_build_filename(leds_dir, led, "brightness", NULL);
+  p->brightness_fd = open_for_writing(p->brightness_path);
+
+  /* use 255 as before, unless the LED can't go that high */
+  p->on_brightness = DEFAULT_ON_BRIGHTNESS;
+  path = g_build_filename(leds_dir, led, "max_brightness", NULL);
+  if (read_int(path, &max_brightness) && (max_brightness > 0))
+    p->on_brightness = MIN(max_brightness, DEFAULT_ON_BRIGHTNESS);
+  g_free(path);
+
+  /* led:switch is what turns those LEDs off, leaving the torch's
+     brightness where it was, so it's the one that says if it's on */
+  path = g_build_filename(leds_dir, QCOM_SWITCH_LED, "brightness", NULL);
+  if (g_file_test(path, G_FILE_TEST_EXISTS))
+    p->switch_fd = open_for_writing(path);
+  if (p->switch_fd >= 0)
+    {
+      p->state_path = path;
+    }
+  else
+    {
+      p->state_path = g_strdup(p->brightness_path);
+      g_free(path);
+    }
+
+  p->active = read_int(p->state_path, &brightness) && (brightness > 0);
+
+  error = NULL;
+  file = g_file_new_for_path(p->state_path);
+  p->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, &error);
+  if (p->monitor != NULL)
+    {
+      g_signal_connect(p->monitor, "changed", G_CALLBACK(on_brightness_file_changed), self);
+    }
+  else
+    {
+      g_debug("Unable to monitor '%s': %s", p->state_path, error->message);
+      g_error_free(error);
+    }
+  g_object_unref(file);
+
+  g_debug("using flashlight '%s'", led);
+  g_free(led);
+}
+
+/***
+****  Writing
+***/
+
+struct flashlight_write
+{
+  gboolean active;
+  int brightness_fd;
+  int switch_fd;
+  int on_brightness;
+};
+
+/* runs in a worker thread */
+static void
+write_in_thread(GTask        * task,
+                gpointer       source_object G_GNUC_UNUSED,
+                gpointer       task_data,
+                GCancellable * cancellable   G_GNUC_UNUSED)
+{
+  const struct flashlight_write * write = task_data;
+  gboolean success;
+
+  /* on the Qualcomm devices that need it, led:switch turns it off */
+  if (write->active)
+    {
+      success = write_int(write->brightness_fd, write->on_brightness);
+      if (success && (write->switch_fd >= 0))
+        success = write_int(write->switch_fd, 1);
+    }
+  else if (write->switch_fd >= 0)
+    {
+      success = write_int(write->switch_fd, 0);
+    }
+  else
+    {
+      success = write_int(write->brightness_fd, 0);
+    }
+
+  if (success)
+    {
+      g_task_return_boolean(task, TRUE);
+    }
+  else
+    {
+      const int err = errno;
+      g_task_return_new_error(task, G_IO_ERROR, g_io_error_from_errno(err),
+                              "Unable to turn flashlight %s: %s",
+                              write->active ? "on" : "off",
+                              g_strerror(err));
+    }
+}
+
+/* back in the main thread: commit the state, then finish the caller's task */
+static void
+on_write_done(GObject      * source_object,
+              GAsyncResult * res,
+              gpointer       gtask)
+{
+  IndicatorPowerFlashlight * self = INDICATOR_POWER_FLASHLIGHT(source_object);
+  priv_t * p = get_priv(self);
+  GTask * task = G_TASK(gtask);
+  GError * error = NULL;
+
+  p->write_in_flight = FALSE;
+
+  if (g_task_propagate_boolean(G_TASK(res), &error))
+    {
+      const struct flashlight_write * write = g_task_get_task_data(G_TASK(res));
+
+      if (p->active != write->active)
+        {
+          p->active = write->active;
+          g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_ACTIVE]);
+        }
+
+      g_task_return_boolean(task, TRUE);
+    }
+  else
+    {
+      g_task_return_error(task, error);
+    }
+
+  g_object_unref(task);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_get_property(GObject     * o,
+                guint         property_id,
+                GValue      * value,
+                GParamSpec  * pspec)
+{
+  IndicatorPowerFlashlight * self = INDICATOR_POWER_FLASHLIGHT(o);
+
+  switch (property_id)
+    {
+      case PROP_ACTIVE:
+        g_value_set_boolean(value, indicator_power_flashlight_get_active(self));
+        break;
+
+      default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(o, property_id, pspec);
+    }
+}
+
+static void
+my_dispose(GObject * o)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_FLASHLIGHT(o));
+
+  if (p->monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->monitor, o);
+      g_clear_object(&p->monitor);
+    }
+
+  G_OBJECT_CLASS(indicator_power_flashlight_parent_class)->dispose(o);
+}
+
+static void
+my_finalize(GObject * o)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_FLASHLIGHT(o));
+
+  if (p->brightness_fd >= 0)
+    close(p->brightness_fd);
+  if (p->switch_fd >= 0)
+    close(p->switch_fd);
+  g_free(p->brightness_path);
+  g_free(p->state_path);
+
+  G_OBJECT_CLASS(indicator_power_flashlight_parent_class)->finalize(o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_flashlight_init(IndicatorPowerFlashlight * self)
+{
+  priv_t * p = get_priv(self);
+
+  p->brightness_fd = -1;
+  p->switch_fd = -1;
+}
+
+static void
+indicator_power_flashlight_class_init(IndicatorPowerFlashlightClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS(klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+  object_class->get_property = my_get_property;
+
+  properties[PROP_0] = NULL;
+
+  properties[PROP_ACTIVE] = g_param_spec_boolean(
+    INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE,
+    "Active",
+    "Whether or not the flashlight is on",
+    FALSE,
+    G_PARAM_READABLE|G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties(object_class, LAST_PROP, properties);
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerFlashlight *
+indicator_power_flashlight_new(const char * leds_dir)
+{
+  IndicatorPowerFlashlight * self = g_object_new(INDICATOR_TYPE_POWER_FLASHLIGHT, NULL);
+
+  probe(self, leds_dir != NULL ? leds_dir : DEFAULT_LEDS_DIR);
+
+  return self;
+}
+
+gboolean
+indicator_power_flashlight_is_supported(IndicatorPowerFlashlight * self)
+{
+  g_return_val_if_fail(INDICATOR_IS_POWER_FLASHLIGHT(self), FALSE);
+
+  return get_priv(self)->brightness_path != NULL;
 }
 
 gboolean
-flashlight_activated()
+indicator_power_flashlight_get_active(IndicatorPowerFlashlight * self)
 {
-  return activated;
+  g_return_val_if_fail(INDICATOR_IS_POWER_FLASHLIGHT(self), FALSE);
+
+  return get_priv(self)->active;
 }
 
+/**
+ * Turns the flashlight on or off.
+ *
+ * The sysfs writes happen in a worker thread, since some LED drivers
+ * sleep in their store callbacks. "active" only changes once the write
+ * has succeeded. Only one write can be pending at a time; a second
+ * request fails with G_IO_ERROR_PENDING.
+ */
 void
-toggle_flashlight_action(GAction *action,
-                         GVariant *parameter G_GNUC_UNUSED,
-                         gpointer data G_GNUC_UNUSED)
+indicator_power_flashlight_set_active_async(IndicatorPowerFlashlight * self,
+                                            gboolean                   active,
+                                            GCancellable             * cancellable,
+                                            GAsyncReadyCallback        callback,
+                                            gpointer                   user_data)
 {
-  GVariant *state;
-  FILE *fd1 = NULL, *fd2 = NULL;
+  priv_t * p;
+  GTask * task;
+  GTask * write_task;
+  struct flashlight_write * write;
 
-  int needs_enable;
+  g_return_if_fail(INDICATOR_IS_POWER_FLASHLIGHT(self));
+  p = get_priv(self);
 
-  if (!set_sysfs_path())
-    return;
+  if (p->brightness_path == NULL)
+    {
+      g_task_report_new_error(self, callback, user_data,
+                              indicator_power_flashlight_set_active_async,
+                              G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                              "No flashlight found");
+      return;
+    }
+
+  if (p->brightness_fd < 0)
+    {
+      g_task_report_new_error(self, callback, user_data,
+                              indicator_power_flashlight_set_active_async,
+                              G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+                              "Unable to write to '%s'", p->brightness_path);
+      return;
+    }
+
+  if (p->write_in_flight)
+    {
+      g_task_report_new_error(self, callback, user_data,
+                              indicator_power_flashlight_set_active_async,
+                              G_IO_ERROR, G_IO_ERROR_PENDING,
+                              "A flashlight write is already in progress");
+      return;
+    }
+
+  task = g_task_new(self, cancellable, callback, user_data);
+  g_task_set_source_tag(task, indicator_power_flashlight_set_active_async);
+
+  /* the worker only sees this copy; the fds stay open
+     because the write task keeps a ref to self */
+  write = g_new0(struct flashlight_write, 1);
+  write->active = active != FALSE;
+  write->brightness_fd = p->brightness_fd;
+  write->switch_fd = p->switch_fd;
+  write->on_brightness = p->on_brightness;
+
+  p->write_in_flight = TRUE;
+  write_task = g_task_new(self, NULL, on_write_done, task);
+  g_task_set_task_data(write_task, write, g_free);
+  g_task_run_in_thread(write_task, write_in_thread);
+  g_object_unref(write_task);
+}
+
+gboolean
+indicator_power_flashlight_set_active_finish(IndicatorPowerFlashlight  * self,
+                                             GAsyncResult              * res,
+                                             GError                   ** error)
+{
+  g_return_val_if_fail(g_task_is_valid(res, self), FALSE);
 
-  state = g_action_get_state(action);
-  activated = g_variant_get_boolean(state);
-  g_variant_unref(state);
-  fd1 = fopen(flash_sysfs_path, "w");
-  if (fd1 != NULL) {
-    needs_enable = access(qcom_torch_enable, F_OK ) != -1;
-    if (needs_enable)
-      fd2 = fopen(qcom_torch_enable, "w");
-    if (activated)
-      if (needs_enable && fd2 != NULL)
-        fprintf(fd2, "0");
-      else
-        fprintf(fd1, QCOM_DISABLE);
-    else {
-      fprintf(fd1, QCOM_ENABLE);
-      if (needs_enable && fd2 != NULL)
-        fprintf(fd2, "1");
-    }
-    fclose(fd1);
-    if (fd2 !=NULL)
-      fclose(fd2);
-    g_action_change_state(action, g_variant_new_boolean(!activated));
-  }
-}
-
-int
-flashlight_supported()
-{
-  return set_sysfs_path();
+  return g_task_propagate_boolean(G_TASK(res), error);
 }
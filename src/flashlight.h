@@ -17,23 +17,66 @@
  *   Marius Gripsgard <marius@ubports.com>
  */
 
+
 #ifndef INDICATOR_POWER_FLASHLIGHT__H
 #define INDICATOR_POWER_FLASHLIGHT__H
 
+#include <glib.h>
 #include <gio/gio.h>
 
 G_BEGIN_DECLS
 
-void
-toggle_flashlight_action(GAction *action,
-                         GVariant *parameter G_GNUC_UNUSED,
-                         gpointer data G_GNUC_UNUSED);
+/* standard GObject macros */
+#define INDICATOR_POWER_FLASHLIGHT(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_FLASHLIGHT, IndicatorPowerFlashlight))
+#define INDICATOR_TYPE_POWER_FLASHLIGHT          (indicator_power_flashlight_get_type())
+#define INDICATOR_IS_POWER_FLASHLIGHT(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_FLASHLIGHT))
+
+typedef struct _IndicatorPowerFlashlight         IndicatorPowerFlashlight;
+typedef struct _IndicatorPowerFlashlightClass    IndicatorPowerFlashlightClass;
+
+/* property keys */
+#define INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE  "active"
+
+/**
+ * A torch / flash LED under /sys/class/leds.
+ *
+ * The LED is probed once at construction and its brightness
+ * attribute is watched, so "active" follows changes made by
+ * other processes too.
+ */
+struct _IndicatorPowerFlashlight
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerFlashlightClass
+{
+  GObjectClass parent_class;
+};
+
+/***
+****
+***/
+
+GType indicator_power_flashlight_get_type(void);
+
+/* leds_dir is for tests; pass NULL to use /sys/class/leds */
+IndicatorPowerFlashlight * indicator_power_flashlight_new(const char * leds_dir);
+
+gboolean indicator_power_flashlight_is_supported(IndicatorPowerFlashlight * self);
+
+gboolean indicator_power_flashlight_get_active(IndicatorPowerFlashlight * self);
 
-int
-flashlight_supported();
+void indicator_power_flashlight_set_active_async(IndicatorPowerFlashlight * self,
+                                                 gboolean                   active,
+                                                 GCancellable             * cancellable,
+                                                 GAsyncReadyCallback        callback,
+                                                 gpointer                   user_data);
 
-gboolean
-flashlight_activated();
+gboolean indicator_power_flashlight_set_active_finish(IndicatorPowerFlashlight  * self,
+                                                      GAsyncResult              * res,
+                                                      GError                   ** error);
 
 G_END_DECLS
 
@@ -0,0 +1,491 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbus-history.h"
+#include "dbus-shared.h"
+#include "history.h"
+
+#include <gio/gio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***
+****  On-disk format
+****
+****  Each device's file is a header followed by CAPACITY samples.
+****  The file is mapped MAP_SHARED and written in place, so there's
+****  nothing to parse or save; the kernel writes the pages back.
+***/
+
+#define HISTORY_MAGIC "AIPHIST1"
+#define HISTORY_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  guint32 version;
+  guint32 capacity;
+  guint32 head;   /* the slot the next sample goes in */
+  guint32 count;  /* how many slots hold samples */
+}
+HistoryHeader;
+
+typedef struct
+{
+  guint64 time;   /* wall-clock seconds since the epoch */
+  gdouble percentage;
+  gdouble energy_rate;
+  guint32 state;  /* UpDeviceState */
+  guint32 reserved;
+}
+HistorySample;
+
+#define HISTORY_FILE_SIZE (sizeof(HistoryHeader) + INDICATOR_POWER_HISTORY_CAPACITY * sizeof(HistorySample))
+
+typedef struct
+{
+  gpointer map;
+  gboolean mapped; /* FALSE if we fell back to keeping it in memory */
+  HistoryHeader * header;
+  HistorySample * samples;
+}
+Ring;
+
+/***
+****
+***/
+
+typedef struct
+{
+  char * dir;
+  gboolean dir_created;
+
+  GHashTable * rings; /* device id -> Ring */
+
+  GDBusConnection * bus;
+  DbusHistory * skeleton;
+}
+IndicatorPowerHistoryPrivate;
+
+typedef IndicatorPowerHistoryPrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerHistory,
+                           indicator_power_history,
+                           G_TYPE_OBJECT)
+
+#define get_priv(o) ((priv_t*)indicator_power_history_get_instance_private(o))
+
+/***
+****  Ring buffer
+***/
+
+static gboolean
+header_is_valid (const HistoryHeader * header)
+{
+  return (memcmp (header->magic, HISTORY_MAGIC, sizeof(header->magic)) == 0)
+      && (header->version == HISTORY_VERSION)
+      && (header->capacity == INDICATOR_POWER_HISTORY_CAPACITY)
+      && (header->head < header->capacity)
+      && (header->count <= header->capacity);
+}
+
+static void
+ring_reset (Ring * ring)
+{
+  memset (ring->map, 0, HISTORY_FILE_SIZE);
+  memcpy (ring->header->magic, HISTORY_MAGIC, sizeof(ring->header->magic));
+  ring->header->version = HISTORY_VERSION;
+  ring->header->capacity = INDICATOR_POWER_HISTORY_CAPACITY;
+}
+
+static gpointer
+map_file (const char * path, gboolean create)
+{
+  int fd;
+  struct stat st;
+  gpointer map;
+
+  fd = open (path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+  if (fd == -1)
+    {
+      if (create || (errno != ENOENT))
+        g_debug ("%s: unable to open: %s", path, g_strerror (errno));
+      return NULL;
+    }
+
+  /* a size mismatch means it's from some other version;
+     resizing it is fine since the header check will reset it */
+  if ((fstat (fd, &st) == -1) ||
+      ((st.st_size != (off_t)HISTORY_FILE_SIZE) && (ftruncate (fd, HISTORY_FILE_SIZE) == -1)))
+    {
+      g_debug ("%s: unable to size: %s", path, g_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+
+  map = mmap (NULL, HISTORY_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd); /* the mapping holds its own reference */
+
+  if (map == MAP_FAILED)
+    {
+      g_debug ("%s: unable to map: %s", path, g_strerror (errno));
+      return NULL;
+    }
+
+  return map;
+}
+
+/* If create is FALSE, returns NULL unless the file already exists.
+   If create is TRUE and the file can't be used, falls back to memory. */
+static Ring *
+ring_new (const char * path, gboolean create)
+{
+  Ring * ring;
+  gpointer map;
+
+  map = map_file (path, create);
+  if ((map == NULL) && !create)
+    return NULL;
+
+  ring = g_new0 (Ring, 1);
+  ring->mapped = map != NULL;
+  ring->map = ring->mapped ? map : g_malloc0 (HISTORY_FILE_SIZE);
+  ring->header = ring->map;
+  ring->samples = (HistorySample*)(ring->header + 1);
+
+  if (!header_is_valid (ring->header))
+    ring_reset (ring);
+
+  return ring;
+}
+
+static void
+ring_free (gpointer gring)
+{
+  Ring * ring = gring;
+
+  if (ring->mapped)
+    munmap (ring->map, HISTORY_FILE_SIZE);
+  else
+    g_free (ring->map);
+
+  g_free (ring);
+}
+
+static const HistorySample *
+ring_get_newest (const Ring * ring)
+{
+  const HistoryHeader * h = ring->header;
+
+  if (h->count == 0)
+    return NULL;
+
+  return &ring->samples[(h->head + h->capacity - 1) % h->capacity];
+}
+
+static void
+ring_append (Ring * ring, const HistorySample * sample)
+{
+  HistoryHeader * h = ring->header;
+
+  /* write the sample before publishing it in the header,
+     so an interrupted write never exposes a torn sample */
+  ring->samples[h->head] = *sample;
+  h->head = (h->head + 1) % h->capacity;
+  if (h->count < h->capacity)
+    h->count++;
+}
+
+/***
+****
+***/
+
+static char *
+get_default_dir (void)
+{
+  /* g_get_user_state_dir() needs GLib 2.72 */
+  const char * state_home = g_getenv ("XDG_STATE_HOME");
+
+  if ((state_home != NULL) && g_path_is_absolute (state_home))
+    return g_build_filename (state_home, "ayatana-indicator-power", "history", NULL);
+
+  return g_build_filename (g_get_home_dir (), ".local", "state", "ayatana-indicator-power", "history", NULL);
+}
+
+static Ring *
+get_ring (IndicatorPowerHistory * self, const char * device_id, gboolean create)
+{
+  priv_t * const p = get_priv (self);
+  Ring * ring;
+  char * filename;
+  char * path;
+
+  if ((ring = g_hash_table_lookup (p->rings, device_id)))
+    return ring;
+
+  if (create && !p->dir_created)
+    {
+      if (g_mkdir_with_parents (p->dir, 0700) == -1)
+        g_debug ("%s: unable to create: %s", p->dir, g_strerror (errno));
+      p->dir_created = TRUE;
+    }
+
+  /* object paths have slashes; escaping them keeps every
+     device in a file of its own directly under p->dir */
+  filename = g_uri_escape_string (device_id, NULL, FALSE);
+  path = g_build_filename (p->dir, filename, NULL);
+  ring = ring_new (path, create);
+  g_free (path);
+  g_free (filename);
+
+  if (ring != NULL)
+    g_hash_table_insert (p->rings, g_strdup (device_id), ring);
+
+  return ring;
+}
+
+/***
+****  D-Bus
+***/
+
+static gboolean
+on_handle_get_history (DbusHistory           * skeleton,
+                       GDBusMethodInvocation * invocation,
+                       const char            * device,
+                       gpointer                gself)
+{
+  GVariant * samples = indicator_power_history_get_samples (INDICATOR_POWER_HISTORY(gself), device);
+
+  dbus_history_complete_get_history (skeleton, invocation, samples);
+
+  return TRUE;
+}
+
+/***
+****  GObject boilerplate
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  IndicatorPowerHistory * const self = INDICATOR_POWER_HISTORY(o);
+  priv_t * const p = get_priv (self);
+
+  indicator_power_history_set_bus (self, NULL);
+
+  if (p->skeleton != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->skeleton, self);
+      g_clear_object (&p->skeleton);
+    }
+
+  G_OBJECT_CLASS (indicator_power_history_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_HISTORY(o));
+
+  g_hash_table_destroy (p->rings);
+  g_free (p->dir);
+
+  G_OBJECT_CLASS (indicator_power_history_parent_class)->finalize (o);
+}
+
+static void
+indicator_power_history_init (IndicatorPowerHistory * self)
+{
+  priv_t * const p = get_priv (self);
+
+  p->rings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, ring_free);
+
+  p->skeleton = dbus_history_skeleton_new ();
+  g_signal_connect (p->skeleton, "handle-get-history",
+                    G_CALLBACK(on_handle_get_history), self);
+}
+
+static void
+indicator_power_history_class_init (IndicatorPowerHistoryClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerHistory *
+indicator_power_history_new (const char * dir)
+{
+  IndicatorPowerHistory * self = g_object_new (INDICATOR_TYPE_POWER_HISTORY, NULL);
+  priv_t * const p = get_priv (self);
+
+  p->dir = dir != NULL ? g_strdup (dir) : get_default_dir ();
+
+  return self;
+}
+
+void
+indicator_power_history_set_bus (IndicatorPowerHistory * self,
+                                 GDBusConnection       * bus)
+{
+  priv_t * p;
+  GDBusInterfaceSkeleton * skel;
+
+  g_return_if_fail (INDICATOR_IS_POWER_HISTORY(self));
+  g_return_if_fail ((bus == NULL) || G_IS_DBUS_CONNECTION(bus));
+
+  p = get_priv (self);
+
+  if (p->bus == bus)
+    return;
+
+  skel = G_DBUS_INTERFACE_SKELETON(p->skeleton);
+
+  if (p->bus != NULL)
+    {
+      if (skel != NULL)
+        g_dbus_interface_skeleton_unexport (skel);
+
+      g_clear_object (&p->bus);
+    }
+
+  if (bus != NULL)
+    {
+      GError * error;
+
+      p->bus = g_object_ref (bus);
+
+      error = NULL;
+      if (!g_dbus_interface_skeleton_export (skel,
+                                             bus,
+                                             BUS_PATH"/History",
+                                             &error))
+        {
+          g_warning ("Unable to export History properties: %s", error->message);
+          g_error_free (error);
+        }
+    }
+}
+
+gboolean
+indicator_power_history_record (IndicatorPowerHistory      * self,
+                                const IndicatorPowerDevice * device)
+{
+  const char * device_id;
+  UpDeviceState state;
+  gdouble percentage;
+  guint64 now;
+  Ring * ring;
+  const HistorySample * newest;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_HISTORY(self), FALSE);
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), FALSE);
+
+  /* line power has no charge to chart */
+  if (indicator_power_device_get_kind (device) == UP_DEVICE_KIND_LINE_POWER)
+    return FALSE;
+
+  device_id = indicator_power_device_get_object_path (device);
+  if ((device_id == NULL) || (*device_id == '\0'))
+    return FALSE;
+
+  state = indicator_power_device_get_state (device);
+  percentage = indicator_power_device_get_percentage (device);
+  now = (guint64)(g_get_real_time () / G_USEC_PER_SEC);
+
+  ring = get_ring (self, device_id, TRUE);
+  newest = ring_get_newest (ring);
+
+  /* state changes are always kept; otherwise, only sample a changed
+     percentage, and no more often than MIN_INTERVAL. If the clock went
+     backwards, take the sample rather than stall until it catches up. */
+  if ((newest != NULL) && (newest->state == (guint32)state))
+    {
+      if (newest->percentage == percentage)
+        return FALSE;
+
+      if ((now >= newest->time) && (now - newest->time < INDICATOR_POWER_HISTORY_MIN_INTERVAL_SEC))
+        return FALSE;
+    }
+
+  indicator_power_history_add_sample (self, device_id, now, percentage, state,
+                                      indicator_power_device_get_metric (device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE));
+  return TRUE;
+}
+
+void
+indicator_power_history_add_sample (IndicatorPowerHistory * self,
+                                    const char            * device_id,
+                                    guint64                 time,
+                                    gdouble                 percentage,
+                                    UpDeviceState           state,
+                                    gdouble                 energy_rate)
+{
+  HistorySample sample;
+
+  g_return_if_fail (INDICATOR_IS_POWER_HISTORY(self));
+  g_return_if_fail (device_id != NULL);
+
+  memset (&sample, 0, sizeof(sample));
+  sample.time = time;
+  sample.percentage = percentage;
+  sample.energy_rate = energy_rate;
+  sample.state = state;
+
+  ring_append (get_ring (self, device_id, TRUE), &sample);
+}
+
+GVariant *
+indicator_power_history_get_samples (IndicatorPowerHistory * self,
+                                     const char            * device_id)
+{
+  GVariantBuilder builder;
+  const Ring * ring;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_HISTORY(self), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE("a(tdu)"));
+
+  /* don't create files on behalf of devices we've never seen */
+  ring = ((device_id != NULL) && (*device_id != '\0'))
+       ? get_ring (self, device_id, FALSE)
+       : NULL;
+
+  if (ring != NULL)
+    {
+      const HistoryHeader * h = ring->header;
+      const guint32 oldest = (h->head + h->capacity - h->count) % h->capacity;
+      guint32 i;
+
+      for (i=0; i<h->count; i++)
+        {
+          const HistorySample * s = &ring->samples[(oldest + i) % h->capacity];
+          g_variant_builder_add (&builder, "(tdu)", s->time, s->percentage, s->state);
+        }
+    }
+
+  return g_variant_builder_end (&builder);
+}
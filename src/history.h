@@ -0,0 +1,88 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_HISTORY_H__
+#define __INDICATOR_POWER_HISTORY_H__
+
+#include <gio/gio.h>
+
+#include "device.h"
+
+G_BEGIN_DECLS
+
+/* standard GObject macros */
+#define INDICATOR_POWER_HISTORY(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_HISTORY, IndicatorPowerHistory))
+#define INDICATOR_TYPE_POWER_HISTORY         (indicator_power_history_get_type())
+#define INDICATOR_IS_POWER_HISTORY(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_HISTORY))
+
+typedef struct _IndicatorPowerHistory         IndicatorPowerHistory;
+typedef struct _IndicatorPowerHistoryClass    IndicatorPowerHistoryClass;
+
+/* how many samples are kept per device */
+#define INDICATOR_POWER_HISTORY_CAPACITY 1024
+
+/* unless the state changes, a device is sampled at most this often */
+#define INDICATOR_POWER_HISTORY_MIN_INTERVAL_SEC 60
+
+/**
+ * Per-device charge history.
+ *
+ * Each device gets a fixed-size ring buffer of samples that lives in
+ * a memory-mapped file, so the history survives restarts without
+ * having to be parsed. It's exported on the bus as a(tdu) arrays.
+ */
+struct _IndicatorPowerHistory
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerHistoryClass
+{
+  GObjectClass parent_class;
+};
+
+/***
+****
+***/
+
+GType indicator_power_history_get_type (void);
+
+/* dir is for tests; pass NULL to use $XDG_STATE_HOME/ayatana-indicator-power/history */
+IndicatorPowerHistory * indicator_power_history_new (const char * dir);
+
+void indicator_power_history_set_bus (IndicatorPowerHistory * self,
+                                      GDBusConnection       * connection);
+
+/* Samples the device if it has changed since its last sample.
+   Returns TRUE if a sample was added. */
+gboolean indicator_power_history_record (IndicatorPowerHistory      * self,
+                                         const IndicatorPowerDevice * device);
+
+void indicator_power_history_add_sample (IndicatorPowerHistory * self,
+                                         const char            * device_id,
+                                         guint64                 time,
+                                         gdouble                 percentage,
+                                         UpDeviceState           state,
+                                         gdouble                 energy_rate);
+
+/* Returns a floating a(tdu) variant of the device's samples, oldest first */
+GVariant * indicator_power_history_get_samples (IndicatorPowerHistory * self,
+                                                const char            * device_id);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_HISTORY_H__ */
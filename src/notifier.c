@@ -28,6 +28,22 @@
 
 #include <stdint.h> /* UINT32_MAX */
 
+#define SETTINGS_SCHEMA "org.ayatana.indicator.power"
+#define SETTINGS_PERCENT_LOW_S "power-level-low"
+#define SETTINGS_PERCENT_VERY_LOW_S "power-level-very-low"
+#define SETTINGS_PERCENT_CRITICAL_S "power-level-critical"
+#define SETTINGS_TIME_LOW_S "power-level-low-time"
+#define SETTINGS_TIME_VERY_LOW_S "power-level-very-low-time"
+#define SETTINGS_TIME_CRITICAL_S "power-level-critical-time"
+#define SETTINGS_HYSTERESIS_S "power-level-hysteresis"
+#define SETTINGS_DWELL_TIME_S "power-level-dwell-time"
+#define SETTINGS_RATE_LIMIT_S "power-level-rate-limit"
+#define SETTINGS_PREDICTIVE_S "power-level-predictive"
+
+#define NOTIFY_BUS_NAME "org.freedesktop.Notifications"
+#define NOTIFY_PATH     "/org/freedesktop/Notifications"
+#define NOTIFY_IFACE    "org.freedesktop.Notifications"
+
 typedef enum
 {
   POWER_LEVEL_CRITICAL,
@@ -37,6 +53,48 @@ typedef enum
 }
 PowerLevel;
 
+/* Decides which PowerLevel a battery is in and how often we may nag about it.
+   Tunable via GSettings; see the power-level-* keys in our schema. */
+typedef struct
+{
+  /* a battery is at PowerLevel N if it's at or below percent[N]... */
+  gdouble percent[POWER_LEVEL_OK];
+
+  /* ...or if it's discharging with seconds[N] or less left. 0 disables */
+  gint64 seconds[POWER_LEVEL_OK];
+
+  /* a battery must climb this many percent past a threshold to leave it */
+  gdouble hysteresis;
+
+  /* how long a battery must be discharging before we notify */
+  gint64 dwell_usec;
+
+  /* minimum interval between two notifications for the same PowerLevel */
+  gint64 rate_limit_usec;
+
+  /* whether to predict when the next PowerLevel will be reached */
+  gboolean predictive;
+}
+PowerLevelPolicy;
+
+static const PowerLevelPolicy default_policy =
+{
+  { 2.0, 5.0, 10.0 },
+  { 0, 0, 0 },
+  1.0,
+  0,
+  0,
+  FALSE
+};
+
+typedef enum
+{
+  NOTIFY_OP_NONE,
+  NOTIFY_OP_SHOW,
+  NOTIFY_OP_CLOSE
+}
+NotifyOp;
+
 /**
 ***  GObject Properties
 **/
@@ -69,12 +127,50 @@ typedef struct
   PowerLevel power_level;
   gboolean discharging;
 
+  GSettings * settings;
+  PowerLevelPolicy policy;
+  gint64 discharging_since;
+  gint64 last_shown[POWER_LEVEL_OK];
+  guint dwell_tag;
+
+  /* a single timer armed for when the battery is predicted
+     to fall to predict_level; see schedule_prediction() */
+  guint predict_tag;
+  gint64 predict_deadline;
+  PowerLevel predict_level;
+  PowerLevel predicted_level; /* the level reached by the last prediction */
+  gint64 reading_time; /* when the battery was last read; predictions start from it */
+
+  /* libnotify fallback, used when we don't have a bus */
   NotifyNotification * notify_notification;
 
+  /* async org.freedesktop.Notifications backend */
+  guint32 notify_id; /* the server's id for our notification, or 0 */
+  gboolean notify_in_flight;
+  NotifyOp notify_pending; /* what to do when the in-flight call returns */
+  guint notify_flush_tag;
+  GCancellable * notify_cancellable;
+  guint notify_closed_tag;
+  guint notify_action_tag;
+  gchar * pending_summary;
+  gchar * pending_body;
+  gchar * pending_icon_name;
+  gboolean pending_with_actions;
+
   GDBusConnection * bus;
   DbusBattery * dbus_battery; /* org.ayatana.indicator.power.Battery skeleton */
 
-  gboolean caps_queried;
+  /* the Battery properties are staged here and pushed to
+     dbus_battery at most once per main loop iteration */
+  PowerLevel staged_power_level;
+  gboolean staged_power_level_set;
+  gboolean staged_is_warning;
+  guint battery_flush_tag;
+
+  /* the notification server's capabilities are fetched asynchronously
+     whenever its name appears on the bus, then cached here */
+  guint notify_name_tag;
+  GCancellable * caps_cancellable;
   gboolean actions_supported;
 }
 IndicatorPowerNotifierPrivate;
@@ -103,69 +199,401 @@ power_level_to_dbus_string (const PowerLevel power_level)
     }
 }
 
+/***
+****  Staged Battery properties
+***/
+
+static gboolean
+on_battery_flush_idle (gpointer gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+
+  p->battery_flush_tag = 0;
+
+  if (p->staged_power_level_set)
+    {
+      const char * const level = power_level_to_dbus_string (p->staged_power_level);
+
+      if (g_strcmp0 (level, dbus_battery_get_power_level (p->dbus_battery)))
+        dbus_battery_set_power_level (p->dbus_battery, level);
+    }
+
+  if (!p->staged_is_warning != !dbus_battery_get_is_warning (p->dbus_battery))
+    dbus_battery_set_is_warning (p->dbus_battery, p->staged_is_warning);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+battery_flush_soon (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+
+  if (p->battery_flush_tag == 0)
+    p->battery_flush_tag = g_idle_add (on_battery_flush_idle, self);
+}
+
+static void
+stage_power_level (IndicatorPowerNotifier * self, PowerLevel power_level)
+{
+  priv_t * const p = get_priv (self);
+
+  p->staged_power_level = power_level;
+  p->staged_power_level_set = TRUE;
+  battery_flush_soon (self);
+}
+
+static void
+stage_is_warning (IndicatorPowerNotifier * self, gboolean is_warning)
+{
+  priv_t * const p = get_priv (self);
+
+  p->staged_is_warning = is_warning;
+  battery_flush_soon (self);
+}
+
+/* Thresholds for levels no worse than current_level are raised by
+   the policy's hysteresis, so that a battery wobbling around a
+   threshold doesn't flap between two levels */
 static PowerLevel
-get_battery_power_level (IndicatorPowerDevice * battery)
+get_battery_power_level_with_policy (IndicatorPowerDevice     * battery,
+                                     const PowerLevelPolicy   * policy,
+                                     PowerLevel                 current_level)
 {
-  static const double percent_critical = 2.0;
-  static const double percent_very_low = 5.0;
-  static const double percent_low = 10.0;
   gdouble p;
-  PowerLevel ret;
+  time_t time_left;
+  int level;
 
   g_return_val_if_fail(battery != NULL, POWER_LEVEL_OK);
   g_return_val_if_fail(indicator_power_device_get_kind(battery) == UP_DEVICE_KIND_BATTERY, POWER_LEVEL_OK);
 
   p = indicator_power_device_get_percentage(battery);
 
-  if (p <= percent_critical)
-    ret = POWER_LEVEL_CRITICAL;
-  else if (p <= percent_very_low)
-    ret = POWER_LEVEL_VERY_LOW;
-  else if (p <= percent_low)
-    ret = POWER_LEVEL_LOW;
+  if (indicator_power_device_get_state(battery) == UP_DEVICE_STATE_DISCHARGING)
+    time_left = indicator_power_device_get_time(battery);
   else
-    ret = POWER_LEVEL_OK;
+    time_left = 0;
+
+  for (level=POWER_LEVEL_CRITICAL; level<POWER_LEVEL_OK; ++level)
+    {
+      gdouble threshold = policy->percent[level];
+
+      if (level >= (int)current_level)
+        threshold += policy->hysteresis;
+
+      if (p <= threshold)
+        return level;
+
+      if ((time_left > 0) && (policy->seconds[level] > 0) && (time_left <= policy->seconds[level]))
+        return level;
+    }
+
+  return POWER_LEVEL_OK;
+}
+
+static PowerLevel
+get_battery_power_level (IndicatorPowerDevice * battery)
+{
+  return get_battery_power_level_with_policy (battery, &default_policy, POWER_LEVEL_OK);
+}
+
+static void
+load_policy (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  PowerLevelPolicy * const policy = &p->policy;
+  GSettings * const s = p->settings;
+
+  *policy = default_policy;
+
+  if (s == NULL)
+    return;
+
+  policy->percent[POWER_LEVEL_CRITICAL] = g_settings_get_double (s, SETTINGS_PERCENT_CRITICAL_S);
+  policy->percent[POWER_LEVEL_VERY_LOW] = g_settings_get_double (s, SETTINGS_PERCENT_VERY_LOW_S);
+  policy->percent[POWER_LEVEL_LOW] = g_settings_get_double (s, SETTINGS_PERCENT_LOW_S);
+  policy->seconds[POWER_LEVEL_CRITICAL] = g_settings_get_uint (s, SETTINGS_TIME_CRITICAL_S);
+  policy->seconds[POWER_LEVEL_VERY_LOW] = g_settings_get_uint (s, SETTINGS_TIME_VERY_LOW_S);
+  policy->seconds[POWER_LEVEL_LOW] = g_settings_get_uint (s, SETTINGS_TIME_LOW_S);
+  policy->hysteresis = g_settings_get_double (s, SETTINGS_HYSTERESIS_S);
+  policy->dwell_usec = (gint64) g_settings_get_uint (s, SETTINGS_DWELL_TIME_S) * G_USEC_PER_SEC;
+  policy->rate_limit_usec = (gint64) g_settings_get_uint (s, SETTINGS_RATE_LIMIT_S) * G_USEC_PER_SEC;
+  policy->predictive = g_settings_get_boolean (s, SETTINGS_PREDICTIVE_S);
+}
+
+/* Returns how long until a discharging battery falls from level to the
+   next worse PowerLevel, or -1 if that can't be predicted. The discharge
+   rate is inferred from the battery's percentage and time remaining. */
+static gint64
+predict_next_level (IndicatorPowerDevice     * battery,
+                    const PowerLevelPolicy   * policy,
+                    PowerLevel                 level,
+                    PowerLevel               * next_level)
+{
+  PowerLevel next;
+  gdouble percentage;
+  time_t time_left;
+  gdouble seconds;
+
+  if (level == POWER_LEVEL_CRITICAL)
+    return -1;
+
+  if (indicator_power_device_get_state(battery) != UP_DEVICE_STATE_DISCHARGING)
+    return -1;
+
+  percentage = indicator_power_device_get_percentage(battery);
+  time_left = indicator_power_device_get_time(battery);
+  if ((percentage <= 0.0) || (time_left <= 0))
+    return -1;
 
-  return ret;
+  next = (PowerLevel)(level - 1);
+
+  /* assume a constant rate for the rest of the discharge */
+  seconds = (percentage - policy->percent[next]) * (gdouble)time_left / percentage;
+
+  if (policy->seconds[next] > 0)
+    seconds = MIN (seconds, (gdouble)(time_left - policy->seconds[next]));
+
+  *next_level = next;
+  return (gint64)(MAX (seconds, 0.0) * G_USEC_PER_SEC);
 }
 
 /***
 ****  Notifications
+****
+****  When we have a bus, notifications are sent straight to
+****  org.freedesktop.Notifications with async calls so that the main loop
+****  never waits on the notification daemon. At most one call is in flight
+****  at a time; requests made meanwhile are folded into notify_pending,
+****  so that a show -> close -> show sequence becomes a single Notify that
+****  replaces the visible notification. Without a bus, libnotify is used.
 ***/
 
-static void
-on_notify_notification_finalized (gpointer gself, GObject * dead)
+static void notify_flush (IndicatorPowerNotifier * self);
+
+static gboolean
+on_notify_flush_idle (gpointer gself)
 {
   IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+
+  get_priv(self)->notify_flush_tag = 0;
+  notify_flush (self);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+notify_flush_soon (IndicatorPowerNotifier * self)
+{
   priv_t * const p = get_priv(self);
-  g_return_if_fail ((void*)(p->notify_notification) == (void*)dead);
-  p->notify_notification = NULL;
-  dbus_battery_set_is_warning (p->dbus_battery, FALSE);
+
+  if (p->notify_flush_tag == 0)
+    p->notify_flush_tag = g_idle_add (on_notify_flush_idle, self);
 }
 
 static void
-notification_clear (IndicatorPowerNotifier * self)
+on_notify_response (GObject      * bus,
+                    GAsyncResult * res,
+                    gpointer       gself)
+{
+  GError * error;
+  GVariant * v;
+  priv_t * p;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish (G_DBUS_CONNECTION(bus), res, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      return;
+    }
+
+  p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+  p->notify_in_flight = FALSE;
+
+  if (v == NULL)
+    {
+      g_critical ("Unable to show snap decision: %s", error->message);
+      g_error_free (error);
+
+      p->notify_id = 0;
+      if (p->notify_pending != NOTIFY_OP_SHOW)
+        stage_is_warning (INDICATOR_POWER_NOTIFIER(gself), FALSE);
+    }
+  else
+    {
+      g_variant_get (v, "(u)", &p->notify_id);
+      g_variant_unref (v);
+    }
+
+  notify_flush (INDICATOR_POWER_NOTIFIER(gself));
+}
+
+static void
+on_close_notification_response (GObject      * bus,
+                                GAsyncResult * res,
+                                gpointer       gself)
+{
+  GError * error;
+  GVariant * v;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish (G_DBUS_CONNECTION(bus), res, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      return;
+    }
+
+  if (error != NULL)
+    {
+      g_warning ("Unable to close notification: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_clear_pointer (&v, g_variant_unref);
+
+  get_priv(INDICATOR_POWER_NOTIFIER(gself))->notify_in_flight = FALSE;
+  notify_flush (INDICATOR_POWER_NOTIFIER(gself));
+}
+
+static GVariant *
+create_notify_args (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv(self);
-  NotifyNotification * nn;
+  GVariantBuilder actions;
+  GVariantBuilder hints;
+  gint32 expire_timeout;
 
-  if ((nn = p->notify_notification))
+  g_variant_builder_init (&actions, G_VARIANT_TYPE_STRING_ARRAY);
+  g_variant_builder_init (&hints, G_VARIANT_TYPE_VARDICT);
+  expire_timeout = NOTIFY_EXPIRES_DEFAULT;
+
+  if (p->pending_with_actions)
     {
-      GError * error = NULL;
+      g_variant_builder_add (&hints, "{sv}", "x-canonical-snap-decisions", g_variant_new_string("true"));
+      g_variant_builder_add (&hints, "{sv}", "x-canonical-non-shaped-icon", g_variant_new_string("true"));
+      g_variant_builder_add (&hints, "{sv}", "x-canonical-private-affirmative-tint", g_variant_new_string("true"));
+      g_variant_builder_add (&hints, "{sv}", "x-canonical-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
+      expire_timeout = NOTIFY_EXPIRES_NEVER;
+      g_variant_builder_add (&actions, "s", "dismiss");
+      g_variant_builder_add (&actions, "s", _("OK"));
+      g_variant_builder_add (&actions, "s", "settings");
+      g_variant_builder_add (&actions, "s", _("Battery settings"));
+    }
 
-      g_object_weak_unref(G_OBJECT(nn), on_notify_notification_finalized, self);
+  return g_variant_new ("(susssasa{sv}i)",
+                        "ayatana-indicator-power-service",
+                        p->notify_id, /* replaces_id */
+                        p->pending_icon_name ? p->pending_icon_name : "",
+                        p->pending_summary,
+                        p->pending_body,
+                        &actions,
+                        &hints,
+                        expire_timeout);
+}
 
-      if (!notify_notification_close(nn, &error))
-        {
-          g_warning("Unable to close notification: %s", error->message);
-          g_error_free(error);
-        }
+/* start the next pending call, unless one's already in flight */
+static void
+notify_flush (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  const NotifyOp op = p->notify_pending;
 
-      p->notify_notification = NULL;
-      dbus_battery_set_is_warning (p->dbus_battery, FALSE);
+  if (p->notify_in_flight || (p->bus == NULL))
+    return;
+
+  p->notify_pending = NOTIFY_OP_NONE;
+
+  if (op == NOTIFY_OP_SHOW)
+    {
+      p->notify_in_flight = TRUE;
+      g_dbus_connection_call (p->bus,
+                              NOTIFY_BUS_NAME,
+                              NOTIFY_PATH,
+                              NOTIFY_IFACE,
+                              "Notify",
+                              create_notify_args (self),
+                              G_VARIANT_TYPE("(u)"),
+                              G_DBUS_CALL_FLAGS_NONE,
+                              -1, /* default timeout */
+                              p->notify_cancellable,
+                              on_notify_response,
+                              self);
+    }
+  else if ((op == NOTIFY_OP_CLOSE) && (p->notify_id != 0))
+    {
+      p->notify_in_flight = TRUE;
+      g_dbus_connection_call (p->bus,
+                              NOTIFY_BUS_NAME,
+                              NOTIFY_PATH,
+                              NOTIFY_IFACE,
+                              "CloseNotification",
+                              g_variant_new ("(u)", p->notify_id),
+                              NULL,
+                              G_DBUS_CALL_FLAGS_NONE,
+                              -1, /* default timeout */
+                              p->notify_cancellable,
+                              on_close_notification_response,
+                              self);
+      p->notify_id = 0;
     }
 }
 
+static void
+on_notification_closed (GDBusConnection * connection     G_GNUC_UNUSED,
+                        const gchar     * sender_name    G_GNUC_UNUSED,
+                        const gchar     * object_path    G_GNUC_UNUSED,
+                        const gchar     * interface_name G_GNUC_UNUSED,
+                        const gchar     * signal_name    G_GNUC_UNUSED,
+                        GVariant        * parameters,
+                        gpointer          gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+  guint32 id = 0;
+  guint32 reason = 0;
+
+  g_variant_get (parameters, "(uu)", &id, &reason);
+
+  if ((id != 0) && (id == p->notify_id))
+    {
+      p->notify_id = 0;
+
+      if (p->notify_pending != NOTIFY_OP_SHOW)
+        stage_is_warning (INDICATOR_POWER_NOTIFIER(gself), FALSE);
+    }
+}
+
+static void
+on_action_invoked (GDBusConnection * connection     G_GNUC_UNUSED,
+                   const gchar     * sender_name    G_GNUC_UNUSED,
+                   const gchar     * object_path    G_GNUC_UNUSED,
+                   const gchar     * interface_name G_GNUC_UNUSED,
+                   const gchar     * signal_name    G_GNUC_UNUSED,
+                   GVariant        * parameters,
+                   gpointer          gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+  guint32 id = 0;
+  const gchar * action = NULL;
+
+  g_variant_get (parameters, "(u&s)", &id, &action);
+
+  if ((id != 0) && (id == p->notify_id) && !g_strcmp0 (action, "settings"))
+    utils_handle_settings_request();
+}
+
+/* libnotify fallback */
+
+static void
+on_notify_notification_finalized (gpointer gself, GObject * dead)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+  priv_t * const p = get_priv(self);
+  g_return_if_fail ((void*)(p->notify_notification) == (void*)dead);
+  p->notify_notification = NULL;
+  stage_is_warning (self, FALSE);
+}
+
 static void
 on_battery_settings_clicked(NotifyNotification * nn        G_GNUC_UNUSED,
                             char               * action    G_GNUC_UNUSED,
@@ -182,99 +610,378 @@ on_dismiss_clicked(NotifyNotification * nn        G_GNUC_UNUSED,
   /* no-op; libnotify warns if we have a NULL action callback */
 }
 
-static gboolean
-are_actions_supported(IndicatorPowerNotifier * self)
+static void
+notification_show_libnotify (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv(self);
+  NotifyNotification * nn;
+  GError * error;
 
-  if (!p->caps_queried)
+  nn = notify_notification_new(p->pending_summary, p->pending_body, p->pending_icon_name);
+
+  if (p->pending_with_actions)
     {
-      gboolean actions_supported;
-      GList * caps;
-      GList * l;
+      notify_notification_set_hint(nn, "x-canonical-snap-decisions", g_variant_new_string("true"));
+      notify_notification_set_hint(nn, "x-canonical-non-shaped-icon", g_variant_new_string("true"));
+      notify_notification_set_hint(nn, "x-canonical-private-affirmative-tint", g_variant_new_string("true"));
+      notify_notification_set_hint(nn, "x-canonical-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
+      notify_notification_set_timeout(nn, NOTIFY_EXPIRES_NEVER);
+      notify_notification_add_action(nn, "dismiss", _("OK"), on_dismiss_clicked, NULL, NULL);
+      notify_notification_add_action(nn, "settings", _("Battery settings"), on_battery_settings_clicked, NULL, NULL);
+    }
 
-      /* see if actions are supported */
-      actions_supported = FALSE;
-      caps = notify_get_server_caps();
-      for (l=caps; l!=NULL && !actions_supported; l=l->next)
-        if (!g_strcmp0(l->data, "actions"))
-          actions_supported = TRUE;
+  /* if we can show it, keep it */
+  error = NULL;
+  if (notify_notification_show(nn, &error))
+    {
+      p->notify_notification = nn;
+      g_signal_connect(nn, "closed", G_CALLBACK(g_object_unref), NULL);
+      g_object_weak_ref(G_OBJECT(nn), on_notify_notification_finalized, self);
+      stage_is_warning (self, TRUE);
+    }
+  else
+    {
+      g_critical("Unable to show snap decision for '%s': %s", p->pending_body, error->message);
+      g_error_free(error);
+      g_object_unref(nn);
+    }
+}
 
-      p->actions_supported = actions_supported;
-      p->caps_queried = TRUE;
+static void
+notification_clear_libnotify (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  NotifyNotification * nn;
+
+  if ((nn = p->notify_notification))
+    {
+      GError * error = NULL;
+
+      g_object_weak_unref(G_OBJECT(nn), on_notify_notification_finalized, self);
+
+      if (!notify_notification_close(nn, &error))
+        {
+          g_warning("Unable to close notification: %s", error->message);
+          g_error_free(error);
+        }
 
-      g_list_free_full(caps, g_free);
+      p->notify_notification = NULL;
+      stage_is_warning (self, FALSE);
     }
+}
+
+/* */
+
+static void
+notification_clear (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+
+  notification_clear_libnotify (self);
+
+  if ((p->notify_id != 0) || p->notify_in_flight || (p->notify_pending == NOTIFY_OP_SHOW))
+    {
+      p->notify_pending = NOTIFY_OP_CLOSE;
+      stage_is_warning (self, FALSE);
+      notify_flush_soon (self);
+    }
+}
 
-  return p->actions_supported;
+/* never blocks: returns the cached answer from the last GetCapabilities */
+static gboolean
+are_actions_supported(IndicatorPowerNotifier * self)
+{
+  return get_priv(self)->actions_supported;
 }
 
 static void
-notification_show(IndicatorPowerNotifier * self)
+notification_show(IndicatorPowerNotifier * self, PowerLevel power_level)
 {
   priv_t * const p = get_priv(self);
   gdouble pct;
-  const char * title;
-  char * body;
   GStrv icon_names;
-  const char * icon_name;
-  NotifyNotification * nn;
-  GError * error;
-  const PowerLevel power_level = get_battery_power_level(p->battery);
 
   notification_clear(self);
 
   g_return_if_fail(power_level != POWER_LEVEL_OK);
 
-  /* create the notification */
-  title = power_level == POWER_LEVEL_LOW
-        ? _("Battery Low")
-        : _("Battery Critical");
+  /* describe the notification */
+  g_free (p->pending_summary);
+  p->pending_summary = g_strdup (power_level == POWER_LEVEL_LOW
+                                 ? _("Battery Low")
+                                 : _("Battery Critical"));
   pct = indicator_power_device_get_percentage(p->battery);
-  body = g_strdup_printf(_("%.0f%% charge remaining"), pct);
+  g_free (p->pending_body);
+  p->pending_body = g_strdup_printf(_("%.0f%% charge remaining"), pct);
   icon_names = indicator_power_device_get_icon_names(p->battery);
-  if (icon_names && *icon_names)
-    icon_name = icon_names[0];
-  else
-    icon_name = NULL;
-  nn = notify_notification_new(title, body, icon_name);
+  g_free (p->pending_icon_name);
+  p->pending_icon_name = (icon_names && *icon_names) ? g_strdup (icon_names[0]) : NULL;
   g_strfreev (icon_names);
-  g_free (body);
+  p->pending_with_actions = are_actions_supported(self);
 
-  if (are_actions_supported(self))
+  if (p->bus == NULL)
     {
-      notify_notification_set_hint(nn, "x-canonical-snap-decisions", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-canonical-non-shaped-icon", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-canonical-private-affirmative-tint", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-canonical-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
-      notify_notification_set_timeout(nn, NOTIFY_EXPIRES_NEVER);
-      notify_notification_add_action(nn, "dismiss", _("OK"), on_dismiss_clicked, NULL, NULL);
-      notify_notification_add_action(nn, "settings", _("Battery settings"), on_battery_settings_clicked, NULL, NULL);
+      notification_show_libnotify (self);
     }
+  else
+    {
+      p->notify_pending = NOTIFY_OP_SHOW;
+      stage_is_warning (self, TRUE);
+      notify_flush_soon (self);
+    }
+}
+
+/***
+****  Notification server capabilities
+***/
+
+static void
+on_get_capabilities_response (GObject      * bus,
+                              GAsyncResult * res,
+                              gpointer       gself)
+{
+  GError * error;
+  GVariant * v;
 
-  /* if we can show it, keep it */
   error = NULL;
-  if (notify_notification_show(nn, &error))
+  v = g_dbus_connection_call_finish (G_DBUS_CONNECTION(bus), res, &error);
+  if (v == NULL)
     {
-      p->notify_notification = nn;
-      g_signal_connect(nn, "closed", G_CALLBACK(g_object_unref), NULL);
-      g_object_weak_ref(G_OBJECT(nn), on_notify_notification_finalized, self);
-      dbus_battery_set_is_warning (p->dbus_battery, TRUE);
+      /* not all servers implement this, so don't make a fuss about it */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("Unable to get notification server caps: %s", error->message);
+
+      g_error_free (error);
     }
   else
     {
-      g_critical("Unable to show snap decision for '%s': %s", body, error->message);
-      g_error_free(error);
-      g_object_unref(nn);
+      priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+      const gchar ** caps = NULL;
+      gboolean actions_supported = FALSE;
+      guint i;
+
+      g_variant_get (v, "(^a&s)", &caps);
+      for (i=0; caps && caps[i] && !actions_supported; ++i)
+        if (!g_strcmp0 (caps[i], "actions"))
+          actions_supported = TRUE;
+
+      g_debug ("notification server %s actions", actions_supported ? "supports" : "doesn't support");
+      p->actions_supported = actions_supported;
+
+      g_free (caps);
+      g_variant_unref (v);
+    }
+}
+
+static void
+cancel_caps_query (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+
+  if (p->caps_cancellable != NULL)
+    {
+      g_cancellable_cancel (p->caps_cancellable);
+      g_clear_object (&p->caps_cancellable);
     }
 }
 
+static void
+on_notify_name_appeared (GDBusConnection * bus,
+                         const gchar     * name       G_GNUC_UNUSED,
+                         const gchar     * name_owner,
+                         gpointer          gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+  priv_t * const p = get_priv (self);
+
+  cancel_caps_query (self);
+  p->caps_cancellable = g_cancellable_new ();
+
+  /* ask the new owner directly so that the reply describes it */
+  g_dbus_connection_call (bus,
+                          name_owner,
+                          NOTIFY_PATH,
+                          NOTIFY_IFACE,
+                          "GetCapabilities",
+                          NULL,
+                          G_VARIANT_TYPE("(as)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1, /* default timeout */
+                          p->caps_cancellable,
+                          on_get_capabilities_response,
+                          self);
+}
+
+static void
+on_notify_name_vanished (GDBusConnection * bus  G_GNUC_UNUSED,
+                         const gchar     * name G_GNUC_UNUSED,
+                         gpointer          gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+
+  cancel_caps_query (self);
+  get_priv(self)->actions_supported = FALSE;
+}
+
 /***
+****  Dwell time & rate limiting
+***/
+
+static void
+cancel_dwell_timer (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+
+  if (p->dwell_tag != 0)
+    {
+      g_source_remove (p->dwell_tag);
+      p->dwell_tag = 0;
+    }
+}
+
+static gboolean on_dwell_timer (gpointer gself);
+
+/* show a notification for the current PowerLevel unless
+   the battery hasn't been discharging for long enough yet,
+   or unless we've already nagged about this level recently */
+static void
+notification_show_when_allowed (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  const PowerLevel level = p->power_level;
+  const gint64 now = g_get_monotonic_time ();
+  const gint64 dwell_left = p->discharging_since + p->policy.dwell_usec - now;
+
+  g_return_if_fail (level != POWER_LEVEL_OK);
+
+  if (dwell_left > 0)
+    {
+      if (p->dwell_tag == 0)
+        p->dwell_tag = g_timeout_add ((guint)((dwell_left + 999) / 1000), on_dwell_timer, self);
+      return;
+    }
+
+  if ((p->policy.rate_limit_usec > 0) &&
+      (p->last_shown[level] != 0) &&
+      (now - p->last_shown[level] < p->policy.rate_limit_usec))
+    {
+      g_debug ("not notifying about '%s' again so soon", power_level_to_dbus_string (level));
+      return;
+    }
+
+  p->last_shown[level] = now;
+  notification_show (self, level);
+}
+
+static gboolean
+on_dwell_timer (gpointer gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+  priv_t * const p = get_priv(self);
+
+  p->dwell_tag = 0;
+
+  if ((p->battery != NULL) && p->discharging && (p->power_level != POWER_LEVEL_OK))
+    notification_show_when_allowed (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/***
+****  Predictive scheduling
 ****
+****  Rather than waiting for UPower to report that a threshold has been
+****  crossed, a single timer is armed for when the discharging battery is
+****  expected to reach its next PowerLevel. Battery updates that don't move
+****  the prediction much leave the armed timer alone.
 ***/
 
 static void
-on_battery_property_changed (IndicatorPowerNotifier * self)
+cancel_predict_timer (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+
+  if (p->predict_tag != 0)
+    {
+      g_source_remove (p->predict_tag);
+      p->predict_tag = 0;
+    }
+}
+
+static void update_power_level (IndicatorPowerNotifier * self, gboolean fresh_reading);
+
+static gboolean
+on_predict_timer (gpointer gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+  priv_t * const p = get_priv(self);
+
+  p->predict_tag = 0;
+
+  if ((p->battery != NULL) && p->discharging && (p->predict_level < p->power_level))
+    {
+      g_debug ("battery predicted to be '%s' now", power_level_to_dbus_string (p->predict_level));
+      p->predicted_level = p->predict_level;
+      update_power_level (self, FALSE);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_prediction (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  PowerLevel next_level = POWER_LEVEL_OK;
+  gint64 delay = -1;
+  gint64 now;
+  gint64 deadline;
+  guint msec;
+
+  if (p->policy.predictive && p->discharging)
+    delay = predict_next_level (p->battery, &p->policy, p->power_level, &next_level);
+
+  if (delay < 0)
+    {
+      cancel_predict_timer (self);
+      return;
+    }
+
+  /* the battery's percentage and time are as of its last reading, so a
+     chained prediction mustn't count from when the previous timer fired */
+  now = g_get_monotonic_time ();
+  deadline = p->reading_time + delay;
+  delay = MAX (deadline - now, 0);
+
+  /* keep the armed timer unless the prediction moved by more than
+     a tenth of the time left, so UPower's ticks don't re-arm it */
+  if ((p->predict_tag != 0) && (p->predict_level == next_level))
+    {
+      const gint64 slack = MAX ((p->predict_deadline - now) / 10, G_USEC_PER_SEC);
+
+      if (ABS (deadline - p->predict_deadline) <= slack)
+        return;
+    }
+
+  cancel_predict_timer (self);
+  p->predict_deadline = deadline;
+  p->predict_level = next_level;
+
+  /* long waits don't need to be precise, so let them share wakeups */
+  msec = (guint) MIN ((delay + 999) / 1000, (gint64)G_MAXUINT);
+  if (msec >= 10000)
+    p->predict_tag = g_timeout_add_seconds (msec / 1000, on_predict_timer, self);
+  else
+    p->predict_tag = g_timeout_add (msec, on_predict_timer, self);
+}
+
+/***
+****
+***/
+
+/* fresh_reading is FALSE when the prediction timer is all that changed */
+static void
+update_power_level (IndicatorPowerNotifier * self, gboolean fresh_reading)
 {
   priv_t * p;
   PowerLevel old_power_level;
@@ -286,28 +993,66 @@ on_battery_property_changed (IndicatorPowerNotifier * self)
   p = get_priv (self);
   g_return_if_fail(INDICATOR_IS_POWER_DEVICE(p->battery));
 
-  old_power_level = p->power_level;
-  new_power_level = get_battery_power_level (p->battery);
+  if (fresh_reading)
+    p->reading_time = g_get_monotonic_time ();
 
   old_discharging = p->discharging;
   new_discharging = indicator_power_device_get_state(p->battery) == UP_DEVICE_STATE_DISCHARGING;
 
+  /* a prediction only holds while the battery keeps discharging */
+  if (!new_discharging || !p->policy.predictive)
+    p->predicted_level = POWER_LEVEL_OK;
+
+  old_power_level = p->power_level;
+  new_power_level = get_battery_power_level_with_policy (p->battery, &p->policy, old_power_level);
+
+  /* ...and until a reading says the battery's above the predicted level.
+     Hysteresis still applies, so readings just short of it don't count */
+  if (fresh_reading && (new_power_level > p->predicted_level))
+    p->predicted_level = POWER_LEVEL_OK;
+
+  new_power_level = MIN (new_power_level, p->predicted_level);
+
+  if (new_discharging && !old_discharging)
+    p->discharging_since = g_get_monotonic_time ();
+
+  p->power_level = new_power_level;
+  p->discharging = new_discharging;
+
   /* pop up a 'low battery' notification if either:
      a) it's already discharging, and its PowerLevel worsens, OR
      b) it's already got a bad PowerLevel and its state becomes 'discharging */
   if ((new_discharging && (old_power_level > new_power_level)) ||
       ((new_power_level != POWER_LEVEL_OK) && new_discharging && !old_discharging))
     {
-      notification_show (self);
+      notification_show_when_allowed (self);
     }
   else if (!new_discharging || (new_power_level == POWER_LEVEL_OK))
     {
+      cancel_dwell_timer (self);
       notification_clear (self);
     }
 
-  dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (new_power_level));
-  p->power_level = new_power_level;
-  p->discharging = new_discharging;
+  stage_power_level (self, new_power_level);
+
+  schedule_prediction (self);
+}
+
+static void
+on_battery_property_changed (IndicatorPowerNotifier * self)
+{
+  update_power_level (self, TRUE);
+}
+
+static void
+on_settings_changed (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+
+  load_policy (self);
+
+  if (p->battery != NULL)
+    on_battery_property_changed (self);
 }
 
 /***
@@ -360,9 +1105,26 @@ my_dispose (GObject * o)
   priv_t * const p = get_priv (self);
 
   indicator_power_notifier_set_bus (self, NULL);
+  cancel_dwell_timer (self);
+  cancel_predict_timer (self);
   notification_clear (self);
   indicator_power_notifier_set_battery (self, NULL);
+
+  if (p->battery_flush_tag != 0)
+    {
+      g_source_remove (p->battery_flush_tag);
+      p->battery_flush_tag = 0;
+    }
+
+  if (p->settings != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->settings, self);
+      g_clear_object (&p->settings);
+    }
   g_clear_object (&p->dbus_battery);
+  g_clear_pointer (&p->pending_summary, g_free);
+  g_clear_pointer (&p->pending_body, g_free);
+  g_clear_pointer (&p->pending_icon_name, g_free);
 
   G_OBJECT_CLASS (indicator_power_notifier_parent_class)->dispose (o);
 }
@@ -386,12 +1148,31 @@ static void
 indicator_power_notifier_init (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv (self);
+  GSettingsSchema * schema;
 
   /* bind the read-only properties so they'll get pushed to the bus */
 
   p->dbus_battery = dbus_battery_skeleton_new ();
 
   p->power_level = POWER_LEVEL_OK;
+  p->predicted_level = POWER_LEVEL_OK;
+
+  /* the power level policy is only in our schema,
+     so fall back to the defaults if it's not installed */
+  schema = g_settings_schema_source_lookup (g_settings_schema_source_get_default(),
+                                            SETTINGS_SCHEMA,
+                                            TRUE);
+  if (schema != NULL)
+    {
+      if (g_settings_schema_has_key (schema, SETTINGS_PREDICTIVE_S))
+        {
+          p->settings = g_settings_new (SETTINGS_SCHEMA);
+          g_signal_connect_swapped (p->settings, "changed",
+                                    G_CALLBACK(on_settings_changed), self);
+        }
+      g_settings_schema_unref (schema);
+    }
+  load_policy (self);
 
   if (!instance_count++ && !notify_init("ayatana-indicator-power-service"))
     g_critical("Unable to initialize libnotify! Notifications might not be shown.");
@@ -448,7 +1229,10 @@ indicator_power_notifier_set_battery (IndicatorPowerNotifier * self,
     {
       g_signal_handlers_disconnect_by_data (p->battery, self);
       g_clear_object (&p->battery);
-      dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (POWER_LEVEL_OK));
+      stage_power_level (self, POWER_LEVEL_OK);
+      cancel_dwell_timer (self);
+      cancel_predict_timer (self);
+      p->predicted_level = POWER_LEVEL_OK;
       notification_clear (self);
     }
 
@@ -459,6 +1243,8 @@ indicator_power_notifier_set_battery (IndicatorPowerNotifier * self,
                                 G_CALLBACK(on_battery_property_changed), self);
       g_signal_connect_swapped (p->battery, "notify::"INDICATOR_POWER_DEVICE_STATE,
                                 G_CALLBACK(on_battery_property_changed), self);
+      g_signal_connect_swapped (p->battery, "notify::"INDICATOR_POWER_DEVICE_TIME,
+                                G_CALLBACK(on_battery_property_changed), self);
       on_battery_property_changed (self);
     }
 }
@@ -485,6 +1271,45 @@ indicator_power_notifier_set_bus (IndicatorPowerNotifier * self,
       if (skel != NULL)
         g_dbus_interface_skeleton_unexport (skel);
 
+      if (p->notify_name_tag != 0)
+        {
+          g_bus_unwatch_name (p->notify_name_tag);
+          p->notify_name_tag = 0;
+        }
+
+      cancel_caps_query (self);
+      p->actions_supported = FALSE;
+
+      g_dbus_connection_signal_unsubscribe (p->bus, p->notify_closed_tag);
+      g_dbus_connection_signal_unsubscribe (p->bus, p->notify_action_tag);
+      p->notify_closed_tag = p->notify_action_tag = 0;
+
+      /* stop anything in flight, but don't leave our notification behind */
+      g_cancellable_cancel (p->notify_cancellable);
+      g_clear_object (&p->notify_cancellable);
+      if (p->notify_flush_tag != 0)
+        {
+          g_source_remove (p->notify_flush_tag);
+          p->notify_flush_tag = 0;
+        }
+      if (p->notify_id != 0)
+        {
+          g_dbus_connection_call (p->bus,
+                                  NOTIFY_BUS_NAME,
+                                  NOTIFY_PATH,
+                                  NOTIFY_IFACE,
+                                  "CloseNotification",
+                                  g_variant_new ("(u)", p->notify_id),
+                                  NULL,
+                                  G_DBUS_CALL_FLAGS_NONE,
+                                  -1, /* default timeout */
+                                  NULL, NULL, NULL);
+          p->notify_id = 0;
+          stage_is_warning (self, FALSE);
+        }
+      p->notify_in_flight = FALSE;
+      p->notify_pending = NOTIFY_OP_NONE;
+
       g_clear_object (&p->bus);
     }
 
@@ -494,6 +1319,38 @@ indicator_power_notifier_set_bus (IndicatorPowerNotifier * self,
 
       p->bus = g_object_ref (bus);
 
+      p->notify_cancellable = g_cancellable_new ();
+      p->notify_closed_tag = g_dbus_connection_signal_subscribe (bus,
+                                                                 NOTIFY_BUS_NAME,
+                                                                 NOTIFY_IFACE,
+                                                                 "NotificationClosed",
+                                                                 NOTIFY_PATH,
+                                                                 NULL,
+                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 on_notification_closed,
+                                                                 self,
+                                                                 NULL);
+      p->notify_action_tag = g_dbus_connection_signal_subscribe (bus,
+                                                                 NOTIFY_BUS_NAME,
+                                                                 NOTIFY_IFACE,
+                                                                 "ActionInvoked",
+                                                                 NOTIFY_PATH,
+                                                                 NULL,
+                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 on_action_invoked,
+                                                                 self,
+                                                                 NULL);
+
+      /* (re)fetch the server caps whenever the notification daemon
+         changes owners, so that notification_show() never has to */
+      p->notify_name_tag = g_bus_watch_name_on_connection (bus,
+                                                           NOTIFY_BUS_NAME,
+                                                           G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+                                                           on_notify_name_appeared,
+                                                           on_notify_name_vanished,
+                                                           self,
+                                                           NULL);
+
       error = NULL;
       if (!g_dbus_interface_skeleton_export(skel,
                                             bus,
@@ -24,9 +24,14 @@
 #include <gio/gio.h>
 #include <ayatana/common/utils.h>
 #include "brightness.h"
+#include "brightness-backend-sysfs.h"
 #include "dbus-shared.h"
 #include "device.h"
+#include "device-cache.h"
+#include "device-exporter.h"
 #include "device-provider.h"
+#include "device-provider-mock.h"
+#include "history.h"
 #include "notifier.h"
 #include "service.h"
 #include "flashlight.h"
@@ -39,6 +44,9 @@
 #define SETTINGS_ICON_POLICY_S "icon-policy"
 #define SETTINGS_SHOW_PERCENTAGE_S "show-percentage"
 
+/* how long cached devices are shown if the provider never reports */
+#define STALE_DEVICES_TIMEOUT_SEC 15
+
 enum
 {
   SIGNAL_NAME_LOST,
@@ -94,6 +102,9 @@ struct ProfileMenuInfo
   /* parent of the sections. This is the header's submenu */
   GMenu * submenu;
 
+  /* true once the submenu's sections have been added */
+  gboolean sections_built;
+
   guint export_id;
 };
 
@@ -104,16 +115,30 @@ struct _IndicatorPowerServicePrivate
   GSettings * settings;
 
   IndicatorPowerBrightness * brightness;
+  gboolean have_backlight;
+  IndicatorPowerFlashlight * flashlight;
 
   guint own_id;
   guint actions_export_id;
+  guint header_actions_export_id;
+  guint headerless_actions_export_id;
   GDBusConnection * conn;
 
-  gboolean menus_built;
   struct ProfileMenuInfo menus[N_PROFILES];
 
+  /* staged startup: see indicator_power_service_init() */
+  gint64 init_time;
+  guint startup_idle_id;
+
   GSimpleActionGroup * actions;
   GSimpleAction * header_action;
+  GSimpleActionGroup * header_actions;
+  GSimpleActionGroup * headerless_actions;
+  GSimpleAction * header_title_action;
+  GSimpleAction * header_label_action;
+  GSimpleAction * header_accessible_desc_action;
+  GSimpleAction * header_icon_action;
+  GSimpleAction * header_visible_action;
   GSimpleAction * battery_level_action;
   GSimpleAction * device_state_action;
   GSimpleAction * brightness_action;
@@ -121,8 +146,15 @@ struct _IndicatorPowerServicePrivate
   IndicatorPowerDevice * primary_device;
   GList * devices; /* IndicatorPowerDevice */
 
+  /* true while the devices are the last session's, read from the cache */
+  gboolean devices_stale;
+  guint stale_timeout_id;
+
   IndicatorPowerDeviceProvider * device_provider;
   IndicatorPowerNotifier * notifier;
+  IndicatorPowerHistory * history;
+  IndicatorPowerDeviceExporter * device_exporter;
+  IndicatorPowerDeviceCache * device_cache;
 };
 
 typedef IndicatorPowerServicePrivate priv_t;
@@ -495,6 +527,41 @@ create_header_state (IndicatorPowerService * self)
   return g_variant_builder_end (&b);
 }
 
+/* The "_header" action's state is re-sent whole whenever any part of it
+   changes, icon included. These actions hold the same parts separately
+   so that a panel watching them only gets sent the parts that changed:
+   GSimpleAction doesn't notify when a state is set to an equal value. */
+static void
+update_header_actions (IndicatorPowerService * self, GVariant * header)
+{
+  priv_t * p = self->priv;
+  const char * str;
+  gboolean visible;
+  GVariant * icon;
+
+  if (!g_variant_lookup (header, "title", "&s", &str))
+    str = "";
+  g_simple_action_set_state (p->header_title_action, g_variant_new_string (str));
+
+  if (!g_variant_lookup (header, "label", "&s", &str))
+    str = "";
+  g_simple_action_set_state (p->header_label_action, g_variant_new_string (str));
+
+  if (!g_variant_lookup (header, "accessible-desc", "&s", &str))
+    str = "";
+  g_simple_action_set_state (p->header_accessible_desc_action, g_variant_new_string (str));
+
+  if (!g_variant_lookup (header, "visible", "b", &visible))
+    visible = FALSE;
+  g_simple_action_set_state (p->header_visible_action, g_variant_new_boolean (visible));
+
+  icon = g_variant_lookup_value (header, "icon", NULL);
+  g_simple_action_set_state (p->header_icon_action,
+                             g_variant_new_maybe (G_VARIANT_TYPE_VARIANT,
+                                                  icon ? g_variant_new_variant (icon) : NULL));
+  g_clear_pointer (&icon, g_variant_unref);
+}
+
 
 /***
 ****
@@ -620,6 +687,8 @@ update_brightness_action_state (IndicatorPowerService * self)
                              action_state_for_brightness (self));
 }
 
+static void on_auto_brightness_supported_changed (IndicatorPowerService * self);
+
 static void
 on_brightness_change_requested (GSimpleAction * action      G_GNUC_UNUSED,
                                 GVariant      * parameter,
@@ -632,10 +701,19 @@ on_brightness_change_requested (GSimpleAction * action      G_GNUC_UNUSED,
 }
 
 static GMenuModel *
-create_desktop_settings_section (IndicatorPowerService * self G_GNUC_UNUSED)
+create_desktop_settings_section (IndicatorPowerService * self)
 {
   GMenu * menu = g_menu_new ();
 
+  /* only when we're driving a backlight ourselves; see init_brightness() */
+  if (self->priv->have_backlight)
+    {
+      GMenuItem * item = create_brightness_menu_item();
+      g_menu_append_item(menu, item);
+      update_brightness_action_state(self);
+      g_object_unref(item);
+    }
+
   g_menu_append (menu,
                  _("Power Settings…"),
                  "indicator.activate-settings");
@@ -669,13 +747,15 @@ create_phone_settings_section(IndicatorPowerService * self)
       g_object_unref(item);
     }
 
-  if (flashlight_supported())
+  /* the flashlight isn't probed until startup's idle callback */
+  if ((self->priv->flashlight != NULL) &&
+      indicator_power_flashlight_is_supported(self->priv->flashlight))
   {
     item = g_menu_item_new(_("Flashlight"), "indicator.flashlight");
     g_menu_item_set_attribute(item, "x-ayatana-type", "s", "org.ayatana.indicator.switch");
     g_menu_append_item(section, item);
     g_object_unref(item);
-    if (flashlight_activated())
+    if (indicator_power_flashlight_get_active(self->priv->flashlight))
     {
       item = g_menu_item_new(_("Warning: Heavy use can damage the LED!"), "indicator.flashlight");
       g_menu_append_item(section, item);
@@ -717,22 +797,28 @@ rebuild_now (IndicatorPowerService * self, guint sections)
 
   if (sections & SECTION_HEADER)
     {
-      g_simple_action_set_state (p->header_action, create_header_state (self));
+      GVariant * header = g_variant_ref_sink (create_header_state (self));
+      g_simple_action_set_state (p->header_action, header);
+      update_header_actions (self, header);
+      g_variant_unref (header);
     }
 
-  if (!p->menus_built)
-    return;
-
   if (sections & SECTION_DEVICES)
     {
-      rebuild_section (desktop->submenu, 0, create_desktop_devices_section (self, PROFILE_DESKTOP));
-      rebuild_section (greeter->submenu, 0, create_desktop_devices_section (self, PROFILE_DESKTOP_GREETER));
+      if (desktop->sections_built)
+        rebuild_section (desktop->submenu, 0, create_desktop_devices_section (self, PROFILE_DESKTOP));
+
+      if (greeter->sections_built)
+        rebuild_section (greeter->submenu, 0, create_desktop_devices_section (self, PROFILE_DESKTOP_GREETER));
     }
 
   if (sections & SECTION_SETTINGS)
     {
-      rebuild_section (desktop->submenu, 1, create_desktop_settings_section (self));
-      rebuild_section (phone->submenu, 1, create_phone_settings_section (self));
+      if (desktop->sections_built)
+        rebuild_section (desktop->submenu, 1, create_desktop_settings_section (self));
+
+      if (phone->sections_built)
+        rebuild_section (phone->submenu, 1, create_phone_settings_section (self));
     }
 }
 
@@ -742,18 +828,50 @@ rebuild_header_now (IndicatorPowerService * self)
   rebuild_now (self, SECTION_HEADER);
 }
 
+/* builds the root menu and the header item, but leaves the header's
+   submenu empty until build_menu_sections() is called for the profile */
 static void
 create_menu (IndicatorPowerService * self, int profile)
 {
   GMenu * menu;
   GMenu * submenu;
   GMenuItem * header;
+
+  g_assert (0<=profile && profile<N_PROFILES);
+  g_assert (self->priv->menus[profile].menu == NULL);
+
+  submenu = g_menu_new ();
+
+  /* add submenu to the header */
+  header = g_menu_item_new (NULL, "indicator._header");
+  g_menu_item_set_attribute (header, "x-ayatana-type",
+                             "s", "org.ayatana.indicator.root");
+  g_menu_item_set_submenu (header, G_MENU_MODEL (submenu));
+  g_object_unref (submenu);
+
+  /* add header to the menu */
+  menu = g_menu_new ();
+  g_menu_append_item (menu, header);
+  g_object_unref (header);
+
+  self->priv->menus[profile].menu = menu;
+  self->priv->menus[profile].submenu = submenu;
+}
+
+static void
+build_menu_sections (IndicatorPowerService * self, int profile)
+{
+  struct ProfileMenuInfo * info;
   GMenuModel * sections[16];
   guint i;
   guint n = 0;
 
   g_assert (0<=profile && profile<N_PROFILES);
-  g_assert (self->priv->menus[profile].menu == NULL);
+  info = &self->priv->menus[profile];
+  g_assert (info->submenu != NULL);
+
+  if (info->sections_built)
+    return;
 
   /* build the sections */
 
@@ -776,28 +894,13 @@ create_menu (IndicatorPowerService * self, int profile)
 
   /* add sections to the submenu */
 
-  submenu = g_menu_new ();
-
   for (i=0; i<n; ++i)
     {
-      g_menu_append_section (submenu, NULL, sections[i]);
+      g_menu_append_section (info->submenu, NULL, sections[i]);
       g_object_unref (sections[i]);
     }
 
-  /* add submenu to the header */
-  header = g_menu_item_new (NULL, "indicator._header");
-  g_menu_item_set_attribute (header, "x-ayatana-type",
-                             "s", "org.ayatana.indicator.root");
-  g_menu_item_set_submenu (header, G_MENU_MODEL (submenu));
-  g_object_unref (submenu);
-
-  /* add header to the menu */
-  menu = g_menu_new ();
-  g_menu_append_item (menu, header);
-  g_object_unref (header);
-
-  self->priv->menus[profile].menu = menu;
-  self->priv->menus[profile].submenu = submenu;
+  info->sections_built = TRUE;
 }
 
 /***
@@ -873,6 +976,69 @@ convert_auto_state_to_prop(GBinding     * binding     G_GNUC_UNUSED,
   return TRUE;
 }
 
+static void
+on_flashlight_set (GObject      * flashlight,
+                   GAsyncResult * res,
+                   gpointer       gself G_GNUC_UNUSED)
+{
+  GError * error = NULL;
+
+  if (!indicator_power_flashlight_set_active_finish (INDICATOR_POWER_FLASHLIGHT(flashlight), res, &error))
+    {
+      /* the action's state is bound to the flashlight's, so it's still right */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+          !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_PENDING))
+        g_warning ("%s", error->message);
+
+      g_error_free (error);
+    }
+}
+
+static void
+on_flashlight_activated (GSimpleAction * action    G_GNUC_UNUSED,
+                         GVariant      * parameter G_GNUC_UNUSED,
+                         gpointer        gself)
+{
+  priv_t * p = INDICATOR_POWER_SERVICE(gself)->priv;
+
+  if (indicator_power_flashlight_is_supported (p->flashlight))
+    indicator_power_flashlight_set_active_async (p->flashlight,
+                                                 !indicator_power_flashlight_get_active (p->flashlight),
+                                                 p->cancellable,
+                                                 on_flashlight_set,
+                                                 gself);
+}
+
+/* the settings section shows a warning while the flashlight's on */
+static void
+on_flashlight_active_changed (IndicatorPowerService * self)
+{
+  rebuild_now (self, SECTION_SETTINGS);
+}
+
+static GSimpleAction *
+add_header_action (GSimpleActionGroup * group, const char * name, GVariant * state)
+{
+  GSimpleAction * a = g_simple_action_new_stateful (name, NULL, state);
+
+  g_action_map_add_action (G_ACTION_MAP(group), G_ACTION(a));
+
+  return a;
+}
+
+/* keeps headerless_actions holding everything in actions but "_header" */
+static void
+on_action_added (GActionGroup * group,
+                 const gchar  * action_name,
+                 gpointer       gself)
+{
+  priv_t * p = INDICATOR_POWER_SERVICE(gself)->priv;
+
+  if (g_strcmp0 (action_name, "_header") != 0)
+    g_action_map_add_action (G_ACTION_MAP(p->headerless_actions),
+                             g_action_map_lookup_action (G_ACTION_MAP(group), action_name));
+}
+
 static void
 init_gactions (IndicatorPowerService * self)
 {
@@ -888,6 +1054,8 @@ init_gactions (IndicatorPowerService * self)
   };
 
   p->actions = g_simple_action_group_new ();
+  p->headerless_actions = g_simple_action_group_new ();
+  g_signal_connect (p->actions, "action-added", G_CALLBACK(on_action_added), self);
 
   g_action_map_add_action_entries (G_ACTION_MAP(p->actions),
                                    entries,
@@ -899,6 +1067,14 @@ init_gactions (IndicatorPowerService * self)
   g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
   p->header_action = a;
 
+  /* add the fine-grained header actions. They're filled in by rebuild_header_now() */
+  p->header_actions = g_simple_action_group_new ();
+  p->header_title_action = add_header_action (p->header_actions, "title", g_variant_new_string (""));
+  p->header_label_action = add_header_action (p->header_actions, "label", g_variant_new_string (""));
+  p->header_accessible_desc_action = add_header_action (p->header_actions, "accessible-desc", g_variant_new_string (""));
+  p->header_icon_action = add_header_action (p->header_actions, "icon", g_variant_new_maybe (G_VARIANT_TYPE_VARIANT, NULL));
+  p->header_visible_action = add_header_action (p->header_actions, "visible", g_variant_new_boolean (FALSE));
+
   /* add the power-level action */
   a = g_simple_action_new_stateful ("battery-level", NULL, calculate_battery_level_action_state(self));
   g_simple_action_set_enabled (a, FALSE);
@@ -911,6 +1087,48 @@ init_gactions (IndicatorPowerService * self)
   g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
   p->device_state_action = a;
 
+  /* add the show-time action */
+  show_time_action = g_settings_create_action (p->settings, "show-time");
+  g_action_map_add_action (G_ACTION_MAP(p->actions), show_time_action);
+
+  /* add the show-percentage action */
+  show_percentage_action = g_settings_create_action (p->settings, "show-percentage");
+  g_action_map_add_action (G_ACTION_MAP(p->actions), show_percentage_action);
+
+  rebuild_header_now (self);
+
+  g_object_unref (show_time_action);
+  g_object_unref (show_percentage_action);
+}
+
+/* The brightness object talks to powerd and Unity.Screen on the system bus,
+   so it's created after the header's been exported. See on_startup_idle().
+   Outside of Lomiri there's no powerd, so drive the backlight directly. */
+static void
+init_brightness (IndicatorPowerService * self)
+{
+  GSimpleAction * a;
+  IndicatorPowerBrightnessBackend * backend = NULL;
+  priv_t * p = self->priv;
+
+  g_assert (p->brightness == NULL);
+
+  if (!ayatana_common_utils_is_lomiri())
+    backend = indicator_power_brightness_backend_sysfs_new (NULL, TRUE);
+
+  if (backend != NULL)
+    {
+      p->have_backlight = TRUE;
+      p->brightness = indicator_power_brightness_new_with_backend (backend);
+      g_object_unref (backend);
+    }
+  else
+    {
+      p->brightness = indicator_power_brightness_new();
+    }
+  g_signal_connect_swapped(p->brightness, "notify::percentage",
+                           G_CALLBACK(update_brightness_action_state), self);
+
   /* add the auto-brightness action */
   a = g_simple_action_new_stateful("auto-brightness", NULL, g_variant_new_boolean(FALSE));
   g_object_bind_property_full(p->brightness, "auto-brightness",
@@ -921,29 +1139,102 @@ init_gactions (IndicatorPowerService * self)
                               NULL, NULL);
   g_action_map_add_action(G_ACTION_MAP(p->actions), G_ACTION(a));
 
-  /* add the flashlight action */
-  a = g_simple_action_new_stateful("flashlight", NULL, g_variant_new_boolean(FALSE));
-  g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
-  g_signal_connect(a, "activate", G_CALLBACK(toggle_flashlight_action), self);
-
   /* add the brightness action */
   a = g_simple_action_new_stateful ("brightness", NULL, action_state_for_brightness (self));
   g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
   g_signal_connect (a, "change-state", G_CALLBACK(on_brightness_change_requested), self);
   p->brightness_action = a;
 
-  /* add the show-time action */
-  show_time_action = g_settings_create_action (p->settings, "show-time");
-  g_action_map_add_action (G_ACTION_MAP(p->actions), show_time_action);
+  g_signal_connect_swapped(p->brightness, "notify::auto-brightness-supported",
+                           G_CALLBACK(on_auto_brightness_supported_changed), self);
+}
 
-  /* add the show-percentage action */
-  show_percentage_action = g_settings_create_action (p->settings, "show-percentage");
-  g_action_map_add_action (G_ACTION_MAP(p->actions), show_percentage_action);
+/***
+****  Staged Startup
+***/
 
-  rebuild_header_now (self);
+static void
+log_startup_phase (IndicatorPowerService * self, const char * phase)
+{
+  const gint64 elapsed_usec = g_get_monotonic_time () - self->priv->init_time;
 
-  g_object_unref (show_time_action);
-  g_object_unref (show_percentage_action);
+  g_debug ("startup: %s after %.1f ms", phase, elapsed_usec / 1000.0);
+}
+
+static int
+get_primary_profile (void)
+{
+  return ayatana_common_utils_is_lomiri() ? PROFILE_PHONE : PROFILE_DESKTOP;
+}
+
+/* Lowest priority: everything the user isn't looking at yet */
+static gboolean
+on_startup_secondary_idle (gpointer gself)
+{
+  IndicatorPowerService * self = INDICATOR_POWER_SERVICE (gself);
+  priv_t * p = self->priv;
+  const int primary = get_primary_profile ();
+  int i;
+
+  p->startup_idle_id = 0;
+
+  for (i=0; i<N_PROFILES; ++i)
+    if (i != primary)
+      build_menu_sections (self, i);
+
+  log_startup_phase (self, "all profiles built");
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Probing the flashlight scans the LEDs in sysfs and opens and monitors
+   the one it picks, so like the brightness object it's created after the
+   header's been exported. Until then the settings section leaves it out. */
+static void
+init_flashlight (IndicatorPowerService * self)
+{
+  GSimpleAction * a;
+  priv_t * p = self->priv;
+
+  g_assert (p->flashlight == NULL);
+
+  p->flashlight = indicator_power_flashlight_new (NULL);
+  g_signal_connect_swapped (p->flashlight, "notify::"INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE,
+                            G_CALLBACK(on_flashlight_active_changed), self);
+
+  /* add the flashlight action */
+  a = g_simple_action_new_stateful("flashlight", NULL, g_variant_new_boolean(FALSE));
+  g_object_bind_property_full(p->flashlight, INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE,
+                              a, "state",
+                              G_BINDING_SYNC_CREATE,
+                              convert_auto_prop_to_state,
+                              NULL,
+                              NULL, NULL);
+  g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
+  g_signal_connect(a, "activate", G_CALLBACK(on_flashlight_activated), self);
+  g_object_unref(a);
+}
+
+/* After the header: brightness, the flashlight and the primary profile's menu */
+static gboolean
+on_startup_idle (gpointer gself)
+{
+  IndicatorPowerService * self = INDICATOR_POWER_SERVICE (gself);
+  priv_t * p = self->priv;
+
+  init_brightness (self);
+  init_flashlight (self);
+
+  build_menu_sections (self, get_primary_profile ());
+
+  log_startup_phase (self, "primary profile built");
+
+  p->startup_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                        on_startup_secondary_idle,
+                                        self,
+                                        NULL);
+
+  return G_SOURCE_REMOVE;
 }
 
 /***
@@ -963,6 +1254,7 @@ on_bus_acquired (GDBusConnection * connection,
   GString * path = g_string_new (NULL);
 
   g_debug ("bus acquired: %s", name);
+  log_startup_phase (self, "bus acquired");
 
   p->conn = (GDBusConnection*)g_object_ref(G_OBJECT (connection));
   g_object_notify_by_pspec (G_OBJECT(self), properties[PROP_BUS]);
@@ -970,6 +1262,12 @@ on_bus_acquired (GDBusConnection * connection,
   /* export the battery properties */
   indicator_power_notifier_set_bus (p->notifier, connection);
 
+  /* export the battery history */
+  indicator_power_history_set_bus (p->history, connection);
+
+  /* export the devices' properties */
+  indicator_power_device_exporter_set_bus (p->device_exporter, connection);
+
   /* export the actions */
   if ((id = g_dbus_connection_export_action_group (connection,
                                                    BUS_PATH,
@@ -984,6 +1282,34 @@ on_bus_acquired (GDBusConnection * connection,
       g_clear_error (&err);
     }
 
+  /* export the fine-grained header actions */
+  if ((id = g_dbus_connection_export_action_group (connection,
+                                                   BUS_HEADER_PATH,
+                                                   G_ACTION_GROUP (p->header_actions),
+                                                   &err)))
+    {
+      p->header_actions_export_id = id;
+    }
+  else
+    {
+      g_warning ("cannot export header action group: %s", err->message);
+      g_clear_error (&err);
+    }
+
+  /* export the actions again without "_header", for panels that use the above */
+  if ((id = g_dbus_connection_export_action_group (connection,
+                                                   BUS_ACTIONS_PATH,
+                                                   G_ACTION_GROUP (p->headerless_actions),
+                                                   &err)))
+    {
+      p->headerless_actions_export_id = id;
+    }
+  else
+    {
+      g_warning ("cannot export headerless action group: %s", err->message);
+      g_clear_error (&err);
+    }
+
   /* export the menus */
   for (i=0; i<N_PROFILES; ++i)
     {
@@ -1006,6 +1332,8 @@ on_bus_acquired (GDBusConnection * connection,
     }
 
   g_string_free (path, TRUE);
+
+  log_startup_phase (self, "header exported");
 }
 
 static void
@@ -1032,6 +1360,18 @@ unexport (IndicatorPowerService * self)
       g_dbus_connection_unexport_action_group (p->conn, p->actions_export_id);
       p->actions_export_id = 0;
     }
+
+  if (p->header_actions_export_id)
+    {
+      g_dbus_connection_unexport_action_group (p->conn, p->header_actions_export_id);
+      p->header_actions_export_id = 0;
+    }
+
+  if (p->headerless_actions_export_id)
+    {
+      g_dbus_connection_unexport_action_group (p->conn, p->headerless_actions_export_id);
+      p->headerless_actions_export_id = 0;
+    }
 }
 
 static void
@@ -1053,13 +1393,46 @@ on_name_lost (GDBusConnection * connection G_GNUC_UNUSED,
 ***/
 
 static void
-on_devices_changed (IndicatorPowerService * self)
+record_history (gpointer device, gpointer history)
+{
+  indicator_power_history_record (history, device);
+}
+
+static void
+end_stale_devices (IndicatorPowerService * self)
 {
   priv_t * p = self->priv;
 
+  if (p->stale_timeout_id)
+    {
+      g_source_remove (p->stale_timeout_id);
+      p->stale_timeout_id = 0;
+    }
+
+  p->devices_stale = FALSE;
+}
+
+/* takes ownership of the devices list */
+static void
+set_devices (IndicatorPowerService * self, GList * devices)
+{
+  priv_t * p = self->priv;
+
+  if (p->devices_stale)
+    {
+      end_stale_devices (self);
+      log_startup_phase (self, "live devices");
+    }
+
   /* update the device list */
   g_list_free_full (p->devices, (GDestroyNotify)g_object_unref);
-  p->devices = indicator_power_device_provider_get_devices (p->device_provider);
+  p->devices = devices;
+
+  /* sample the devices' charge history */
+  g_list_foreach (p->devices, (GFunc)record_history, p->history);
+
+  /* update the exported devices */
+  indicator_power_device_exporter_set_devices (p->device_exporter, p->devices);
 
   /* update the primary device */
   g_clear_object (&p->primary_device);
@@ -1080,6 +1453,67 @@ on_devices_changed (IndicatorPowerService * self)
   rebuild_now (self, SECTION_HEADER | SECTION_DEVICES);
 }
 
+/* Remembers the devices for the next session's first paint.
+   The testing interface's mock devices aren't real, so they're not kept.
+   Neither is an empty list: it's also what a provider reports when UPower
+   goes away, and it would only replace a snapshot that paints something
+   with one that paints nothing. */
+static void
+cache_devices (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+
+  if ((p->devices == NULL) || INDICATOR_IS_POWER_DEVICE_PROVIDER_MOCK (p->device_provider))
+    return;
+
+  indicator_power_device_cache_save (p->device_cache, p->devices);
+}
+
+static void
+on_devices_changed (IndicatorPowerService * self)
+{
+  set_devices (self, indicator_power_device_provider_get_devices (self->priv->device_provider));
+  cache_devices (self);
+}
+
+static gboolean
+on_stale_devices_timeout (gpointer gself)
+{
+  IndicatorPowerService * self = INDICATOR_POWER_SERVICE (gself);
+  priv_t * p = self->priv;
+
+  p->stale_timeout_id = 0;
+
+  g_debug ("the device provider never reported; dropping the cached devices");
+
+  /* not a live report, so the snapshot's left alone for next time */
+  if (p->device_provider != NULL)
+    set_devices (self, indicator_power_device_provider_get_devices (p->device_provider));
+  else
+    set_devices (self, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Shows the last session's devices until the provider reports.
+   They're only used to paint the header and menu: the notifier,
+   history, and exported devices wait for the live ones. */
+static void
+load_cached_devices (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+
+  p->devices = indicator_power_device_cache_load (p->device_cache);
+  if (p->devices == NULL)
+    return;
+
+  p->primary_device = indicator_power_service_choose_primary_device (p->devices);
+  p->devices_stale = TRUE;
+  p->stale_timeout_id = g_timeout_add_seconds (STALE_DEVICES_TIMEOUT_SEC,
+                                               on_stale_devices_timeout,
+                                               self);
+}
+
 static void
 on_auto_brightness_supported_changed(IndicatorPowerService * self)
 {
@@ -1146,6 +1580,14 @@ my_dispose (GObject * o)
       p->own_id = 0;
     }
 
+  if (p->startup_idle_id)
+    {
+      g_source_remove (p->startup_idle_id);
+      p->startup_idle_id = 0;
+    }
+
+  end_stale_devices (self);
+
   unexport (self);
 
   if (p->cancellable != NULL)
@@ -1162,16 +1604,41 @@ my_dispose (GObject * o)
     }
 
   g_clear_object (&p->notifier);
+  g_clear_object (&p->history);
+  g_clear_object (&p->device_exporter);
+  g_clear_object (&p->device_cache);
   g_clear_object (&p->brightness_action);
   g_clear_object (&p->brightness);
+
+  if (p->flashlight != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->flashlight, self);
+      g_clear_object (&p->flashlight);
+    }
   g_clear_object (&p->battery_level_action);
   g_clear_object (&p->header_action);
-  g_clear_object (&p->actions);
+  g_clear_object (&p->header_title_action);
+  g_clear_object (&p->header_label_action);
+  g_clear_object (&p->header_accessible_desc_action);
+  g_clear_object (&p->header_icon_action);
+  g_clear_object (&p->header_visible_action);
+  g_clear_object (&p->header_actions);
+  g_clear_object (&p->headerless_actions);
+
+  if (p->actions != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->actions, self);
+      g_clear_object (&p->actions);
+    }
 
   g_clear_object (&p->conn);
 
   indicator_power_service_set_device_provider (self, NULL);
 
+  g_clear_object (&p->primary_device);
+  g_list_free_full (p->devices, g_object_unref);
+  p->devices = NULL;
+
   G_OBJECT_CLASS (indicator_power_service_parent_class)->dispose (o);
 }
 
@@ -1188,15 +1655,27 @@ indicator_power_service_init (IndicatorPowerService * self)
   p = indicator_power_service_get_instance_private(self);
   self->priv = p;
 
+  p->init_time = g_get_monotonic_time ();
+
   p->cancellable = g_cancellable_new ();
 
   p->settings = g_settings_new ("org.ayatana.indicator.power");
 
   p->notifier = indicator_power_notifier_new ();
 
-  p->brightness = indicator_power_brightness_new();
-  g_signal_connect_swapped(p->brightness, "notify::percentage",
-                           G_CALLBACK(update_brightness_action_state), self);
+  p->history = indicator_power_history_new (NULL);
+
+  p->device_exporter = indicator_power_device_exporter_new ();
+
+  p->device_cache = indicator_power_device_cache_new (NULL);
+
+  /* Login-time startup is on the panel's critical path, so only do what's
+     needed to export the header before owning the bus name. The brightness
+     object and the menus' sections are filled in later from idle callbacks;
+     the notifier fetches the notification server caps once the bus is up.
+     The header starts out with the last session's devices, if any. */
+
+  load_cached_devices (self);
 
   init_gactions (self);
 
@@ -1204,10 +1683,6 @@ indicator_power_service_init (IndicatorPowerService * self)
 
   for (i=0; i<N_PROFILES; ++i)
     create_menu(self, i);
-  p->menus_built = TRUE;
-
-  g_signal_connect_swapped(p->brightness, "notify::auto-brightness-supported",
-                           G_CALLBACK(on_auto_brightness_supported_changed), self);
 
   p->own_id = g_bus_own_name(G_BUS_TYPE_SESSION,
                              BUS_NAME,
@@ -1217,6 +1692,10 @@ indicator_power_service_init (IndicatorPowerService * self)
                              on_name_lost,
                              self,
                              NULL);
+
+  p->startup_idle_id = g_idle_add (on_startup_idle, self);
+
+  log_startup_phase (self, "header ready");
 }
 
 static void
@@ -1290,16 +1769,27 @@ indicator_power_service_set_device_provider (IndicatorPowerService * self,
 
       g_list_free_full (p->devices, g_object_unref);
       p->devices = NULL;
+
+      end_stale_devices (self);
     }
 
   if (dp != NULL)
     {
+      GList * devices;
+
       p->device_provider = g_object_ref (dp);
 
       g_signal_connect_swapped (p->device_provider, "devices-changed",
                                 G_CALLBACK(on_devices_changed), self);
 
-      on_devices_changed (self);
+      /* a provider that's still enumerating has nothing to say yet,
+         so keep showing the cached devices until it emits */
+      devices = indicator_power_device_provider_get_devices (dp);
+      if ((devices != NULL) || !p->devices_stale)
+        {
+          set_devices (self, devices);
+          cache_devices (self);
+        }
     }
 }
 
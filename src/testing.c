@@ -18,13 +18,29 @@
  */
 
 #include "dbus-shared.h"
+#include "device-provider-composite.h"
 #include "device-provider-mock.h"
+#include "device-provider-sysfs.h"
 #include "device-provider-upower.h"
 #include "dbus-testing.h"
 #include "service.h"
 #include "testing.h"
 
-#include <glib-object.h>
+#include <gio/gio.h>
+
+#define SETTINGS_SCHEMA "org.ayatana.indicator.power"
+#define SETTINGS_DEVICE_PROVIDER_S "device-provider"
+
+#define MOCK_DEVICE_PATH_PREFIX "/org/ayatana/indicator/power/mock/"
+
+/* matches ayatana-indicator-power-device-provider-enum in our schema */
+typedef enum
+{
+  DEVICE_PROVIDER_UPOWER,
+  DEVICE_PROVIDER_SYSFS,
+  DEVICE_PROVIDER_AUTO
+}
+DeviceProvider;
 
 /**
 ***  GObject Properties
@@ -43,14 +59,34 @@ static GParamSpec * properties[LAST_PROP];
 ***
 **/
 
+/* a RunScenario call that's in progress */
+typedef struct
+{
+  GDBusMethodInvocation * invocation;
+  GVariant * updates;
+  gsize n_updates;
+  gsize next;
+  gdouble speed;
+  gint64 start_time;
+  guint source_id;
+
+  GArray * apply_usec; /* gint64 */
+  gint64 max_lag_usec;
+  guint n_rebuilds;
+  gulong rebuild_tag;
+}
+Scenario;
+
 typedef struct
 {
   GDBusConnection * bus;
   DbusTesting * skeleton;
   IndicatorPowerService * service;
   IndicatorPowerDevice * battery_mock;
+  GHashTable * mock_devices; /* name --> IndicatorPowerDevice */
+  Scenario * scenario;
   gpointer provider_mock;
-  gpointer provider_upower;
+  gpointer provider_real;
 }
 IndicatorPowerTestingPrivate;
 
@@ -66,6 +102,51 @@ G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerTesting,
 ****
 ***/
 
+/* UPower unless the system's configured to read sysfs directly,
+   e.g. on minimal images that don't ship UPower, or to use both */
+static IndicatorPowerDeviceProvider *
+create_real_provider (void)
+{
+  GSettingsSchema * schema;
+  DeviceProvider which = DEVICE_PROVIDER_UPOWER;
+
+  schema = g_settings_schema_source_lookup(g_settings_schema_source_get_default(),
+                                           SETTINGS_SCHEMA,
+                                           TRUE);
+  if (schema != NULL)
+    {
+      if (g_settings_schema_has_key(schema, SETTINGS_DEVICE_PROVIDER_S))
+        {
+          GSettings * settings = g_settings_new(SETTINGS_SCHEMA);
+          which = (DeviceProvider) g_settings_get_enum(settings, SETTINGS_DEVICE_PROVIDER_S);
+          g_object_unref(settings);
+        }
+      g_settings_schema_unref(schema);
+    }
+
+  if (which == DEVICE_PROVIDER_SYSFS)
+    return indicator_power_device_provider_sysfs_new(NULL, -1);
+
+  if (which == DEVICE_PROVIDER_AUTO)
+    {
+      IndicatorPowerDeviceProvider * composite = indicator_power_device_provider_composite_new();
+      IndicatorPowerDeviceProvider * provider;
+
+      /* UPower knows more about peripherals, so prefer its view of a device */
+      provider = indicator_power_device_provider_upower_new();
+      indicator_power_device_provider_composite_add(INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE(composite), provider, 1);
+      g_object_unref(provider);
+
+      provider = indicator_power_device_provider_sysfs_new(NULL, -1);
+      indicator_power_device_provider_composite_add(INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE(composite), provider, 0);
+      g_object_unref(provider);
+
+      return composite;
+    }
+
+  return indicator_power_device_provider_upower_new();
+}
+
 static void
 update_device_provider (IndicatorPowerTesting * self)
 {
@@ -74,7 +155,7 @@ update_device_provider (IndicatorPowerTesting * self)
 
   device_provider = dbus_testing_get_mock_battery_enabled(p->skeleton)
                   ? p->provider_mock
-                  : p->provider_upower;
+                  : p->provider_real;
   indicator_power_service_set_device_provider(p->service, device_provider);
 }
 
@@ -147,22 +228,32 @@ on_mock_battery_state_changed(DbusTesting           * skeleton,
                               GParamSpec            * pspec    G_GNUC_UNUSED,
                               IndicatorPowerTesting * self)
 {
+  /* the same names as the service's "device-state" action */
+  static const struct {
+    const char * name;
+    UpDeviceState state;
+  } states[] = {
+    { "unknown",           UP_DEVICE_STATE_UNKNOWN },
+    { "charging",          UP_DEVICE_STATE_CHARGING },
+    { "discharging",       UP_DEVICE_STATE_DISCHARGING },
+    { "empty",             UP_DEVICE_STATE_EMPTY },
+    { "fully-charged",     UP_DEVICE_STATE_FULLY_CHARGED },
+    { "pending-charge",    UP_DEVICE_STATE_PENDING_CHARGE },
+    { "pending-discharge", UP_DEVICE_STATE_PENDING_DISCHARGE }
+  };
+
   const gchar* state_str = dbus_testing_get_mock_battery_state(skeleton);
-  UpDeviceState state;
+  UpDeviceState state = UP_DEVICE_STATE_UNKNOWN;
+  guint i;
 
-  if (!g_strcmp0(state_str, "charging"))
-    {
-      state = UP_DEVICE_STATE_CHARGING;
-    }
-  else if (!g_strcmp0(state_str, "discharging"))
-    {
-      state = UP_DEVICE_STATE_DISCHARGING;
-    }
+  for (i=0; i<G_N_ELEMENTS(states); ++i)
+    if (!g_strcmp0(state_str, states[i].name))
+      break;
+
+  if (i < G_N_ELEMENTS(states))
+    state = states[i].state;
   else
-    {
-      g_warning("%s unsupported state: '%s'", G_STRLOC, state_str);
-      state = UP_DEVICE_STATE_UNKNOWN;
-    }
+    g_warning("%s unsupported state: '%s'", G_STRLOC, state_str);
 
   g_object_set(get_priv(self)->battery_mock,
                INDICATOR_POWER_DEVICE_STATE, (gint)state,
@@ -179,6 +270,384 @@ on_mock_battery_minutes_left_changed(DbusTesting           * skeleton,
                NULL);
 }
 
+/***
+****  Named mock devices
+***/
+
+/* Creates or updates the named mock device. However much changed,
+   the mock provider emits devices-changed at most once, the way a
+   real provider reports one device refresh */
+static void
+update_mock_device (IndicatorPowerTesting * self,
+                    const char            * name,
+                    UpDeviceKind            kind,
+                    UpDeviceState           state,
+                    gdouble                 percentage,
+                    gint64                  seconds_left)
+{
+  priv_t * const p = get_priv(self);
+  IndicatorPowerDevice * device;
+  guint64 old_time = 0;
+  gboolean changed = FALSE;
+
+  percentage = CLAMP(percentage, 0.0, 100.0);
+  seconds_left = MAX(seconds_left, 0);
+
+  if ((device = g_hash_table_lookup(p->mock_devices, name)) == NULL)
+    {
+      gchar * path = g_strconcat(MOCK_DEVICE_PATH_PREFIX, name, NULL);
+      device = indicator_power_device_new(path,
+                                          kind,
+                                          0.0,
+                                          UP_DEVICE_STATE_UNKNOWN,
+                                          0,
+                                          (kind == UP_DEVICE_KIND_BATTERY) || (kind == UP_DEVICE_KIND_LINE_POWER));
+      g_free(path);
+
+      g_hash_table_insert(p->mock_devices, g_strdup(name), device);
+      indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(p->provider_mock), device);
+      changed = TRUE;
+    }
+
+  /* the mock provider emits on every property notify */
+  g_signal_handlers_block_by_func(device, indicator_power_device_provider_emit_devices_changed, p->provider_mock);
+
+  if (indicator_power_device_get_kind(device) != kind)
+    {
+      g_object_set(device, INDICATOR_POWER_DEVICE_KIND, (gint)kind, NULL);
+      changed = TRUE;
+    }
+
+  if (indicator_power_device_get_state(device) != state)
+    {
+      g_object_set(device, INDICATOR_POWER_DEVICE_STATE, (gint)state, NULL);
+      changed = TRUE;
+    }
+
+  if (indicator_power_device_get_percentage(device) != percentage)
+    {
+      g_object_set(device, INDICATOR_POWER_DEVICE_PERCENTAGE, percentage, NULL);
+      changed = TRUE;
+    }
+
+  /* the raw value: the getter fills in the estimator's guess for 0 */
+  g_object_get(device, INDICATOR_POWER_DEVICE_TIME, &old_time, NULL);
+  if (old_time != (guint64)seconds_left)
+    {
+      g_object_set(device, INDICATOR_POWER_DEVICE_TIME, (guint64)seconds_left, NULL);
+      changed = TRUE;
+    }
+
+  g_signal_handlers_unblock_by_func(device, indicator_power_device_provider_emit_devices_changed, p->provider_mock);
+
+  if (changed)
+    indicator_power_device_provider_emit_devices_changed(INDICATOR_POWER_DEVICE_PROVIDER(p->provider_mock));
+}
+
+static gboolean
+check_mock_device_args (GDBusMethodInvocation * invocation,
+                        guint32                 kind,
+                        guint32                 state)
+{
+  if ((kind < UP_DEVICE_KIND_LAST) && (state < UP_DEVICE_STATE_LAST))
+    return TRUE;
+
+  g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                        "Invalid device kind %u or state %u", kind, state);
+  return FALSE;
+}
+
+static gboolean
+on_handle_set_mock_device (DbusTesting           * skeleton,
+                           GDBusMethodInvocation * invocation,
+                           const gchar           * name,
+                           guint32                 kind,
+                           guint32                 state,
+                           gdouble                 percentage,
+                           gint64                  seconds_left,
+                           gpointer                gself)
+{
+  IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(gself);
+
+  if (check_mock_device_args(invocation, kind, state))
+    {
+      update_mock_device(self,
+                         name,
+                         (UpDeviceKind)kind,
+                         (UpDeviceState)state,
+                         percentage,
+                         seconds_left);
+
+      dbus_testing_complete_set_mock_device(skeleton, invocation);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+on_handle_remove_mock_device (DbusTesting           * skeleton,
+                              GDBusMethodInvocation * invocation,
+                              const gchar           * name,
+                              gpointer                gself)
+{
+  priv_t * const p = get_priv(INDICATOR_POWER_TESTING(gself));
+  IndicatorPowerDevice * device = g_hash_table_lookup(p->mock_devices, name);
+
+  if (device == NULL)
+    {
+      g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                            "No such mock device: '%s'", name);
+      return TRUE;
+    }
+
+  indicator_power_device_provider_remove_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(p->provider_mock), device);
+  g_hash_table_remove(p->mock_devices, name);
+  indicator_power_device_provider_emit_devices_changed(INDICATOR_POWER_DEVICE_PROVIDER(p->provider_mock));
+
+  dbus_testing_complete_remove_mock_device(skeleton, invocation);
+  return TRUE;
+}
+
+/***
+****  Scenarios
+***/
+
+static void schedule_scenario_tick (IndicatorPowerTesting * self);
+
+static gint
+compare_gint64 (gconstpointer ga, gconstpointer gb)
+{
+  const gint64 a = *(const gint64*)ga;
+  const gint64 b = *(const gint64*)gb;
+
+  return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/* apply_usec must be sorted */
+static gint64
+get_percentile (GArray * apply_usec, guint percent)
+{
+  if (apply_usec->len == 0)
+    return 0;
+
+  return g_array_index(apply_usec, gint64, (apply_usec->len - 1) * percent / 100);
+}
+
+static gint64
+get_update_due_time (const Scenario * scenario, gsize i)
+{
+  guint32 msec = 0;
+
+  g_variant_get_child(scenario->updates, i, "(usuudx)", &msec, NULL, NULL, NULL, NULL, NULL);
+
+  return scenario->start_time + (gint64)(msec * 1000.0 / scenario->speed);
+}
+
+static void
+scenario_free (Scenario * scenario)
+{
+  g_variant_unref(scenario->updates);
+  g_array_free(scenario->apply_usec, TRUE);
+  g_free(scenario);
+}
+
+/* unhooks the scenario from the provider and its main loop source */
+static Scenario *
+steal_scenario (IndicatorPowerTesting * self)
+{
+  priv_t * const p = get_priv(self);
+  Scenario * scenario = p->scenario;
+
+  if (scenario != NULL)
+    {
+      if (scenario->source_id != 0)
+        g_source_remove(scenario->source_id);
+
+      g_signal_handler_disconnect(p->provider_mock, scenario->rebuild_tag);
+
+      p->scenario = NULL;
+    }
+
+  return scenario;
+}
+
+static void
+finish_scenario (IndicatorPowerTesting * self)
+{
+  Scenario * scenario = steal_scenario(self);
+  GArray * apply_usec = scenario->apply_usec;
+  GVariantBuilder b;
+  gint64 total = 0;
+  guint i;
+
+  for (i=0; i<apply_usec->len; ++i)
+    total += g_array_index(apply_usec, gint64, i);
+  g_array_sort(apply_usec, compare_gint64);
+
+  g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add(&b, "{sv}", "updates", g_variant_new_uint32(apply_usec->len));
+  g_variant_builder_add(&b, "{sv}", "rebuilds", g_variant_new_uint32(scenario->n_rebuilds));
+  g_variant_builder_add(&b, "{sv}", "elapsed-usec", g_variant_new_int64(g_get_monotonic_time() - scenario->start_time));
+  g_variant_builder_add(&b, "{sv}", "apply-usec-total", g_variant_new_int64(total));
+  g_variant_builder_add(&b, "{sv}", "apply-usec-max", g_variant_new_int64(get_percentile(apply_usec, 100)));
+  g_variant_builder_add(&b, "{sv}", "apply-usec-p50", g_variant_new_int64(get_percentile(apply_usec, 50)));
+  g_variant_builder_add(&b, "{sv}", "apply-usec-p95", g_variant_new_int64(get_percentile(apply_usec, 95)));
+  g_variant_builder_add(&b, "{sv}", "apply-usec-p99", g_variant_new_int64(get_percentile(apply_usec, 99)));
+  g_variant_builder_add(&b, "{sv}", "lag-usec-max", g_variant_new_int64(scenario->max_lag_usec));
+
+  g_debug("scenario: %u updates, %u rebuilds, %.1f ms applying",
+          apply_usec->len, scenario->n_rebuilds, total / 1000.0);
+
+  dbus_testing_complete_run_scenario(get_priv(self)->skeleton,
+                                     scenario->invocation,
+                                     g_variant_builder_end(&b));
+  scenario_free(scenario);
+}
+
+static void
+apply_scenario_update (IndicatorPowerTesting * self, gsize i)
+{
+  Scenario * const scenario = get_priv(self)->scenario;
+  guint32 msec;
+  const char * name;
+  guint32 kind;
+  guint32 state;
+  gdouble percentage;
+  gint64 seconds_left;
+  gint64 begin;
+  gint64 elapsed;
+
+  g_variant_get_child(scenario->updates, i, "(u&suudx)",
+                      &msec, &name, &kind, &state, &percentage, &seconds_left);
+
+  begin = g_get_monotonic_time();
+
+  if (scenario->speed > 0)
+    scenario->max_lag_usec = MAX(scenario->max_lag_usec, begin - get_update_due_time(scenario, i));
+
+  update_mock_device(self,
+                     name,
+                     (UpDeviceKind)kind,
+                     (UpDeviceState)state,
+                     percentage,
+                     seconds_left);
+
+  elapsed = g_get_monotonic_time() - begin;
+  g_array_append_val(scenario->apply_usec, elapsed);
+}
+
+static gboolean
+on_scenario_tick (gpointer gself)
+{
+  IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(gself);
+  Scenario * const scenario = get_priv(self)->scenario;
+
+  scenario->source_id = 0;
+
+  if (scenario->speed > 0)
+    {
+      const gint64 now = g_get_monotonic_time();
+
+      while ((scenario->next < scenario->n_updates) &&
+             (get_update_due_time(scenario, scenario->next) <= now))
+        apply_scenario_update(self, scenario->next++);
+    }
+  else
+    {
+      apply_scenario_update(self, scenario->next++);
+    }
+
+  if (scenario->next < scenario->n_updates)
+    schedule_scenario_tick(self);
+  else
+    finish_scenario(self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* As fast as possible means one update per main loop iteration,
+   so that the menus' D-Bus exports still get to run in between */
+static void
+schedule_scenario_tick (IndicatorPowerTesting * self)
+{
+  Scenario * const scenario = get_priv(self)->scenario;
+
+  if (scenario->speed > 0)
+    {
+      const gint64 wait_usec = get_update_due_time(scenario, scenario->next) - g_get_monotonic_time();
+
+      scenario->source_id = g_timeout_add((guint)(MAX(wait_usec, 0) / 1000), on_scenario_tick, self);
+    }
+  else
+    {
+      scenario->source_id = g_idle_add(on_scenario_tick, self);
+    }
+}
+
+static void
+on_scenario_rebuild (IndicatorPowerTesting * self)
+{
+  get_priv(self)->scenario->n_rebuilds++;
+}
+
+static gboolean
+on_handle_run_scenario (DbusTesting           * skeleton,
+                        GDBusMethodInvocation * invocation,
+                        GVariant              * updates,
+                        gdouble                 speed,
+                        gpointer                gself)
+{
+  IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(gself);
+  priv_t * const p = get_priv(self);
+  Scenario * scenario;
+  GVariantIter iter;
+  guint32 kind;
+  guint32 state;
+
+  if (p->scenario != NULL)
+    {
+      g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                            "A scenario is already running");
+      return TRUE;
+    }
+
+  if (!dbus_testing_get_mock_battery_enabled(skeleton))
+    {
+      g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                            "The mock battery isn't enabled");
+      return TRUE;
+    }
+
+  g_variant_iter_init(&iter, updates);
+  while (g_variant_iter_next(&iter, "(u&suudx)", NULL, NULL, &kind, &state, NULL, NULL))
+    if (!check_mock_device_args(invocation, kind, state))
+      return TRUE;
+
+  scenario = g_new0(Scenario, 1);
+  scenario->invocation = invocation; /* completing it frees it */
+  scenario->updates = g_variant_ref(updates);
+  scenario->n_updates = g_variant_n_children(updates);
+  scenario->speed = MAX(speed, 0.0);
+  scenario->start_time = g_get_monotonic_time();
+  scenario->apply_usec = g_array_sized_new(FALSE, FALSE, sizeof(gint64), (guint)scenario->n_updates);
+  scenario->rebuild_tag = g_signal_connect_swapped(p->provider_mock,
+                                                   "devices-changed",
+                                                   G_CALLBACK(on_scenario_rebuild),
+                                                   self);
+  p->scenario = scenario;
+
+  if (scenario->n_updates > 0)
+    schedule_scenario_tick(self);
+  else
+    finish_scenario(self);
+
+  return TRUE;
+}
+
+/***
+****
+***/
+
 static void
 on_bus_changed(IndicatorPowerService * service,
                GParamSpec            * spec     G_GNUC_UNUSED,
@@ -241,11 +710,20 @@ my_dispose(GObject * o)
   IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(o);
   priv_t * const p = get_priv (self);
 
+  if (p->scenario != NULL)
+    {
+      Scenario * scenario = steal_scenario(self);
+      g_dbus_method_invocation_return_error(scenario->invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                            "The service is shutting down");
+      scenario_free(scenario);
+    }
+
   set_bus(self, NULL);
   g_clear_object(&p->skeleton);
-  g_clear_object(&p->provider_upower);
+  g_clear_object(&p->provider_real);
   g_clear_object(&p->provider_mock);
   g_clear_object(&p->battery_mock);
+  g_clear_pointer(&p->mock_devices, g_hash_table_destroy);
   g_clear_object(&p->service);
 
   G_OBJECT_CLASS (indicator_power_testing_parent_class)->dispose(o);
@@ -294,6 +772,12 @@ indicator_power_testing_init (IndicatorPowerTesting * self)
                    G_CALLBACK(on_mock_battery_state_changed), self);
   g_signal_connect(p->skeleton, "notify::mock-battery-minutes-left",
                    G_CALLBACK(on_mock_battery_minutes_left_changed), self);
+  g_signal_connect(p->skeleton, "handle-set-mock-device",
+                   G_CALLBACK(on_handle_set_mock_device), self);
+  g_signal_connect(p->skeleton, "handle-remove-mock-device",
+                   G_CALLBACK(on_handle_remove_mock_device), self);
+  g_signal_connect(p->skeleton, "handle-run-scenario",
+                   G_CALLBACK(on_handle_run_scenario), self);
 
   /* Mock Battery */
   
@@ -304,6 +788,7 @@ indicator_power_testing_init (IndicatorPowerTesting * self)
                                                60*30,
                                                TRUE);
 
+  p->mock_devices = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
 
   /* Mock Provider */
 
@@ -312,9 +797,9 @@ indicator_power_testing_init (IndicatorPowerTesting * self)
   indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(p->provider_mock),
                                              p->battery_mock);
 
-  /* UPower Provider */
+  /* Real Provider */
 
-  p->provider_upower = indicator_power_device_provider_upower_new();
+  p->provider_real = create_real_provider();
 }
 
 static void
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "uevent.h"
+
+#include <string.h> /* memcmp(), memset() */
+
+G_STATIC_ASSERT (INDICATOR_POWER_UEVENT_N_KEYS <= 32); /* IndicatorPowerUevent.seen */
+
+#define SLICE_EQUALS(str, len, literal) \
+  (((len) == sizeof(literal) - 1) && !memcmp ((str), (literal), sizeof(literal) - 1))
+
+#define SLICE_HAS_PREFIX(str, len, literal) \
+  (((len) >= sizeof(literal) - 1) && !memcmp ((str), (literal), sizeof(literal) - 1))
+
+/***
+****  Key table
+***/
+
+typedef struct
+{
+  const char * str;
+  gsize len;
+  IndicatorPowerUeventKey key;
+}
+KeyEntry;
+
+#define KEY(str, key) { str, sizeof(str) - 1, INDICATOR_POWER_UEVENT_##key }
+
+static const KeyEntry generic_keys[] =
+{
+  KEY ("ACTION", ACTION),
+  KEY ("DEVPATH", DEVPATH),
+  KEY ("SUBSYSTEM", SUBSYSTEM)
+};
+
+#define POWER_SUPPLY_PREFIX "POWER_SUPPLY_"
+#define POWER_SUPPLY_PREFIX_LEN (sizeof(POWER_SUPPLY_PREFIX) - 1)
+
+/* keys that start with POWER_SUPPLY_, without the prefix */
+static const KeyEntry power_supply_keys[] =
+{
+  KEY ("NAME", NAME),
+  KEY ("TYPE", TYPE),
+  KEY ("STATUS", STATUS),
+  KEY ("SCOPE", SCOPE),
+  KEY ("PRESENT", PRESENT),
+  KEY ("CAPACITY", CAPACITY),
+  KEY ("ENERGY_NOW", ENERGY_NOW),
+  KEY ("ENERGY_FULL", ENERGY_FULL),
+  KEY ("ENERGY_FULL_DESIGN", ENERGY_FULL_DESIGN),
+  KEY ("CHARGE_NOW", CHARGE_NOW),
+  KEY ("CHARGE_FULL", CHARGE_FULL),
+  KEY ("CHARGE_FULL_DESIGN", CHARGE_FULL_DESIGN),
+  KEY ("POWER_NOW", POWER_NOW),
+  KEY ("CURRENT_NOW", CURRENT_NOW),
+  KEY ("VOLTAGE_NOW", VOLTAGE_NOW),
+  KEY ("TEMP", TEMP),
+  KEY ("TIME_TO_EMPTY_NOW", TIME_TO_EMPTY_NOW),
+  KEY ("TIME_TO_FULL_NOW", TIME_TO_FULL_NOW)
+};
+
+#undef KEY
+
+static IndicatorPowerUeventKey
+find_key (const KeyEntry * table, gsize n, const char * str, gsize len)
+{
+  gsize i;
+
+  for (i=0; i<n; ++i)
+    if ((table[i].len == len) && !memcmp (table[i].str, str, len))
+      return table[i].key;
+
+  return INDICATOR_POWER_UEVENT_N_KEYS;
+}
+
+static IndicatorPowerUeventKey
+lookup_key (const char * str, gsize len)
+{
+  if ((len > POWER_SUPPLY_PREFIX_LEN) && SLICE_HAS_PREFIX (str, len, POWER_SUPPLY_PREFIX))
+    return find_key (power_supply_keys, G_N_ELEMENTS(power_supply_keys),
+                     str + POWER_SUPPLY_PREFIX_LEN, len - POWER_SUPPLY_PREFIX_LEN);
+
+  return find_key (generic_keys, G_N_ELEMENTS(generic_keys), str, len);
+}
+
+/***
+****  Values
+***/
+
+static gboolean
+parse_int (const char * str, gsize len, gint64 * setme)
+{
+  const char * const end = str + len;
+  gboolean negative = FALSE;
+  guint64 val = 0;
+
+  if ((str < end) && ((*str == '-') || (*str == '+')))
+    negative = *str++ == '-';
+
+  if (str == end)
+    return FALSE;
+
+  for (; str<end; ++str)
+    {
+      const guint digit = (guint)(*str - '0');
+
+      if (digit > 9)
+        return FALSE;
+
+      if (val > (G_MAXINT64 - digit) / 10)
+        return FALSE;
+
+      val = (val * 10) + digit;
+    }
+
+  *setme = negative ? -(gint64)val : (gint64)val;
+  return TRUE;
+}
+
+static UpDeviceState
+parse_status (const char * str, gsize len)
+{
+  if (SLICE_EQUALS (str, len, "Charging"))
+    return UP_DEVICE_STATE_CHARGING;
+
+  if (SLICE_EQUALS (str, len, "Discharging"))
+    return UP_DEVICE_STATE_DISCHARGING;
+
+  if (SLICE_EQUALS (str, len, "Full"))
+    return UP_DEVICE_STATE_FULLY_CHARGED;
+
+  /* plugged in, but charging is inhibited or the battery's above its threshold */
+  if (SLICE_EQUALS (str, len, "Not charging"))
+    return UP_DEVICE_STATE_PENDING_CHARGE;
+
+  return UP_DEVICE_STATE_UNKNOWN;
+}
+
+static void
+set_value (IndicatorPowerUevent    * uevent,
+           IndicatorPowerUeventKey   key,
+           const char              * str,
+           gsize                     len)
+{
+  switch (key)
+    {
+      case INDICATOR_POWER_UEVENT_N_KEYS:
+        return;
+
+      case INDICATOR_POWER_UEVENT_ACTION:
+        uevent->action = str;
+        break;
+
+      case INDICATOR_POWER_UEVENT_DEVPATH:
+        uevent->devpath = str;
+        break;
+
+      case INDICATOR_POWER_UEVENT_SUBSYSTEM:
+        uevent->subsystem = str;
+        break;
+
+      case INDICATOR_POWER_UEVENT_NAME:
+        uevent->name = str;
+        break;
+
+      case INDICATOR_POWER_UEVENT_TYPE:
+        uevent->kind = indicator_power_uevent_parse_type (str, len);
+        break;
+
+      case INDICATOR_POWER_UEVENT_STATUS:
+        uevent->state = parse_status (str, len);
+        break;
+
+      case INDICATOR_POWER_UEVENT_SCOPE:
+        uevent->device_scope = SLICE_EQUALS (str, len, "Device");
+        break;
+
+      default:
+        if (!parse_int (str, len, &uevent->values[key]))
+          return;
+        break;
+    }
+
+  uevent->seen |= (guint32)1 << key;
+}
+
+/***
+****  Public API
+***/
+
+void
+indicator_power_uevent_parse (IndicatorPowerUevent * uevent,
+                              char                 * buf,
+                              gsize                  len,
+                              char                   separator)
+{
+  char * p = buf;
+  char * const end = buf + len;
+
+  memset (uevent, 0, sizeof(IndicatorPowerUevent));
+  *end = '\0';
+
+  while (p < end)
+    {
+      const char * const key = p;
+      const char * val;
+      gsize key_len;
+
+      while ((p < end) && (*p != '=') && (*p != separator))
+        ++p;
+
+      /* no '=', e.g. netlink's ACTION@DEVPATH header */
+      if ((p == end) || (*p == separator))
+        {
+          *p++ = '\0';
+          continue;
+        }
+
+      key_len = (gsize)(p - key);
+      val = ++p;
+
+      while ((p < end) && (*p != separator))
+        ++p;
+
+      *p = '\0';
+      set_value (uevent, lookup_key (key, key_len), val, (gsize)(p - val));
+      ++p;
+    }
+}
+
+gboolean
+indicator_power_uevent_has (const IndicatorPowerUevent * uevent,
+                            IndicatorPowerUeventKey      key)
+{
+  g_return_val_if_fail (key < INDICATOR_POWER_UEVENT_N_KEYS, FALSE);
+
+  return (uevent->seen & ((guint32)1 << key)) != 0;
+}
+
+gboolean
+indicator_power_uevent_get_int (const IndicatorPowerUevent * uevent,
+                                IndicatorPowerUeventKey      key,
+                                gint64                     * setme)
+{
+  if (!indicator_power_uevent_has (uevent, key))
+    return FALSE;
+
+  *setme = uevent->values[key];
+  return TRUE;
+}
+
+UpDeviceKind
+indicator_power_uevent_parse_type (const char * type,
+                                   gsize        len)
+{
+  if (SLICE_EQUALS (type, len, "Battery"))
+    return UP_DEVICE_KIND_BATTERY;
+
+  if (SLICE_EQUALS (type, len, "UPS"))
+    return UP_DEVICE_KIND_UPS;
+
+  if (SLICE_EQUALS (type, len, "Mains") || SLICE_HAS_PREFIX (type, len, "USB"))
+    return UP_DEVICE_KIND_LINE_POWER;
+
+  return UP_DEVICE_KIND_UNKNOWN;
+}
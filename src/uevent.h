@@ -0,0 +1,105 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDICATOR_POWER_UEVENT__H
+#define INDICATOR_POWER_UEVENT__H
+
+#include <glib.h>
+
+#include "device.h"
+
+G_BEGIN_DECLS
+
+/* The keys we care about. Anything else in a uevent is skipped. */
+typedef enum
+{
+  INDICATOR_POWER_UEVENT_ACTION,
+  INDICATOR_POWER_UEVENT_DEVPATH,
+  INDICATOR_POWER_UEVENT_SUBSYSTEM,
+  INDICATOR_POWER_UEVENT_NAME,
+  INDICATOR_POWER_UEVENT_TYPE,
+  INDICATOR_POWER_UEVENT_STATUS,
+  INDICATOR_POWER_UEVENT_SCOPE,
+
+  /* integers, in sysfs units: uWh, uAh, uW, uA, uV, tenths of a degree, seconds */
+  INDICATOR_POWER_UEVENT_PRESENT,
+  INDICATOR_POWER_UEVENT_CAPACITY,
+  INDICATOR_POWER_UEVENT_ENERGY_NOW,
+  INDICATOR_POWER_UEVENT_ENERGY_FULL,
+  INDICATOR_POWER_UEVENT_ENERGY_FULL_DESIGN,
+  INDICATOR_POWER_UEVENT_CHARGE_NOW,
+  INDICATOR_POWER_UEVENT_CHARGE_FULL,
+  INDICATOR_POWER_UEVENT_CHARGE_FULL_DESIGN,
+  INDICATOR_POWER_UEVENT_POWER_NOW,
+  INDICATOR_POWER_UEVENT_CURRENT_NOW,
+  INDICATOR_POWER_UEVENT_VOLTAGE_NOW,
+  INDICATOR_POWER_UEVENT_TEMP,
+  INDICATOR_POWER_UEVENT_TIME_TO_EMPTY_NOW,
+  INDICATOR_POWER_UEVENT_TIME_TO_FULL_NOW,
+
+  INDICATOR_POWER_UEVENT_N_KEYS
+}
+IndicatorPowerUeventKey;
+
+/**
+ * A parsed power_supply uevent.
+ *
+ * The parser makes a single pass over the buffer and works in place:
+ * it NUL-terminates the values where they lie, so the strings here
+ * point into the parsed buffer and nothing is allocated. TYPE, STATUS
+ * and SCOPE are decoded straight into the device's enums, and the
+ * numeric keys straight into integers.
+ */
+typedef struct
+{
+  /* bit N is set if key N was present and well-formed */
+  guint32 seen;
+
+  const char * action;
+  const char * devpath;
+  const char * subsystem;
+  const char * name;
+
+  UpDeviceKind kind;
+  UpDeviceState state;
+  gboolean device_scope;
+
+  gint64 values[INDICATOR_POWER_UEVENT_N_KEYS];
+}
+IndicatorPowerUevent;
+
+/* Parses KEY=VALUE pairs split by separator: '\n' for the uevent
+   attribute file, '\0' for netlink messages. buf[len] must be
+   writable, e.g. the NUL that g_file_get_contents() appends. */
+void         indicator_power_uevent_parse     (IndicatorPowerUevent       * uevent,
+                                               char                       * buf,
+                                               gsize                        len,
+                                               char                         separator);
+
+gboolean     indicator_power_uevent_has       (const IndicatorPowerUevent * uevent,
+                                               IndicatorPowerUeventKey      key);
+
+gboolean     indicator_power_uevent_get_int   (const IndicatorPowerUevent * uevent,
+                                               IndicatorPowerUeventKey      key,
+                                               gint64                     * setme);
+
+/* maps a POWER_SUPPLY_TYPE value, e.g. from the "type" attribute file */
+UpDeviceKind indicator_power_uevent_parse_type (const char * type,
+                                                gsize        len);
+
+G_END_DECLS
+
+#endif /* INDICATOR_POWER_UEVENT__H */
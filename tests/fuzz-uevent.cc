@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A libFuzzer target for the uevent parser. Build it with
+   -DENABLE_FUZZING=ON using clang, then run e.g.
+     ./tests/fuzz-uevent -max_total_time=300 */
+
+#include "uevent.h"
+
+#include <glib.h>
+
+#include <cstdint>
+#include <cstring>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+static void
+check_string(const char * str, const char * buf, size_t size)
+{
+  if (str != nullptr)
+    g_assert_true((str >= buf) && (str + strlen(str) <= buf + size));
+}
+
+extern "C" int
+LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  // both separators, in an exactly-sized buffer so ASan sees any overrun
+  for (const auto separator : { '\0', '\n' })
+    {
+      auto buf = static_cast<char*>(g_malloc(size + 1));
+      memcpy(buf, data, size);
+
+      IndicatorPowerUevent uevent;
+      indicator_power_uevent_parse(&uevent, buf, size, separator);
+
+      check_string(uevent.action, buf, size);
+      check_string(uevent.devpath, buf, size);
+      check_string(uevent.subsystem, buf, size);
+      check_string(uevent.name, buf, size);
+
+      g_free(buf);
+    }
+
+  return 0;
+}
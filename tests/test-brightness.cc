@@ -0,0 +1,841 @@
+/*
+ * Copyright 2014 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "brightness.h"
+#include "brightness-backend-sysfs.h"
+#include "brightness-curve.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <cstdio>
+#include <cstdlib> // abs()
+#include <string>
+#include <vector>
+
+/***
+****  A backend that records what's written to it
+***/
+
+namespace
+{
+  struct RecordedWrite
+  {
+    gint64 time;
+    int brightness;
+  };
+
+  struct RecordingBackend
+  {
+    GObject parent;
+    int brightness;
+    int max;
+    std::vector<RecordedWrite> * writes;
+  };
+
+  struct RecordingBackendClass
+  {
+    GObjectClass parent_class;
+  };
+
+  GType recording_backend_get_type(void);
+  void recording_backend_iface_init(IndicatorPowerBrightnessBackendInterface * iface);
+
+  G_DEFINE_TYPE_WITH_CODE(RecordingBackend,
+                          recording_backend,
+                          G_TYPE_OBJECT,
+                          G_IMPLEMENT_INTERFACE(INDICATOR_TYPE_POWER_BRIGHTNESS_BACKEND,
+                                                recording_backend_iface_init))
+
+  RecordingBackend * RECORDING_BACKEND(gpointer o)
+  {
+    return G_TYPE_CHECK_INSTANCE_CAST(o, recording_backend_get_type(), RecordingBackend);
+  }
+
+  gboolean recording_backend_get_range(IndicatorPowerBrightnessBackend * b, int * min, int * max)
+  {
+    *min = 0;
+    *max = RECORDING_BACKEND(b)->max;
+    return TRUE;
+  }
+
+  int recording_backend_get_brightness(IndicatorPowerBrightnessBackend * b)
+  {
+    return RECORDING_BACKEND(b)->brightness;
+  }
+
+  void recording_backend_set_brightness(IndicatorPowerBrightnessBackend * b, int brightness)
+  {
+    auto self = RECORDING_BACKEND(b);
+    self->brightness = brightness;
+    self->writes->push_back(RecordedWrite{g_get_monotonic_time(), brightness});
+  }
+
+  void recording_backend_iface_init(IndicatorPowerBrightnessBackendInterface * iface)
+  {
+    iface->get_range = recording_backend_get_range;
+    iface->get_brightness = recording_backend_get_brightness;
+    iface->set_brightness = recording_backend_set_brightness;
+  }
+
+  void recording_backend_finalize(GObject * o)
+  {
+    delete RECORDING_BACKEND(o)->writes;
+    G_OBJECT_CLASS(recording_backend_parent_class)->finalize(o);
+  }
+
+  void recording_backend_class_init(RecordingBackendClass * klass)
+  {
+    G_OBJECT_CLASS(klass)->finalize = recording_backend_finalize;
+  }
+
+  void recording_backend_init(RecordingBackend * self)
+  {
+    self->writes = new std::vector<RecordedWrite>();
+  }
+
+  RecordingBackend * recording_backend_new(int max, int brightness)
+  {
+    auto self = RECORDING_BACKEND(g_object_new(recording_backend_get_type(), nullptr));
+    self->max = max;
+    self->brightness = brightness;
+    return self;
+  }
+}
+
+/***
+****
+***/
+
+class BrightnessFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * sysfs_dir = nullptr;
+
+  void SetUp()
+  {
+    // use our own schema, with settings that don't touch the real config
+    g_setenv("GSETTINGS_SCHEMA_DIR", SCHEMA_DIR, TRUE);
+    g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+
+    super::SetUp();
+
+    sysfs_dir = g_dir_make_tmp("indicator-power-backlight-XXXXXX", nullptr);
+    ASSERT_NE(nullptr, sysfs_dir);
+  }
+
+  virtual void TearDown()
+  {
+    remove_tree(sysfs_dir);
+    g_clear_pointer(&sysfs_dir, g_free);
+
+    super::TearDown();
+  }
+
+  static void remove_tree(const char * path)
+  {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR))
+      {
+        auto dir = g_dir_open(path, 0, nullptr);
+        const char * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+
+    g_remove(path);
+  }
+
+  void write_attr(const char * backlight, const char * attr, const std::string& value)
+  {
+    auto dir = g_build_filename(sysfs_dir, backlight, nullptr);
+    g_mkdir_with_parents(dir, 0700);
+    auto path = g_build_filename(dir, attr, nullptr);
+
+    // write in place, the way the kernel changes sysfs attributes
+    auto fp = fopen(path, "w");
+    ASSERT_NE(nullptr, fp);
+    fputs(value.c_str(), fp);
+    fclose(fp);
+
+    g_free(path);
+    g_free(dir);
+  }
+
+  int read_attr(const char * backlight, const char * attr)
+  {
+    auto path = g_build_filename(sysfs_dir, backlight, attr, nullptr);
+    gchar * contents = nullptr;
+    int ret = -1;
+    if (g_file_get_contents(path, &contents, nullptr, nullptr))
+      ret = atoi(contents);
+    g_free(contents);
+    g_free(path);
+    return ret;
+  }
+
+  void add_backlight(const char * name, const char * type, int max, int brightness, bool with_actual=true)
+  {
+    write_attr(name, "type", std::string(type) + "\n");
+    write_attr(name, "max_brightness", std::to_string(max) + "\n");
+    write_attr(name, "brightness", std::to_string(brightness) + "\n");
+    if (with_actual)
+      write_attr(name, "actual_brightness", std::to_string(brightness) + "\n");
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(BrightnessFixture, NoBacklight)
+{
+  EXPECT_EQ(nullptr, indicator_power_brightness_backend_sysfs_new(sysfs_dir, FALSE));
+}
+
+TEST_F(BrightnessFixture, PicksBestBacklight)
+{
+  add_backlight("intel_backlight", "raw", 120000, 60000);
+  add_backlight("acpi_video0", "firmware", 100, 50);
+  add_backlight("broken", "firmware", 0, 0);
+
+  auto backend = indicator_power_brightness_backend_sysfs_new(sysfs_dir, FALSE);
+  ASSERT_NE(nullptr, backend);
+  EXPECT_STREQ("acpi_video0", indicator_power_brightness_backend_sysfs_get_name(INDICATOR_POWER_BRIGHTNESS_BACKEND_SYSFS(backend)));
+
+  int lo = -1;
+  int hi = -1;
+  EXPECT_TRUE(indicator_power_brightness_backend_get_range(backend, &lo, &hi));
+  EXPECT_EQ(0, lo);
+  EXPECT_EQ(100, hi);
+  EXPECT_EQ(50, indicator_power_brightness_backend_get_brightness(backend));
+
+  g_object_unref(backend);
+}
+
+TEST_F(BrightnessFixture, ExternalChange)
+{
+  add_backlight("intel_backlight", "raw", 1000, 500);
+
+  auto backend = indicator_power_brightness_backend_sysfs_new(sysfs_dir, FALSE);
+  ASSERT_NE(nullptr, backend);
+
+  // someone else changes the brightness...
+  write_attr("intel_backlight", "actual_brightness", "250\n");
+  wait_for_signal(backend, "changed");
+
+  // ...and the backend notices
+  EXPECT_EQ(250, indicator_power_brightness_backend_get_brightness(backend));
+
+  g_object_unref(backend);
+}
+
+TEST_F(BrightnessFixture, PercentageWritesBacklight)
+{
+  // no actual_brightness, so the fake's brightness reads back what we write
+  add_backlight("intel_backlight", "raw", 1000, 500, false);
+
+  auto backend = indicator_power_brightness_backend_sysfs_new(sysfs_dir, FALSE);
+  ASSERT_NE(nullptr, backend);
+  auto brightness = indicator_power_brightness_new_with_backend(backend);
+  EXPECT_DOUBLE_EQ(0.5, indicator_power_brightness_get_percentage(brightness));
+
+  // the slider moves right away; the backlight gets there after the ramp
+  indicator_power_brightness_set_percentage(brightness, 0.75);
+  EXPECT_DOUBLE_EQ(0.75, indicator_power_brightness_get_percentage(brightness));
+  wait_msec(500);
+  EXPECT_EQ(750, read_attr("intel_backlight", "brightness"));
+  EXPECT_DOUBLE_EQ(0.75, indicator_power_brightness_get_percentage(brightness));
+
+  // changes from outside show up as the new percentage
+  write_attr("intel_backlight", "brightness", "100\n");
+  wait_for_signal(brightness, "notify::percentage");
+  EXPECT_DOUBLE_EQ(0.1, indicator_power_brightness_get_percentage(brightness));
+
+  g_object_unref(brightness);
+  g_object_unref(backend);
+}
+
+/***
+****  Brightness curves
+***/
+
+namespace
+{
+  const IndicatorPowerBrightnessCurveType all_curve_types[] = {
+    INDICATOR_POWER_BRIGHTNESS_CURVE_LINEAR,
+    INDICATOR_POWER_BRIGHTNESS_CURVE_GAMMA,
+    INDICATOR_POWER_BRIGHTNESS_CURVE_CIE_LIGHTNESS
+  };
+}
+
+TEST_F(BrightnessFixture, CurveEndpoints)
+{
+  for (const auto type : all_curve_types)
+    {
+      auto curve = indicator_power_brightness_curve_new(type, 2.2, 10, 4000);
+      EXPECT_DOUBLE_EQ(0.0, indicator_power_brightness_curve_to_percentage(curve, 10));
+      EXPECT_DOUBLE_EQ(1.0, indicator_power_brightness_curve_to_percentage(curve, 4000));
+      EXPECT_EQ(10, indicator_power_brightness_curve_to_brightness(curve, 0.0));
+      EXPECT_EQ(4000, indicator_power_brightness_curve_to_brightness(curve, 1.0));
+      indicator_power_brightness_curve_free(curve);
+    }
+}
+
+TEST_F(BrightnessFixture, CurveIsMonotonic)
+{
+  for (const auto type : all_curve_types)
+    {
+      auto curve = indicator_power_brightness_curve_new(type, 2.2, 0, 120000);
+      int prev = indicator_power_brightness_curve_to_brightness(curve, 0.0);
+      for (int i=1; i<=1000; ++i)
+        {
+          const int b = indicator_power_brightness_curve_to_brightness(curve, i/1000.0);
+          EXPECT_LE(prev, b);
+          prev = b;
+        }
+      indicator_power_brightness_curve_free(curve);
+    }
+}
+
+TEST_F(BrightnessFixture, CurveIsPerceptual)
+{
+  // the bottom half of a perceptual slider covers far less than half of the raw range
+  auto curve = indicator_power_brightness_curve_new(INDICATOR_POWER_BRIGHTNESS_CURVE_CIE_LIGHTNESS, 0, 0, 4096);
+  EXPECT_LT(indicator_power_brightness_curve_to_brightness(curve, 0.5), 4096/4);
+  indicator_power_brightness_curve_free(curve);
+
+  curve = indicator_power_brightness_curve_new(INDICATOR_POWER_BRIGHTNESS_CURVE_LINEAR, 0, 0, 4096);
+  EXPECT_EQ(2048, indicator_power_brightness_curve_to_brightness(curve, 0.5));
+  indicator_power_brightness_curve_free(curve);
+}
+
+TEST_F(BrightnessFixture, CurveRoundTrip)
+{
+  // when the table has an entry for every raw level,
+  // brightness -> percentage -> brightness is lossless
+  for (const auto type : all_curve_types)
+    {
+      for (const int max : { 7, 255, 4096 })
+        {
+          auto curve = indicator_power_brightness_curve_new(type, 2.2, 0, max);
+          for (int b=0; b<=max; ++b)
+            {
+              const double pct = indicator_power_brightness_curve_to_percentage(curve, b);
+              EXPECT_EQ(b, indicator_power_brightness_curve_to_brightness(curve, pct));
+            }
+          indicator_power_brightness_curve_free(curve);
+        }
+    }
+
+  // bigger ranges are interpolated; they may be off by a level, but no more,
+  // and repeated round trips don't drift
+  for (const auto type : all_curve_types)
+    {
+      auto curve = indicator_power_brightness_curve_new(type, 2.2, 0, 120000);
+      for (int b=0; b<=120000; b+=7)
+        {
+          const double pct = indicator_power_brightness_curve_to_percentage(curve, b);
+          const int b2 = indicator_power_brightness_curve_to_brightness(curve, pct);
+          EXPECT_LE(abs(b - b2), 1);
+          const double pct2 = indicator_power_brightness_curve_to_percentage(curve, b2);
+          EXPECT_EQ(b2, indicator_power_brightness_curve_to_brightness(curve, pct2));
+        }
+      indicator_power_brightness_curve_free(curve);
+    }
+}
+
+/***
+****  Ramping
+***/
+
+TEST_F(BrightnessFixture, RampIsPacedAndEndsOnTarget)
+{
+  auto settings = g_settings_new("org.ayatana.indicator.power");
+  g_settings_set_uint(settings, "brightness-ramp-duration", 300);
+  g_settings_set_uint(settings, "brightness-ramp-rate", 20);
+
+  auto backend = recording_backend_new(1000, 0);
+  auto brightness = indicator_power_brightness_new_with_backend(INDICATOR_POWER_BRIGHTNESS_BACKEND(backend));
+  auto& writes = *backend->writes;
+
+  // the first write after startup jumps, since we don't know where the backlight was
+  indicator_power_brightness_set_percentage(brightness, 0.1);
+  ASSERT_EQ(1u, writes.size());
+  EXPECT_EQ(100, writes.back().brightness);
+  writes.clear();
+
+  // after that, we ramp
+  indicator_power_brightness_set_percentage(brightness, 1.0);
+  EXPECT_DOUBLE_EQ(1.0, indicator_power_brightness_get_percentage(brightness));
+  EXPECT_TRUE(writes.empty());
+  wait_msec(600);
+
+  // confirm the ramp went up in steps, ended on the target,
+  // and didn't write more than 20 times per second
+  ASSERT_GT(writes.size(), 2u);
+  EXPECT_LE(writes.size(), 8u);
+  EXPECT_EQ(1000, writes.back().brightness);
+  for (size_t i=1; i<writes.size(); ++i)
+    {
+      EXPECT_LT(writes[i-1].brightness, writes[i].brightness);
+      EXPECT_GE(writes[i].time - writes[i-1].time, 40000); // usec
+    }
+
+  g_object_unref(brightness);
+  g_object_unref(backend);
+  g_settings_reset(settings, "brightness-ramp-duration");
+  g_settings_reset(settings, "brightness-ramp-rate");
+  g_object_unref(settings);
+}
+
+TEST_F(BrightnessFixture, NewTargetRetargetsRamp)
+{
+  auto settings = g_settings_new("org.ayatana.indicator.power");
+  g_settings_set_uint(settings, "brightness-ramp-duration", 400);
+
+  auto backend = recording_backend_new(1000, 0);
+  auto brightness = indicator_power_brightness_new_with_backend(INDICATOR_POWER_BRIGHTNESS_BACKEND(backend));
+  auto& writes = *backend->writes;
+
+  indicator_power_brightness_set_percentage(brightness, 0.5);
+  writes.clear();
+
+  // start ramping up, then change our mind partway through...
+  indicator_power_brightness_set_percentage(brightness, 1.0);
+  wait_msec(150);
+  ASSERT_FALSE(writes.empty());
+  const auto turnaround = writes.back().brightness;
+  EXPECT_GT(turnaround, 500);
+  EXPECT_LT(turnaround, 1000);
+  indicator_power_brightness_set_percentage(brightness, 0.0);
+  const auto n_up = writes.size();
+  wait_msec(700);
+
+  // ...and confirm the ramp turned around from where it was
+  // instead of finishing the first ramp and then starting the second
+  ASSERT_GT(writes.size(), n_up);
+  for (size_t i=n_up; i<writes.size(); ++i)
+    EXPECT_LT(writes[i].brightness, turnaround);
+  EXPECT_EQ(0, writes.back().brightness);
+  EXPECT_DOUBLE_EQ(0.0, indicator_power_brightness_get_percentage(brightness));
+
+  g_object_unref(brightness);
+  g_object_unref(backend);
+  g_settings_reset(settings, "brightness-ramp-duration");
+  g_object_unref(settings);
+}
+
+TEST_F(BrightnessFixture, ZeroDurationJumps)
+{
+  auto settings = g_settings_new("org.ayatana.indicator.power");
+  g_settings_set_uint(settings, "brightness-ramp-duration", 0);
+
+  auto backend = recording_backend_new(1000, 0);
+  auto brightness = indicator_power_brightness_new_with_backend(INDICATOR_POWER_BRIGHTNESS_BACKEND(backend));
+  auto& writes = *backend->writes;
+
+  indicator_power_brightness_set_percentage(brightness, 0.2);
+  indicator_power_brightness_set_percentage(brightness, 0.9);
+  ASSERT_EQ(2u, writes.size());
+  EXPECT_EQ(900, writes.back().brightness);
+
+  g_object_unref(brightness);
+  g_object_unref(backend);
+  g_settings_reset(settings, "brightness-ramp-duration");
+  g_object_unref(settings);
+}
+
+/***
+****  Writes through Unity.Screen
+***/
+
+namespace
+{
+  const char * const FAKE_SCREEN_XML =
+    "<node>"
+    "  <interface name='com.canonical.powerd'>"
+    "    <property name='brightness' type='i' access='read'/>"
+    "    <method name='getBrightnessParams'>"
+    "      <arg type='(iiiib)' name='params' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "  <interface name='com.canonical.Unity.Screen'>"
+    "    <method name='setUserBrightness'>"
+    "      <arg type='i' name='brightness' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+  /* Stands in for powerd and Unity.Screen on the test's system bus.
+     It holds its reply to the first setUserBrightness call until release(),
+     so that the brightness object sees a write in flight. */
+  class FakeScreen
+  {
+  public:
+
+    std::vector<int> calls;
+
+    explicit FakeScreen(const char * address)
+    {
+      GError * error = nullptr;
+      m_bus = g_dbus_connection_new_for_address_sync(
+        address,
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, nullptr, &error);
+      g_assert_no_error(error);
+
+      m_node = g_dbus_node_info_new_for_xml(FAKE_SCREEN_XML, &error);
+      g_assert_no_error(error);
+
+      static const GDBusInterfaceVTable vtable = { on_method_call, on_get_property, nullptr };
+      m_ids[0] = g_dbus_connection_register_object(m_bus, "/com/canonical/powerd", m_node->interfaces[0],
+                                                   &vtable, this, nullptr, &error);
+      g_assert_no_error(error);
+      m_ids[1] = g_dbus_connection_register_object(m_bus, "/com/canonical/Unity/Screen", m_node->interfaces[1],
+                                                   &vtable, this, nullptr, &error);
+      g_assert_no_error(error);
+
+      request_name("com.canonical.powerd");
+      request_name("com.canonical.Unity.Screen");
+    }
+
+    FakeScreen(const FakeScreen&) =delete;
+    FakeScreen& operator=(const FakeScreen&) =delete;
+
+    ~FakeScreen()
+    {
+      release();
+      for (const auto& id : m_ids)
+        g_dbus_connection_unregister_object(m_bus, id);
+      g_dbus_node_info_unref(m_node);
+      g_dbus_connection_close_sync(m_bus, nullptr, nullptr);
+      g_object_unref(m_bus);
+    }
+
+    /* answers the held setUserBrightness call */
+    void release()
+    {
+      if (m_held != nullptr)
+        {
+          g_dbus_method_invocation_return_value(m_held, nullptr);
+          m_held = nullptr;
+        }
+    }
+
+  private:
+
+    void request_name(const char * name)
+    {
+      auto v = g_dbus_connection_call_sync(m_bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                           "org.freedesktop.DBus", "RequestName",
+                                           g_variant_new("(su)", name, 4u /* DBUS_NAME_FLAG_DO_NOT_QUEUE */),
+                                           G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+      ASSERT_NE(nullptr, v);
+      g_variant_unref(v);
+    }
+
+    static void on_method_call(GDBusConnection       * connection G_GNUC_UNUSED,
+                               const gchar           * sender     G_GNUC_UNUSED,
+                               const gchar           * path       G_GNUC_UNUSED,
+                               const gchar           * iface      G_GNUC_UNUSED,
+                               const gchar           * method,
+                               GVariant              * parameters,
+                               GDBusMethodInvocation * invocation,
+                               gpointer                gself)
+    {
+      auto self = static_cast<FakeScreen*>(gself);
+
+      if (!g_strcmp0(method, "getBrightnessParams"))
+        {
+          // dim, min, max, default, autobrightness supported
+          g_dbus_method_invocation_return_value(invocation, g_variant_new("((iiiib))", 100, 0, 1000, 500, TRUE));
+        }
+      else
+        {
+          int brightness = 0;
+          g_variant_get(parameters, "(i)", &brightness);
+          self->calls.push_back(brightness);
+
+          if (!self->m_held_first)
+            {
+              self->m_held_first = true;
+              self->m_held = invocation;
+            }
+          else
+            {
+              g_dbus_method_invocation_return_value(invocation, nullptr);
+            }
+        }
+    }
+
+    static GVariant * on_get_property(GDBusConnection * connection G_GNUC_UNUSED,
+                                      const gchar     * sender     G_GNUC_UNUSED,
+                                      const gchar     * path       G_GNUC_UNUSED,
+                                      const gchar     * iface      G_GNUC_UNUSED,
+                                      const gchar     * property   G_GNUC_UNUSED,
+                                      GError         ** error      G_GNUC_UNUSED,
+                                      gpointer          gself      G_GNUC_UNUSED)
+    {
+      return g_variant_new_int32(500);
+    }
+
+    GDBusConnection * m_bus = nullptr;
+    GDBusNodeInfo * m_node = nullptr;
+    guint m_ids[2] = { 0, 0 };
+    GDBusMethodInvocation * m_held = nullptr;
+    bool m_held_first = false;
+  };
+}
+
+class UScreenFixture: public BrightnessFixture
+{
+private:
+
+  typedef BrightnessFixture super;
+
+protected:
+
+  static GTestDBus * test_dbus;
+
+  FakeScreen * screen = nullptr;
+  GSettings * settings = nullptr;
+
+  static void SetUpTestCase()
+  {
+    // the brightness object finds powerd and Unity.Screen on the system bus
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), TRUE);
+  }
+
+  static void TearDownTestCase()
+  {
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+  }
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    settings = g_settings_new("org.ayatana.indicator.power");
+    screen = new FakeScreen(g_test_dbus_get_bus_address(test_dbus));
+  }
+
+  virtual void TearDown()
+  {
+    delete screen;
+    screen = nullptr;
+
+    g_settings_reset(settings, "brightness-ramp-duration");
+    g_settings_reset(settings, "brightness-ramp-rate");
+    g_clear_object(&settings);
+
+    super::TearDown();
+  }
+
+  /* a brightness object that's gotten powerd's params */
+  IndicatorPowerBrightness * create_brightness()
+  {
+    auto brightness = indicator_power_brightness_new();
+    wait_for_signal(brightness, "notify::auto-brightness-supported");
+    return brightness;
+  }
+
+  void wait_for_calls(size_t n)
+  {
+    for (int i=0; i<100 && screen->calls.size()<n; ++i)
+      wait_msec(20);
+  }
+};
+
+GTestDBus * UScreenFixture::test_dbus = nullptr;
+
+TEST_F(UScreenFixture, LatestValueWins)
+{
+  g_settings_set_uint(settings, "brightness-ramp-duration", 0);
+  auto brightness = create_brightness();
+
+  // the first value goes out right away and its reply is held,
+  // so each of the others replaces the one before it
+  const double percentages[] = { 0.1, 0.2, 0.3, 0.4, 0.5 };
+  for (const auto& percentage : percentages)
+    indicator_power_brightness_set_percentage(brightness, percentage);
+  wait_for_calls(1);
+  EXPECT_EQ(std::vector<int>({ 100 }), screen->calls);
+  EXPECT_EQ(3u, indicator_power_brightness_get_dropped_writes(brightness));
+
+  // when the first call's answered, only the latest value is sent
+  screen->release();
+  wait_for_calls(2);
+  wait_msec(100);
+  EXPECT_EQ(std::vector<int>({ 100, 500 }), screen->calls);
+  EXPECT_EQ(3u, indicator_power_brightness_get_dropped_writes(brightness));
+
+  g_object_unref(brightness);
+}
+
+TEST_F(UScreenFixture, DisposeMidRampSendsFinalValue)
+{
+  g_settings_set_uint(settings, "brightness-ramp-duration", 5000);
+  g_settings_set_uint(settings, "brightness-ramp-rate", 20);
+  auto brightness = create_brightness();
+
+  // the first value jumps straight there and its reply is held...
+  indicator_power_brightness_set_percentage(brightness, 0.1);
+  wait_for_calls(1);
+  EXPECT_EQ(std::vector<int>({ 100 }), screen->calls);
+
+  // ...so the ramp's steps queue up behind it
+  indicator_power_brightness_set_percentage(brightness, 1.0);
+  wait_msec(150);
+  EXPECT_EQ(1u, screen->calls.size());
+
+  // going away mid-ramp still gets the target out, even though
+  // the write it was waiting behind gets cancelled
+  g_object_unref(brightness);
+  wait_for_calls(2);
+  screen->release();
+  wait_msec(100);
+  ASSERT_EQ(2u, screen->calls.size());
+  EXPECT_EQ(1000, screen->calls.back());
+}
+
+/***
+****  Writes through logind
+***/
+
+namespace
+{
+  const char * const FAKE_LOGIND_XML =
+    "<node>"
+    "  <interface name='org.freedesktop.login1.Session'>"
+    "    <method name='SetBrightness'>"
+    "      <arg type='s' name='subsystem' direction='in'/>"
+    "      <arg type='s' name='name' direction='in'/>"
+    "      <arg type='u' name='brightness' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+  /* Stands in for logind on the test's system bus, refusing every
+     SetBrightness call the way it does for an inactive session */
+  class FakeLogind
+  {
+  public:
+
+    std::vector<int> calls;
+
+    explicit FakeLogind(const char * address)
+    {
+      GError * error = nullptr;
+      m_bus = g_dbus_connection_new_for_address_sync(
+        address,
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, nullptr, &error);
+      g_assert_no_error(error);
+
+      m_node = g_dbus_node_info_new_for_xml(FAKE_LOGIND_XML, &error);
+      g_assert_no_error(error);
+
+      static const GDBusInterfaceVTable vtable = { on_method_call, nullptr, nullptr };
+      m_id = g_dbus_connection_register_object(m_bus, "/org/freedesktop/login1/session/auto", m_node->interfaces[0],
+                                               &vtable, this, nullptr, &error);
+      g_assert_no_error(error);
+
+      auto v = g_dbus_connection_call_sync(m_bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                           "org.freedesktop.DBus", "RequestName",
+                                           g_variant_new("(su)", "org.freedesktop.login1", 4u /* DBUS_NAME_FLAG_DO_NOT_QUEUE */),
+                                           G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+      g_assert_no_error(error);
+      g_variant_unref(v);
+    }
+
+    FakeLogind(const FakeLogind&) =delete;
+    FakeLogind& operator=(const FakeLogind&) =delete;
+
+    ~FakeLogind()
+    {
+      g_dbus_connection_unregister_object(m_bus, m_id);
+      g_dbus_node_info_unref(m_node);
+      g_dbus_connection_close_sync(m_bus, nullptr, nullptr);
+      g_object_unref(m_bus);
+    }
+
+  private:
+
+    static void on_method_call(GDBusConnection       * connection G_GNUC_UNUSED,
+                               const gchar           * sender     G_GNUC_UNUSED,
+                               const gchar           * path       G_GNUC_UNUSED,
+                               const gchar           * iface      G_GNUC_UNUSED,
+                               const gchar           * method     G_GNUC_UNUSED,
+                               GVariant              * parameters,
+                               GDBusMethodInvocation * invocation,
+                               gpointer                gself)
+    {
+      guint32 brightness = 0;
+      g_variant_get(parameters, "(&s&su)", nullptr, nullptr, &brightness);
+      static_cast<FakeLogind*>(gself)->calls.push_back(int(brightness));
+
+      g_dbus_method_invocation_return_dbus_error(invocation,
+                                                 "org.freedesktop.DBus.Error.AccessDenied",
+                                                 "Not in control");
+    }
+
+    GDBusConnection * m_bus = nullptr;
+    GDBusNodeInfo * m_node = nullptr;
+    guint m_id = 0;
+  };
+}
+
+// shares UScreenFixture's system bus; the fake screen isn't used
+TEST_F(UScreenFixture, FailedLogindWriteIsUndone)
+{
+  add_backlight("intel_backlight", "raw", 1000, 500);
+  FakeLogind logind(g_test_dbus_get_bus_address(test_dbus));
+
+  auto backend = indicator_power_brightness_backend_sysfs_new(sysfs_dir, TRUE);
+  ASSERT_NE(nullptr, backend);
+  EXPECT_EQ(500, indicator_power_brightness_backend_get_brightness(backend));
+
+  // the new value's taken on faith...
+  increment_expected_errors(G_LOG_LEVEL_WARNING);
+  indicator_power_brightness_backend_set_brightness(backend, 300);
+  EXPECT_EQ(300, indicator_power_brightness_backend_get_brightness(backend));
+
+  // ...until logind refuses it, and then the hardware's value comes back
+  wait_for_signal(backend, "changed");
+  EXPECT_EQ(std::vector<int>({ 300 }), logind.calls);
+  EXPECT_EQ(500, indicator_power_brightness_backend_get_brightness(backend));
+  EXPECT_EQ(500, read_attr("intel_backlight", "brightness"));
+
+  g_object_unref(backend);
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-cache.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+/***
+****
+***/
+
+class DeviceCacheFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * cache_dir = nullptr;
+  gchar * cache_file = nullptr;
+  GList * devices = nullptr;
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    cache_dir = g_dir_make_tmp("indicator-power-cache-XXXXXX", nullptr);
+    ASSERT_NE(nullptr, cache_dir);
+    cache_file = g_build_filename(cache_dir, "devices", nullptr);
+
+    devices = g_list_append(devices, indicator_power_device_new("/org/freedesktop/UPower/devices/battery_BAT0",
+                                                                UP_DEVICE_KIND_BATTERY,
+                                                                52.5,
+                                                                UP_DEVICE_STATE_DISCHARGING,
+                                                                60*60,
+                                                                TRUE));
+    devices = g_list_append(devices, indicator_power_device_new("/org/freedesktop/UPower/devices/mouse_0",
+                                                                UP_DEVICE_KIND_MOUSE,
+                                                                80.0,
+                                                                UP_DEVICE_STATE_UNKNOWN,
+                                                                0,
+                                                                FALSE));
+  }
+
+  virtual void TearDown()
+  {
+    g_list_free_full(devices, g_object_unref);
+    devices = nullptr;
+
+    g_remove(cache_file);
+    g_remove(cache_dir);
+    g_clear_pointer(&cache_file, g_free);
+    g_clear_pointer(&cache_dir, g_free);
+
+    super::TearDown();
+  }
+
+  GList * load()
+  {
+    auto cache = indicator_power_device_cache_new(cache_dir);
+    auto loaded = indicator_power_device_cache_load(cache);
+    g_object_unref(cache);
+    return loaded;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(DeviceCacheFixture, NoSnapshot)
+{
+  EXPECT_EQ(nullptr, load());
+
+  // loading doesn't create anything
+  EXPECT_FALSE(g_file_test(cache_file, G_FILE_TEST_EXISTS));
+}
+
+TEST_F(DeviceCacheFixture, RoundTrip)
+{
+  auto cache = indicator_power_device_cache_new(cache_dir);
+  indicator_power_device_cache_save(cache, devices);
+  g_object_unref(cache);
+
+  auto loaded = load();
+  ASSERT_EQ(2u, g_list_length(loaded));
+
+  GList * l;
+  GList * m;
+  for (l=loaded, m=devices; l!=nullptr; l=l->next, m=m->next)
+    {
+      auto a = static_cast<IndicatorPowerDevice*>(m->data);
+      auto b = static_cast<IndicatorPowerDevice*>(l->data);
+      EXPECT_STREQ(indicator_power_device_get_object_path(a), indicator_power_device_get_object_path(b));
+      EXPECT_EQ(indicator_power_device_get_kind(a), indicator_power_device_get_kind(b));
+      EXPECT_EQ(indicator_power_device_get_state(a), indicator_power_device_get_state(b));
+      EXPECT_EQ(indicator_power_device_get_percentage(a), indicator_power_device_get_percentage(b));
+      EXPECT_EQ(indicator_power_device_get_power_supply(a), indicator_power_device_get_power_supply(b));
+
+      // the time remaining isn't kept
+      EXPECT_EQ(0, indicator_power_device_get_time(b));
+    }
+
+  g_list_free_full(loaded, g_object_unref);
+}
+
+TEST_F(DeviceCacheFixture, CorruptSnapshotIsIgnored)
+{
+  ASSERT_TRUE(g_file_set_contents(cache_file, "this is not a snapshot", -1, nullptr));
+  EXPECT_EQ(nullptr, load());
+
+  ASSERT_TRUE(g_file_set_contents(cache_file, "", 0, nullptr));
+  EXPECT_EQ(nullptr, load());
+}
+
+TEST_F(DeviceCacheFixture, WritesAreRateLimited)
+{
+  auto cache = indicator_power_device_cache_new(cache_dir);
+
+  // the first snapshot is written right away...
+  indicator_power_device_cache_save(cache, devices);
+  EXPECT_TRUE(g_file_test(cache_file, G_FILE_TEST_EXISTS));
+
+  // ...but the next one has to wait
+  g_object_set(devices->data, INDICATOR_POWER_DEVICE_PERCENTAGE, 40.0, nullptr);
+  indicator_power_device_cache_save(cache, devices);
+  auto loaded = load();
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_EQ(52.5, indicator_power_device_get_percentage(INDICATOR_POWER_DEVICE(loaded->data)));
+  g_list_free_full(loaded, g_object_unref);
+
+  // only the newest of the waiting snapshots gets written
+  g_object_set(devices->data, INDICATOR_POWER_DEVICE_PERCENTAGE, 30.0, nullptr);
+  indicator_power_device_cache_save(cache, devices);
+  indicator_power_device_cache_flush(cache);
+  loaded = load();
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_EQ(30.0, indicator_power_device_get_percentage(INDICATOR_POWER_DEVICE(loaded->data)));
+  g_list_free_full(loaded, g_object_unref);
+
+  g_object_unref(cache);
+}
+
+TEST_F(DeviceCacheFixture, DisposeWritesPendingSnapshot)
+{
+  auto cache = indicator_power_device_cache_new(cache_dir);
+  indicator_power_device_cache_save(cache, devices);
+
+  g_object_set(devices->data, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  indicator_power_device_cache_save(cache, devices);
+  g_object_unref(cache);
+
+  auto loaded = load();
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_EQ(UP_DEVICE_STATE_CHARGING, indicator_power_device_get_state(INDICATOR_POWER_DEVICE(loaded->data)));
+  g_list_free_full(loaded, g_object_unref);
+}
+
+TEST_F(DeviceCacheFixture, UnchangedSnapshotIsNotRewritten)
+{
+  auto cache = indicator_power_device_cache_new(cache_dir);
+  indicator_power_device_cache_save(cache, devices);
+  ASSERT_TRUE(g_file_test(cache_file, G_FILE_TEST_EXISTS));
+
+  // if the file were rewritten, it would reappear
+  g_remove(cache_file);
+  indicator_power_device_cache_save(cache, devices);
+  indicator_power_device_cache_flush(cache);
+  EXPECT_FALSE(g_file_test(cache_file, G_FILE_TEST_EXISTS));
+
+  g_object_unref(cache);
+}
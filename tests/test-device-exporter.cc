@@ -0,0 +1,212 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-device.h"
+#include "device.h"
+#include "device-exporter.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <set>
+#include <string>
+
+/***
+****
+***/
+
+class DeviceExporterTest: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr char const * DEVICES_PATH {"/org/ayatana/indicator/power/devices"};
+  static constexpr char const * DEVICE_IFACE {"org.ayatana.indicator.power.Device"};
+
+  std::set<std::string> get_object_paths(IndicatorPowerDeviceExporter * exporter)
+  {
+    std::set<std::string> paths;
+    auto manager = indicator_power_device_exporter_get_object_manager(exporter);
+    auto objects = g_dbus_object_manager_get_objects(manager);
+    for (auto l=objects; l!=nullptr; l=l->next)
+      paths.insert(g_dbus_object_get_object_path(G_DBUS_OBJECT(l->data)));
+    g_list_free_full(objects, g_object_unref);
+    return paths;
+  }
+
+  // returns a new ref
+  DbusDevice* get_exported(IndicatorPowerDeviceExporter * exporter, const std::string& name)
+  {
+    const auto object_path = std::string(DEVICES_PATH) + "/" + name;
+    auto manager = indicator_power_device_exporter_get_object_manager(exporter);
+    auto iface = g_dbus_object_manager_get_interface(manager, object_path.c_str(), DEVICE_IFACE);
+    return iface != nullptr ? DBUS_DEVICE(iface) : nullptr;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(DeviceExporterTest, ExportsEachDevice)
+{
+  auto battery = indicator_power_device_new("/org/freedesktop/UPower/devices/battery_BAT0",
+                                            UP_DEVICE_KIND_BATTERY,
+                                            50.0,
+                                            UP_DEVICE_STATE_DISCHARGING,
+                                            60*60,
+                                            TRUE);
+  g_object_set(battery, INDICATOR_POWER_DEVICE_ENERGY_RATE, 8.5,
+                        INDICATOR_POWER_DEVICE_ENERGY, 25.0,
+                        INDICATOR_POWER_DEVICE_ENERGY_FULL, 50.0,
+                        INDICATOR_POWER_DEVICE_ENERGY_FULL_DESIGN, 56.0,
+                        INDICATOR_POWER_DEVICE_VOLTAGE, 11.5,
+                        INDICATOR_POWER_DEVICE_TEMPERATURE, 31.5,
+                        INDICATOR_POWER_DEVICE_CAPACITY, 89.25,
+                        nullptr);
+  auto line_power = indicator_power_device_new("/org/freedesktop/UPower/devices/line_power_AC",
+                                               UP_DEVICE_KIND_LINE_POWER,
+                                               0.0,
+                                               UP_DEVICE_STATE_UNKNOWN,
+                                               0,
+                                               TRUE);
+  auto devices = g_list_append(g_list_append(nullptr, battery), line_power);
+
+  auto exporter = indicator_power_device_exporter_new();
+  indicator_power_device_exporter_set_devices(exporter, devices);
+
+  const std::set<std::string> expected_paths {
+    std::string(DEVICES_PATH) + "/battery_BAT0",
+    std::string(DEVICES_PATH) + "/line_power_AC"
+  };
+  EXPECT_EQ(expected_paths, get_object_paths(exporter));
+
+  auto exported = get_exported(exporter, "battery_BAT0");
+  ASSERT_NE(nullptr, exported);
+  EXPECT_STREQ("/org/freedesktop/UPower/devices/battery_BAT0", dbus_device_get_source(exported));
+  EXPECT_EQ(guint32(UP_DEVICE_KIND_BATTERY), dbus_device_get_kind(exported));
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_DISCHARGING), dbus_device_get_state(exported));
+  EXPECT_EQ(50.0, dbus_device_get_percentage(exported));
+  EXPECT_EQ(guint64(60*60), dbus_device_get_time_remaining(exported));
+  EXPECT_EQ(8.5, dbus_device_get_energy_rate(exported));
+  EXPECT_EQ(25.0, dbus_device_get_energy(exported));
+  EXPECT_EQ(50.0, dbus_device_get_energy_full(exported));
+  EXPECT_EQ(56.0, dbus_device_get_energy_full_design(exported));
+  EXPECT_EQ(11.5, dbus_device_get_voltage(exported));
+  EXPECT_EQ(31.5, dbus_device_get_temperature(exported));
+  EXPECT_EQ(89.25, dbus_device_get_capacity(exported));
+  g_object_unref(exported);
+
+  // cleanup
+  g_object_unref(exporter);
+  g_list_free_full(devices, g_object_unref);
+}
+
+TEST_F(DeviceExporterTest, FollowsDeviceChanges)
+{
+  auto battery = indicator_power_device_new("/org/freedesktop/UPower/devices/battery_BAT0",
+                                            UP_DEVICE_KIND_BATTERY,
+                                            50.0,
+                                            UP_DEVICE_STATE_DISCHARGING,
+                                            60*60,
+                                            TRUE);
+  auto devices = g_list_append(nullptr, battery);
+
+  auto exporter = indicator_power_device_exporter_new();
+  indicator_power_device_exporter_set_devices(exporter, devices);
+  auto exported = get_exported(exporter, "battery_BAT0");
+  ASSERT_NE(nullptr, exported);
+  EXPECT_EQ(0.0, dbus_device_get_energy_rate(exported));
+
+  g_object_set(battery, INDICATOR_POWER_DEVICE_ENERGY_RATE, 14.0,
+                        INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0,
+                        nullptr);
+  EXPECT_EQ(14.0, dbus_device_get_energy_rate(exported));
+  EXPECT_EQ(49.0, dbus_device_get_percentage(exported));
+
+  // a provider may hand us a new object for the same device
+  auto replacement = indicator_power_device_new("/org/freedesktop/UPower/devices/battery_BAT0",
+                                                UP_DEVICE_KIND_BATTERY,
+                                                60.0,
+                                                UP_DEVICE_STATE_CHARGING,
+                                                60*30,
+                                                TRUE);
+  g_list_free_full(devices, g_object_unref);
+  devices = g_list_append(nullptr, replacement);
+  indicator_power_device_exporter_set_devices(exporter, devices);
+  EXPECT_EQ(60.0, dbus_device_get_percentage(exported));
+  EXPECT_EQ(0.0, dbus_device_get_energy_rate(exported));
+  EXPECT_EQ(1u, get_object_paths(exporter).size());
+
+  // cleanup
+  g_object_unref(exported);
+  g_object_unref(exporter);
+  g_list_free_full(devices, g_object_unref);
+}
+
+TEST_F(DeviceExporterTest, RemovedDevicesAreUnexported)
+{
+  auto bat0 = indicator_power_device_new("/org/freedesktop/UPower/devices/battery_BAT0",
+                                         UP_DEVICE_KIND_BATTERY, 50.0, UP_DEVICE_STATE_DISCHARGING, 60*60, TRUE);
+  auto bat1 = indicator_power_device_new("/org/freedesktop/UPower/devices/battery_BAT1",
+                                         UP_DEVICE_KIND_BATTERY, 70.0, UP_DEVICE_STATE_DISCHARGING, 60*60, TRUE);
+  auto devices = g_list_append(g_list_append(nullptr, bat0), bat1);
+
+  auto exporter = indicator_power_device_exporter_new();
+  indicator_power_device_exporter_set_devices(exporter, devices);
+  EXPECT_EQ(2u, get_object_paths(exporter).size());
+
+  auto only_bat1 = g_list_append(nullptr, bat1);
+  indicator_power_device_exporter_set_devices(exporter, only_bat1);
+  const std::set<std::string> expected_paths { std::string(DEVICES_PATH) + "/battery_BAT1" };
+  EXPECT_EQ(expected_paths, get_object_paths(exporter));
+  g_list_free(only_bat1);
+
+  indicator_power_device_exporter_set_devices(exporter, nullptr);
+  EXPECT_TRUE(get_object_paths(exporter).empty());
+
+  // cleanup
+  g_object_unref(exporter);
+  g_list_free_full(devices, g_object_unref);
+}
+
+TEST_F(DeviceExporterTest, NamesAreSanitizedAndUnique)
+{
+  auto a = indicator_power_device_new("/a/mouse-1", UP_DEVICE_KIND_MOUSE, 50.0, UP_DEVICE_STATE_DISCHARGING, 0, FALSE);
+  auto b = indicator_power_device_new("/b/mouse.1", UP_DEVICE_KIND_MOUSE, 50.0, UP_DEVICE_STATE_DISCHARGING, 0, FALSE);
+  auto devices = g_list_append(g_list_append(nullptr, a), b);
+
+  auto exporter = indicator_power_device_exporter_new();
+  indicator_power_device_exporter_set_devices(exporter, devices);
+
+  auto paths = get_object_paths(exporter);
+  EXPECT_EQ(2u, paths.size());
+  for (const auto& path : paths)
+    {
+      EXPECT_TRUE(g_variant_is_object_path(path.c_str())) << path;
+      EXPECT_EQ(0u, path.find(std::string(DEVICES_PATH) + "/mouse_1")) << path;
+    }
+
+  // cleanup
+  g_object_unref(exporter);
+  g_list_free_full(devices, g_object_unref);
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-composite.h"
+#include "device-provider-mock.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+class CompositeProviderFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  IndicatorPowerDeviceProvider * composite = nullptr;
+  int n_devices_changed = 0;
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    composite = indicator_power_device_provider_composite_new();
+    g_signal_connect_swapped(composite, "devices-changed", G_CALLBACK(on_devices_changed), this);
+  }
+
+  virtual void TearDown()
+  {
+    g_clear_object(&composite);
+
+    super::TearDown();
+  }
+
+  static void on_devices_changed(gpointer gself)
+  {
+    static_cast<CompositeProviderFixture*>(gself)->n_devices_changed++;
+  }
+
+  void add(IndicatorPowerDeviceProvider * provider, int priority)
+  {
+    indicator_power_device_provider_composite_add(INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE(composite), provider, priority);
+  }
+
+  static IndicatorPowerDevice * add_battery(IndicatorPowerDeviceProvider * provider, const char * path, double percentage)
+  {
+    auto device = indicator_power_device_new(path, UP_DEVICE_KIND_BATTERY, percentage, UP_DEVICE_STATE_DISCHARGING, 60*60, TRUE);
+    indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider), device);
+    g_object_unref(device);
+    return device; // the provider holds a ref
+  }
+
+  std::vector<std::string> get_paths()
+  {
+    std::vector<std::string> paths;
+    auto devices = indicator_power_device_provider_get_devices(composite);
+    for (auto l=devices; l!=nullptr; l=l->next)
+      paths.push_back(indicator_power_device_get_object_path(INDICATOR_POWER_DEVICE(l->data)));
+    g_list_free_full(devices, g_object_unref);
+    return paths;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(CompositeProviderFixture, Empty)
+{
+  EXPECT_TRUE(get_paths().empty());
+}
+
+TEST_F(CompositeProviderFixture, MergesProviders)
+{
+  auto a = indicator_power_device_provider_mock_new();
+  auto b = indicator_power_device_provider_mock_new();
+  add_battery(a, "/org/freedesktop/UPower/devices/battery_BAT0", 50.0);
+  add_battery(b, "/sys/class/power_supply/BAT1", 60.0);
+  add(a, 1);
+  add(b, 0);
+
+  const std::vector<std::string> expected {
+    "/org/freedesktop/UPower/devices/battery_BAT0",
+    "/sys/class/power_supply/BAT1"
+  };
+  EXPECT_EQ(expected, get_paths());
+
+  // adding both providers only emits once
+  wait_msec();
+  EXPECT_EQ(1, n_devices_changed);
+
+  g_object_unref(b);
+  g_object_unref(a);
+}
+
+TEST_F(CompositeProviderFixture, HigherPriorityWins)
+{
+  auto upower = indicator_power_device_provider_mock_new();
+  auto sysfs = indicator_power_device_provider_mock_new();
+  add_battery(upower, "/org/freedesktop/UPower/devices/battery_BAT0", 50.0);
+  add_battery(upower, "/org/freedesktop/UPower/devices/mouse_hid_00_1f_20_aa_bb_cc_battery", 80.0);
+  add_battery(sysfs, "/sys/class/power_supply/BAT0", 51.0);
+  add_battery(sysfs, "/sys/class/power_supply/hid-00:1f:20:aa:bb:cc-battery", 81.0);
+  add_battery(sysfs, "/sys/class/power_supply/BAT1", 90.0);
+
+  // the order they're added in doesn't matter
+  add(sysfs, 0);
+  add(upower, 1);
+
+  const std::vector<std::string> expected {
+    "/org/freedesktop/UPower/devices/battery_BAT0",
+    "/org/freedesktop/UPower/devices/mouse_hid_00_1f_20_aa_bb_cc_battery",
+    "/sys/class/power_supply/BAT1"
+  };
+  EXPECT_EQ(expected, get_paths());
+
+  // the lower-priority provider's devices show through when the other's go away
+  indicator_power_device_provider_composite_remove(INDICATOR_POWER_DEVICE_PROVIDER_COMPOSITE(composite), upower);
+  const std::vector<std::string> fallback {
+    "/sys/class/power_supply/BAT0",
+    "/sys/class/power_supply/hid-00:1f:20:aa:bb:cc-battery",
+    "/sys/class/power_supply/BAT1"
+  };
+  EXPECT_EQ(fallback, get_paths());
+
+  g_object_unref(sysfs);
+  g_object_unref(upower);
+}
+
+TEST_F(CompositeProviderFixture, TiesGoToFirstAdded)
+{
+  auto a = indicator_power_device_provider_mock_new();
+  auto b = indicator_power_device_provider_mock_new();
+  add_battery(a, "/a/BAT0", 50.0);
+  add_battery(b, "/b/BAT0", 50.0);
+  add(a, 0);
+  add(b, 0);
+
+  EXPECT_EQ(std::vector<std::string>{"/a/BAT0"}, get_paths());
+
+  g_object_unref(b);
+  g_object_unref(a);
+}
+
+TEST_F(CompositeProviderFixture, BurstIsCoalesced)
+{
+  auto a = indicator_power_device_provider_mock_new();
+  auto b = indicator_power_device_provider_mock_new();
+  auto bat0 = add_battery(a, "/a/BAT0", 50.0);
+  auto bat1 = add_battery(b, "/b/BAT1", 50.0);
+  add(a, 1);
+  add(b, 0);
+  wait_msec();
+  n_devices_changed = 0;
+
+  // the mock provider emits devices-changed for every property change
+  for (int i=0; i<10; ++i)
+    {
+      g_object_set(bat0, INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0 - i, nullptr);
+      g_object_set(bat1, INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0 - i, nullptr);
+    }
+  wait_msec();
+  EXPECT_EQ(1, n_devices_changed);
+
+  g_object_unref(b);
+  g_object_unref(a);
+}
+
+TEST_F(CompositeProviderFixture, SlowProviderDoesNotBlock)
+{
+  // e.g. UPower before its name's appeared on the bus
+  auto slow = indicator_power_device_provider_mock_new();
+  auto fast = indicator_power_device_provider_mock_new();
+  add_battery(fast, "/sys/class/power_supply/BAT0", 50.0);
+  add(slow, 1);
+  add(fast, 0);
+
+  wait_for_signal(composite, "devices-changed");
+  EXPECT_EQ(std::vector<std::string>{"/sys/class/power_supply/BAT0"}, get_paths());
+
+  // when the slow provider finally reports, its view takes over
+  add_battery(slow, "/org/freedesktop/UPower/devices/battery_BAT0", 50.0);
+  indicator_power_device_provider_emit_devices_changed(slow);
+  wait_for_signal(composite, "devices-changed");
+  EXPECT_EQ(std::vector<std::string>{"/org/freedesktop/UPower/devices/battery_BAT0"}, get_paths());
+
+  g_object_unref(fast);
+  g_object_unref(slow);
+}
@@ -0,0 +1,414 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-sysfs.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+namespace
+{
+  typedef std::vector<std::string> Props;
+
+  const Props BAT0 {
+    "POWER_SUPPLY_NAME=BAT0",
+    "POWER_SUPPLY_TYPE=Battery",
+    "POWER_SUPPLY_STATUS=Discharging",
+    "POWER_SUPPLY_PRESENT=1",
+    "POWER_SUPPLY_SCOPE=System",
+    "POWER_SUPPLY_VOLTAGE_NOW=11400000",
+    "POWER_SUPPLY_POWER_NOW=9500000",
+    "POWER_SUPPLY_ENERGY_FULL_DESIGN=56000000",
+    "POWER_SUPPLY_ENERGY_FULL=50000000",
+    "POWER_SUPPLY_ENERGY_NOW=28500000",
+    "POWER_SUPPLY_CAPACITY=57",
+    "POWER_SUPPLY_TEMP=315"
+  };
+
+  // reports charge and a signed current instead of energy and power
+  const Props BAT1 {
+    "POWER_SUPPLY_NAME=BAT1",
+    "POWER_SUPPLY_TYPE=Battery",
+    "POWER_SUPPLY_STATUS=Discharging",
+    "POWER_SUPPLY_PRESENT=1",
+    "POWER_SUPPLY_VOLTAGE_NOW=12000000",
+    "POWER_SUPPLY_CURRENT_NOW=-1000000",
+    "POWER_SUPPLY_CHARGE_FULL=4000000",
+    "POWER_SUPPLY_CHARGE_NOW=2000000"
+  };
+
+  const Props EMPTY_BAY {
+    "POWER_SUPPLY_NAME=BAT2",
+    "POWER_SUPPLY_TYPE=Battery",
+    "POWER_SUPPLY_PRESENT=0"
+  };
+
+  const Props AC {
+    "POWER_SUPPLY_NAME=AC",
+    "POWER_SUPPLY_TYPE=Mains",
+    "POWER_SUPPLY_ONLINE=0"
+  };
+
+  const Props MOUSE {
+    "POWER_SUPPLY_NAME=hidpp_battery_0",
+    "POWER_SUPPLY_TYPE=Battery",
+    "POWER_SUPPLY_SCOPE=Device",
+    "POWER_SUPPLY_STATUS=Discharging",
+    "POWER_SUPPLY_CAPACITY=80"
+  };
+
+  const Props WIRELESS {
+    "POWER_SUPPLY_NAME=qi",
+    "POWER_SUPPLY_TYPE=Wireless"
+  };
+
+  Props with(Props props, const std::string& key, const std::string& value)
+  {
+    for (auto& prop : props)
+      if (prop.compare(0, key.size()+1, key+"=") == 0)
+        prop = key + "=" + value;
+    return props;
+  }
+}
+
+class SysfsProviderFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * sysfs_dir = nullptr;
+  int uevent_fds[2] = { -1, -1 };
+  IndicatorPowerDeviceProvider * provider = nullptr;
+  int n_devices_changed = 0;
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    sysfs_dir = g_dir_make_tmp("indicator-power-supply-XXXXXX", nullptr);
+    ASSERT_NE(nullptr, sysfs_dir);
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0, uevent_fds));
+  }
+
+  virtual void TearDown()
+  {
+    // the provider owns uevent_fds[0]
+    g_clear_object(&provider);
+    close(uevent_fds[1]);
+
+    remove_tree(sysfs_dir);
+    g_clear_pointer(&sysfs_dir, g_free);
+
+    super::TearDown();
+  }
+
+  static void remove_tree(const char * path)
+  {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR))
+      {
+        auto dir = g_dir_open(path, 0, nullptr);
+        const char * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+
+    g_remove(path);
+  }
+
+  static std::string get_name(const Props& props)
+  {
+    const std::string key {"POWER_SUPPLY_NAME="};
+    for (const auto& prop : props)
+      if (prop.compare(0, key.size(), key) == 0)
+        return prop.substr(key.size());
+    return "";
+  }
+
+  void add_supply(const Props& props)
+  {
+    const auto name = get_name(props);
+    auto dir = g_build_filename(sysfs_dir, name.c_str(), nullptr);
+    g_mkdir_with_parents(dir, 0700);
+    auto path = g_build_filename(dir, "uevent", nullptr);
+
+    std::string contents;
+    for (const auto& prop : props)
+      contents += prop + "\n";
+    ASSERT_TRUE(g_file_set_contents(path, contents.c_str(), -1, nullptr));
+
+    g_free(path);
+    g_free(dir);
+  }
+
+  static void on_devices_changed(IndicatorPowerDeviceProvider *, gpointer gself)
+  {
+    static_cast<SysfsProviderFixture*>(gself)->n_devices_changed++;
+  }
+
+  void create_provider()
+  {
+    provider = indicator_power_device_provider_sysfs_new(sysfs_dir, uevent_fds[0]);
+    ASSERT_NE(nullptr, provider);
+    g_signal_connect(provider, "devices-changed", G_CALLBACK(on_devices_changed), this);
+  }
+
+  // a netlink-style message: an ACTION@DEVPATH header, then NUL-separated properties
+  void send_uevent(const std::string& action, const Props& props, const char * subsystem="power_supply")
+  {
+    const auto devpath = std::string("/devices/LNXSYSTM:00/LNXSYBUS:00/PNP0C0A:00/power_supply/") + get_name(props);
+
+    std::string msg = action + "@" + devpath;
+    msg.push_back('\0');
+    for (const auto& prop : Props{"ACTION="+action, "DEVPATH="+devpath, std::string("SUBSYSTEM=")+subsystem, "SEQNUM=1234"})
+      {
+        msg += prop;
+        msg.push_back('\0');
+      }
+    for (const auto& prop : props)
+      {
+        msg += prop;
+        msg.push_back('\0');
+      }
+
+    ASSERT_EQ(ssize_t(msg.size()), send(uevent_fds[1], msg.data(), msg.size(), 0));
+  }
+
+  IndicatorPowerDevice * find_device(const std::string& name)
+  {
+    const auto path = std::string(sysfs_dir) + "/" + name;
+    IndicatorPowerDevice * found = nullptr;
+
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    for (auto l=devices; l!=nullptr; l=l->next)
+      {
+        auto device = INDICATOR_POWER_DEVICE(l->data);
+        if (path == indicator_power_device_get_object_path(device))
+          found = device;
+      }
+    g_list_free_full(devices, g_object_unref);
+
+    // the provider still holds a ref
+    return found;
+  }
+
+  size_t count_devices()
+  {
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    const auto n = g_list_length(devices);
+    g_list_free_full(devices, g_object_unref);
+    return n;
+  }
+
+  static guint64 get_reported_time(IndicatorPowerDevice * device)
+  {
+    guint64 time = 0;
+    g_object_get(device, INDICATOR_POWER_DEVICE_TIME, &time, nullptr);
+    return time;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(SysfsProviderFixture, NoPowerSupplies)
+{
+  create_provider();
+  EXPECT_EQ(0u, count_devices());
+}
+
+TEST_F(SysfsProviderFixture, ReadsEnergyReportingBattery)
+{
+  add_supply(BAT0);
+  create_provider();
+
+  auto device = find_device("BAT0");
+  ASSERT_NE(nullptr, device);
+  EXPECT_EQ(UP_DEVICE_KIND_BATTERY, indicator_power_device_get_kind(device));
+  EXPECT_EQ(UP_DEVICE_STATE_DISCHARGING, indicator_power_device_get_state(device));
+  EXPECT_EQ(57.0, indicator_power_device_get_percentage(device));
+  EXPECT_TRUE(indicator_power_device_get_power_supply(device));
+
+  // 28.5 Wh left at 9.5 W
+  EXPECT_EQ(guint64(3*60*60), get_reported_time(device));
+
+  EXPECT_NEAR(9.5, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE), 0.001);
+  EXPECT_NEAR(28.5, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_ENERGY), 0.001);
+  EXPECT_NEAR(50.0, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL), 0.001);
+  EXPECT_NEAR(56.0, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL_DESIGN), 0.001);
+  EXPECT_NEAR(11.4, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_VOLTAGE), 0.001);
+  EXPECT_NEAR(31.5, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_TEMPERATURE), 0.001);
+  EXPECT_NEAR(100.0*50.0/56.0, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_CAPACITY), 0.001);
+}
+
+TEST_F(SysfsProviderFixture, ReadsChargeReportingBattery)
+{
+  add_supply(BAT1);
+  create_provider();
+
+  auto device = find_device("BAT1");
+  ASSERT_NE(nullptr, device);
+
+  // no POWER_SUPPLY_CAPACITY, so 2 Ah of 4 Ah
+  EXPECT_EQ(50.0, indicator_power_device_get_percentage(device));
+
+  // 24 Wh left at 12 W
+  EXPECT_EQ(guint64(2*60*60), get_reported_time(device));
+  EXPECT_NEAR(12.0, indicator_power_device_get_metric(device, INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE), 0.001);
+}
+
+TEST_F(SysfsProviderFixture, ClassifiesSupplies)
+{
+  add_supply(AC);
+  add_supply(MOUSE);
+  add_supply(EMPTY_BAY);
+  add_supply(WIRELESS);
+  create_provider();
+
+  EXPECT_EQ(2u, count_devices());
+
+  auto ac = find_device("AC");
+  ASSERT_NE(nullptr, ac);
+  EXPECT_EQ(UP_DEVICE_KIND_LINE_POWER, indicator_power_device_get_kind(ac));
+
+  // peripherals don't power the system
+  auto mouse = find_device("hidpp_battery_0");
+  ASSERT_NE(nullptr, mouse);
+  EXPECT_EQ(UP_DEVICE_KIND_BATTERY, indicator_power_device_get_kind(mouse));
+  EXPECT_FALSE(indicator_power_device_get_power_supply(mouse));
+  EXPECT_EQ(80.0, indicator_power_device_get_percentage(mouse));
+}
+
+TEST_F(SysfsProviderFixture, TypeFileFallback)
+{
+  // older kernels leave POWER_SUPPLY_TYPE out of the uevent
+  Props props;
+  for (const auto& prop : AC)
+    if (prop.find("POWER_SUPPLY_TYPE=") != 0)
+      props.push_back(prop);
+  add_supply(props);
+
+  auto path = g_build_filename(sysfs_dir, "AC", "type", nullptr);
+  ASSERT_TRUE(g_file_set_contents(path, "Mains\n", -1, nullptr));
+  g_free(path);
+
+  create_provider();
+  auto ac = find_device("AC");
+  ASSERT_NE(nullptr, ac);
+  EXPECT_EQ(UP_DEVICE_KIND_LINE_POWER, indicator_power_device_get_kind(ac));
+}
+
+TEST_F(SysfsProviderFixture, ChangeUevent)
+{
+  add_supply(BAT0);
+  create_provider();
+
+  send_uevent("change", with(with(BAT0, "POWER_SUPPLY_STATUS", "Charging"), "POWER_SUPPLY_CAPACITY", "58"));
+  wait_for_signal(provider, "devices-changed");
+  EXPECT_EQ(1, n_devices_changed);
+
+  auto device = find_device("BAT0");
+  ASSERT_NE(nullptr, device);
+  EXPECT_EQ(UP_DEVICE_STATE_CHARGING, indicator_power_device_get_state(device));
+  EXPECT_EQ(58.0, indicator_power_device_get_percentage(device));
+
+  // 21.5 Wh to go at 9.5 W
+  EXPECT_EQ(guint64(3600.0*21.5/9.5), get_reported_time(device));
+}
+
+TEST_F(SysfsProviderFixture, BurstIsCoalesced)
+{
+  add_supply(BAT0);
+  create_provider();
+
+  for (const auto& capacity : {"56", "55", "54"})
+    send_uevent("change", with(BAT0, "POWER_SUPPLY_CAPACITY", capacity));
+  wait_msec(100);
+
+  EXPECT_EQ(1, n_devices_changed);
+  EXPECT_EQ(54.0, indicator_power_device_get_percentage(find_device("BAT0")));
+}
+
+TEST_F(SysfsProviderFixture, MetricChangesAreQuiet)
+{
+  add_supply(BAT0);
+  create_provider();
+
+  send_uevent("change", with(BAT0, "POWER_SUPPLY_VOLTAGE_NOW", "11300000"));
+  wait_msec(100);
+
+  EXPECT_EQ(0, n_devices_changed);
+  EXPECT_NEAR(11.3, indicator_power_device_get_metric(find_device("BAT0"), INDICATOR_POWER_DEVICE_METRIC_VOLTAGE), 0.001);
+}
+
+TEST_F(SysfsProviderFixture, AddAndRemoveUevents)
+{
+  add_supply(BAT0);
+  create_provider();
+
+  send_uevent("add", MOUSE);
+  wait_for_signal(provider, "devices-changed");
+  EXPECT_EQ(2u, count_devices());
+  EXPECT_NE(nullptr, find_device("hidpp_battery_0"));
+
+  send_uevent("remove", Props{"POWER_SUPPLY_NAME=hidpp_battery_0"});
+  wait_for_signal(provider, "devices-changed");
+  EXPECT_EQ(1u, count_devices());
+  EXPECT_EQ(nullptr, find_device("hidpp_battery_0"));
+
+  // a battery pulled from its bay
+  send_uevent("change", EMPTY_BAY);
+  send_uevent("change", with(BAT0, "POWER_SUPPLY_PRESENT", "0"));
+  wait_for_signal(provider, "devices-changed");
+  EXPECT_EQ(0u, count_devices());
+}
+
+TEST_F(SysfsProviderFixture, OtherSubsystemsAreIgnored)
+{
+  create_provider();
+
+  send_uevent("add", BAT0, "usb");
+  wait_msec(100);
+
+  EXPECT_EQ(0, n_devices_changed);
+  EXPECT_EQ(0u, count_devices());
+}
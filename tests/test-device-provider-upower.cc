@@ -0,0 +1,499 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+#include "upower-log.h"
+#include "upower-replay.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-upower.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+namespace
+{
+  const char * const UPOWER = "org.freedesktop.UPower";
+  const char * const UPOWER_PATH = "/org/freedesktop/UPower";
+  const char * const DEVICE_IFACE = "org.freedesktop.UPower.Device";
+  const char * const PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
+
+  const char * const BAT0 = "/org/freedesktop/UPower/devices/battery_BAT0";
+  const char * const AC = "/org/freedesktop/UPower/devices/line_power_AC";
+  const char * const MOUSE = "/org/freedesktop/UPower/devices/mouse_0";
+  const char * const DISPLAY_DEVICE = "/org/freedesktop/UPower/devices/DisplayDevice";
+
+  const guint64 SEC = G_USEC_PER_SEC;
+
+  struct DeviceState
+  {
+    UpDeviceKind kind;
+    UpDeviceState state;
+    double percentage;
+    bool power_supply;
+  };
+
+  GVariant * get_all_reply(const DeviceState& s)
+  {
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&b, "{sv}", "Type", g_variant_new_uint32(s.kind));
+    g_variant_builder_add(&b, "{sv}", "State", g_variant_new_uint32(s.state));
+    g_variant_builder_add(&b, "{sv}", "Percentage", g_variant_new_double(s.percentage));
+    g_variant_builder_add(&b, "{sv}", "TimeToEmpty", g_variant_new_int64(0));
+    g_variant_builder_add(&b, "{sv}", "TimeToFull", g_variant_new_int64(0));
+    g_variant_builder_add(&b, "{sv}", "PowerSupply", g_variant_new_boolean(s.power_supply));
+    return g_variant_new("(@a{sv})", g_variant_builder_end(&b));
+  }
+
+  void add_enumerate(UPowerLog& log, guint64 time, std::vector<const char*> paths)
+  {
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE("ao"));
+    for (const auto& path : paths)
+      g_variant_builder_add(&b, "o", path);
+    log.add_call(time, UPOWER, UPOWER_PATH, UPOWER, "EnumerateDevices",
+                 nullptr, g_variant_new("(@ao)", g_variant_builder_end(&b)));
+  }
+
+  void add_get_all(UPowerLog& log, guint64 time, const char * path, const DeviceState& s)
+  {
+    log.add_call(time, UPOWER, path, PROPERTIES_IFACE, "GetAll",
+                 g_variant_new("(s)", DEVICE_IFACE), get_all_reply(s));
+  }
+
+  void add_percentage_changed(UPowerLog& log, guint64 time, const char * path, double percentage)
+  {
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&b, "{sv}", "Percentage", g_variant_new_double(percentage));
+    log.add_signal(time, UPOWER, path, PROPERTIES_IFACE, "PropertiesChanged",
+                   g_variant_new("(s@a{sv}@as)", DEVICE_IFACE, g_variant_builder_end(&b), g_variant_new_strv(nullptr, 0)));
+  }
+
+  void add_device_signal(UPowerLog& log, guint64 time, const char * member, const char * path)
+  {
+    log.add_signal(time, UPOWER, UPOWER_PATH, UPOWER, member, g_variant_new("(o)", path));
+  }
+
+  void add_prepare_for_sleep(UPowerLog& log, guint64 time, bool going_to_sleep)
+  {
+    log.add_signal(time, "org.freedesktop.login1", "/org/freedesktop/login1",
+                   "org.freedesktop.login1.Manager", "PrepareForSleep",
+                   g_variant_new("(b)", gboolean(going_to_sleep)));
+  }
+
+  /* The devices as of the end of the log:
+     the last enumeration, and each device's last GetAll */
+  std::map<std::string,DeviceState> get_final_state(const UPowerLog& log)
+  {
+    std::map<std::string,DeviceState> devices;
+    std::map<std::string,GVariant*> get_all;
+    GVariant * enumerated = nullptr;
+
+    for (const auto& r : log.records())
+      {
+        if (r.kind != UPowerLog::CALL)
+          continue;
+        if (r.member == "EnumerateDevices")
+          enumerated = r.reply;
+        else if (r.member == "GetAll")
+          get_all[r.path] = r.reply;
+      }
+
+    if (enumerated == nullptr)
+      return devices;
+
+    GVariantIter * iter = nullptr;
+    const char * path = nullptr;
+    g_variant_get(enumerated, "(ao)", &iter);
+    while (g_variant_iter_loop(iter, "&o", &path))
+      {
+        // the provider skips these
+        if (!g_strcmp0(path, DISPLAY_DEVICE) || g_str_has_suffix(path, "batt_therm"))
+          continue;
+
+        auto it = get_all.find(path);
+        if (it == get_all.end())
+          continue;
+
+        guint32 kind = 0;
+        guint32 state = 0;
+        gboolean power_supply = FALSE;
+        DeviceState s {};
+        auto dict = g_variant_get_child_value(it->second, 0);
+        g_variant_lookup(dict, "Type", "u", &kind);
+        g_variant_lookup(dict, "State", "u", &state);
+        g_variant_lookup(dict, "Percentage", "d", &s.percentage);
+        g_variant_lookup(dict, "PowerSupply", "b", &power_supply);
+        g_variant_unref(dict);
+        s.kind = UpDeviceKind(kind);
+        s.state = UpDeviceState(state);
+        s.power_supply = power_supply;
+        devices[path] = s;
+      }
+    g_variant_iter_free(iter);
+
+    return devices;
+  }
+}
+
+/***
+****
+***/
+
+class UPowerProviderFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+  static void on_replay_done(GDBusConnection * connection G_GNUC_UNUSED,
+                             const gchar     * sender     G_GNUC_UNUSED,
+                             const gchar     * path       G_GNUC_UNUSED,
+                             const gchar     * iface      G_GNUC_UNUSED,
+                             const gchar     * member     G_GNUC_UNUSED,
+                             GVariant        * parameters G_GNUC_UNUSED,
+                             gpointer          gself)
+  {
+    static_cast<UPowerProviderFixture*>(gself)->done_time = g_get_monotonic_time();
+  }
+
+protected:
+
+  GTestDBus * test_dbus = nullptr;
+  GDBusConnection * upower_bus = nullptr;
+  GDBusConnection * client_bus = nullptr;
+  gint64 done_time = 0;
+
+  struct Result
+  {
+    std::map<std::string,DeviceState> devices;
+    size_t n_signals;
+    size_t n_unanswered;
+    double signals_per_sec;
+  };
+
+  GDBusConnection * connect()
+  {
+    GError * error = nullptr;
+    auto connection = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(test_dbus),
+      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+      nullptr, nullptr, &error);
+    EXPECT_EQ(nullptr, error);
+    g_clear_error(&error);
+    return connection;
+  }
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+
+    upower_bus = connect();
+    client_bus = connect();
+  }
+
+  virtual void TearDown()
+  {
+    g_dbus_connection_close_sync(client_bus, nullptr, nullptr);
+    g_dbus_connection_close_sync(upower_bus, nullptr, nullptr);
+    g_clear_object(&client_bus);
+    g_clear_object(&upower_bus);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  size_t count_devices(IndicatorPowerDeviceProvider * provider)
+  {
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    const size_t n = g_list_length(devices);
+    g_list_free_full(devices, g_object_unref);
+    return n;
+  }
+
+  std::map<std::string,DeviceState> get_devices(IndicatorPowerDeviceProvider * provider)
+  {
+    std::map<std::string,DeviceState> ret;
+
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    for (auto l=devices; l!=nullptr; l=l->next)
+      {
+        auto device = INDICATOR_POWER_DEVICE(l->data);
+        ret[indicator_power_device_get_object_path(device)] = DeviceState {
+          indicator_power_device_get_kind(device),
+          indicator_power_device_get_state(device),
+          indicator_power_device_get_percentage(device),
+          bool(indicator_power_device_get_power_supply(device))
+        };
+      }
+    g_list_free_full(devices, g_object_unref);
+
+    return ret;
+  }
+
+  /* Starts a provider against the log, waits for it to have the first
+     enumeration's devices, then replays the rest of the log.
+     speed is as in UPowerReplay::start() */
+  Result replay(const UPowerLog& log, double speed)
+  {
+    Result result {};
+    UPowerReplay upower(upower_bus, log);
+    auto provider = indicator_power_device_provider_upower_new_for_bus(client_bus);
+
+    size_t n_initial = 0;
+    for (const auto& r : log.records())
+      {
+        if (r.member != "EnumerateDevices")
+          continue;
+        GVariant * paths = g_variant_get_child_value(r.reply, 0);
+        GVariantIter iter;
+        const char * path;
+        g_variant_iter_init(&iter, paths);
+        while (g_variant_iter_loop(&iter, "&o", &path))
+          if (g_strcmp0(path, DISPLAY_DEVICE) && !g_str_has_suffix(path, "batt_therm"))
+            ++n_initial;
+        g_variant_unref(paths);
+        break;
+      }
+    for (int i=0; i<500 && count_devices(provider)<n_initial; ++i)
+      wait_msec(10);
+    EXPECT_EQ(n_initial, count_devices(provider));
+
+    const auto subscription = g_dbus_connection_signal_subscribe(client_bus, nullptr,
+                                                                 UPowerReplay::DONE_IFACE,
+                                                                 UPowerReplay::DONE_MEMBER,
+                                                                 UPowerReplay::DONE_PATH,
+                                                                 nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 on_replay_done, this, nullptr);
+
+    // AddMatch isn't acknowledged, so make a round trip to be sure it's in place
+    auto id = g_dbus_connection_call_sync(client_bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                          "org.freedesktop.DBus", "GetId", nullptr, nullptr,
+                                          G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+    g_clear_pointer(&id, g_variant_unref);
+
+    done_time = 0;
+    upower.start(speed);
+    while (done_time == 0)
+      g_main_context_iteration(nullptr, TRUE);
+    g_dbus_connection_signal_unsubscribe(client_bus, subscription);
+
+    const double secs = (done_time - upower.start_time()) / double(G_USEC_PER_SEC);
+    result.n_signals = upower.n_signals();
+    result.signals_per_sec = secs > 0 ? result.n_signals / secs : 0;
+
+    // let anything the signals queued up finish; the provider batches for 500 ms
+    wait_msec(1000);
+
+    result.devices = get_devices(provider);
+    result.n_unanswered = upower.n_calls_unanswered();
+
+    g_object_unref(provider);
+    return result;
+  }
+
+  void expect_devices(const std::map<std::string,DeviceState>& expected,
+                      const std::map<std::string,DeviceState>& actual)
+  {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (const auto& kv : expected)
+      {
+        auto it = actual.find(kv.first);
+        ASSERT_NE(actual.end(), it) << kv.first;
+        EXPECT_EQ(kv.second.kind, it->second.kind) << kv.first;
+        EXPECT_EQ(kv.second.state, it->second.state) << kv.first;
+        EXPECT_DOUBLE_EQ(kv.second.percentage, it->second.percentage) << kv.first;
+        EXPECT_EQ(kv.second.power_supply, it->second.power_supply) << kv.first;
+      }
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(UPowerProviderFixture, EnumeratesDevices)
+{
+  const DeviceState battery { UP_DEVICE_KIND_BATTERY, UP_DEVICE_STATE_DISCHARGING, 52.0, true };
+  const DeviceState line_power { UP_DEVICE_KIND_LINE_POWER, UP_DEVICE_STATE_UNKNOWN, 0.0, true };
+
+  UPowerLog log;
+  add_enumerate(log, 0, { BAT0, AC, DISPLAY_DEVICE });
+  add_get_all(log, 1000, BAT0, battery);
+  add_get_all(log, 2000, AC, line_power);
+
+  auto result = replay(log, 0);
+  expect_devices({ { BAT0, battery }, { AC, line_power } }, result.devices);
+
+  // the display device is never asked about
+  EXPECT_EQ(0u, result.n_unanswered);
+}
+
+TEST_F(UPowerProviderFixture, AppliesPropertiesChangedInOrder)
+{
+  const DeviceState battery { UP_DEVICE_KIND_BATTERY, UP_DEVICE_STATE_DISCHARGING, 100.0, true };
+  const int n_changes = 1000;
+
+  UPowerLog log;
+  add_enumerate(log, 0, { BAT0 });
+  add_get_all(log, 1000, BAT0, battery);
+  for (int i=1; i<=n_changes; ++i)
+    add_percentage_changed(log, i * 10000, BAT0, 100.0 - i / double(n_changes / 50));
+
+  auto result = replay(log, 0);
+  auto expected = battery;
+  expected.percentage = 50.0;
+  expect_devices({ { BAT0, expected } }, result.devices);
+  EXPECT_EQ(size_t(n_changes), result.n_signals);
+
+  std::cout << "PropertiesChanged: " << int(result.signals_per_sec) << " signals/s" << std::endl;
+}
+
+TEST_F(UPowerProviderFixture, DevicesComeAndGo)
+{
+  const DeviceState battery { UP_DEVICE_KIND_BATTERY, UP_DEVICE_STATE_CHARGING, 80.0, true };
+  const DeviceState line_power { UP_DEVICE_KIND_LINE_POWER, UP_DEVICE_STATE_UNKNOWN, 0.0, true };
+  const DeviceState mouse { UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_DISCHARGING, 30.0, false };
+
+  UPowerLog log;
+  add_enumerate(log, 0, { BAT0, AC });
+  add_get_all(log, 1000, BAT0, battery);
+  add_get_all(log, 2000, AC, line_power);
+  add_device_signal(log, 1*SEC, "DeviceAdded", MOUSE);
+  add_get_all(log, 1*SEC + 1000, MOUSE, mouse);
+  add_device_signal(log, 2*SEC, "DeviceRemoved", AC);
+
+  auto result = replay(log, 10.0);
+  expect_devices({ { BAT0, battery }, { MOUSE, mouse } }, result.devices);
+  EXPECT_EQ(0u, result.n_unanswered);
+}
+
+TEST_F(UPowerProviderFixture, ResumeRefreshesDevices)
+{
+  const DeviceState before { UP_DEVICE_KIND_BATTERY, UP_DEVICE_STATE_DISCHARGING, 80.0, true };
+  const DeviceState after { UP_DEVICE_KIND_BATTERY, UP_DEVICE_STATE_DISCHARGING, 30.0, true };
+  const DeviceState mouse { UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_DISCHARGING, 60.0, false };
+  const DeviceState mouse_after { UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_DISCHARGING, 55.0, false };
+
+  // no PropertiesChanged: only the wakeup says that anything's changed
+  UPowerLog log;
+  add_enumerate(log, 0, { BAT0, MOUSE });
+  add_get_all(log, 1000, BAT0, before);
+  add_get_all(log, 2000, MOUSE, mouse);
+  add_prepare_for_sleep(log, 1*SEC, true);
+  add_prepare_for_sleep(log, 2*SEC, false);
+  add_get_all(log, 2*SEC + 1000, BAT0, after);
+  add_get_all(log, 2*SEC + 2000, MOUSE, mouse_after);
+
+  auto result = replay(log, 10.0);
+  expect_devices(get_final_state(log), result.devices);
+  EXPECT_EQ(30.0, result.devices[BAT0].percentage);
+  EXPECT_EQ(55.0, result.devices[MOUSE].percentage);
+}
+
+TEST_F(UPowerProviderFixture, LogRoundTrip)
+{
+  UPowerLog log;
+  add_enumerate(log, 0, { BAT0 });
+  add_get_all(log, 1000, BAT0, DeviceState { UP_DEVICE_KIND_BATTERY, UP_DEVICE_STATE_CHARGING, 10.0, true });
+  add_percentage_changed(log, 2000, BAT0, 11.0);
+
+  auto dir = g_dir_make_tmp("indicator-power-upower-log-XXXXXX", nullptr);
+  auto filename = g_build_filename(dir, "log", nullptr);
+  ASSERT_TRUE(log.save(filename, nullptr));
+
+  UPowerLog loaded;
+  ASSERT_TRUE(loaded.load(filename, nullptr));
+  ASSERT_EQ(log.records().size(), loaded.records().size());
+  for (size_t i=0; i<log.records().size(); ++i)
+    {
+      const auto& a = log.records()[i];
+      const auto& b = loaded.records()[i];
+      EXPECT_EQ(a.kind, b.kind);
+      EXPECT_EQ(a.time, b.time);
+      EXPECT_EQ(a.name, b.name);
+      EXPECT_EQ(a.path, b.path);
+      EXPECT_EQ(a.iface, b.iface);
+      EXPECT_EQ(a.member, b.member);
+      EXPECT_TRUE(g_variant_equal(a.args, b.args));
+      EXPECT_TRUE(g_variant_equal(a.reply, b.reply));
+    }
+
+  // anything else is rejected
+  ASSERT_TRUE(g_file_set_contents(filename, "not a log", -1, nullptr));
+  GError * error = nullptr;
+  EXPECT_FALSE(loaded.load(filename, &error));
+  EXPECT_NE(nullptr, error);
+  g_clear_error(&error);
+
+  g_remove(filename);
+  g_remove(dir);
+  g_free(filename);
+  g_free(dir);
+}
+
+/**
+ * Replays the captures listed in $INDICATOR_POWER_UPOWER_LOGS, separated
+ * like $PATH. $INDICATOR_POWER_UPOWER_LOG_SPEED sets the pace; the default
+ * of 0 replays as fast as possible. Record captures with upower-record.
+ */
+TEST_F(UPowerProviderFixture, FieldCaptures)
+{
+  const char * logs = g_getenv("INDICATOR_POWER_UPOWER_LOGS");
+  if (logs == nullptr || *logs == '\0')
+    {
+      std::cout << "no captures in $INDICATOR_POWER_UPOWER_LOGS; skipping" << std::endl;
+      return;
+    }
+
+  const char * speed_str = g_getenv("INDICATOR_POWER_UPOWER_LOG_SPEED");
+  const double speed = speed_str ? g_ascii_strtod(speed_str, nullptr) : 0.0;
+
+  auto filenames = g_strsplit(logs, G_SEARCHPATH_SEPARATOR_S, -1);
+  for (auto it=filenames; *it!=nullptr; ++it)
+    {
+      UPowerLog log;
+      GError * error = nullptr;
+      ASSERT_TRUE(log.load(*it, &error)) << error->message;
+
+      auto result = replay(log, speed);
+      expect_devices(get_final_state(log), result.devices);
+
+      std::cout << *it << ": " << log.records().size() << " records, "
+                << result.n_signals << " signals, "
+                << int(result.signals_per_sec) << " signals/s, "
+                << result.n_unanswered << " unanswered calls" << std::endl;
+    }
+  g_strfreev(filenames);
+}
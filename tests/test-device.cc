@@ -195,6 +195,29 @@ TEST_F(DeviceTest, Properties)
   g_object_get (o, key, &u64, NULL);
   ASSERT_EQ(u64, 30);
 
+  // ENERGY_RATE..CAPACITY
+  const struct {
+    const char * key;
+    IndicatorPowerDeviceMetric metric;
+    double value;
+  } metrics[] = {
+    { INDICATOR_POWER_DEVICE_ENERGY_RATE,        INDICATOR_POWER_DEVICE_METRIC_ENERGY_RATE,        11.5 },
+    { INDICATOR_POWER_DEVICE_ENERGY,             INDICATOR_POWER_DEVICE_METRIC_ENERGY,             32.25 },
+    { INDICATOR_POWER_DEVICE_ENERGY_FULL,        INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL,        48.0 },
+    { INDICATOR_POWER_DEVICE_ENERGY_FULL_DESIGN, INDICATOR_POWER_DEVICE_METRIC_ENERGY_FULL_DESIGN, 57.0 },
+    { INDICATOR_POWER_DEVICE_VOLTAGE,            INDICATOR_POWER_DEVICE_METRIC_VOLTAGE,            12.375 },
+    { INDICATOR_POWER_DEVICE_TEMPERATURE,        INDICATOR_POWER_DEVICE_METRIC_TEMPERATURE,        -4.5 },
+    { INDICATOR_POWER_DEVICE_CAPACITY,           INDICATOR_POWER_DEVICE_METRIC_CAPACITY,           84.25 }
+  };
+  for (const auto& metric : metrics)
+    {
+      ASSERT_EQ (0.0, indicator_power_device_get_metric (INDICATOR_POWER_DEVICE(o), metric.metric));
+      g_object_set (o, metric.key, metric.value, NULL);
+      g_object_get (o, metric.key, &d, NULL);
+      ASSERT_EQ (metric.value, d);
+      ASSERT_EQ (metric.value, indicator_power_device_get_metric (INDICATOR_POWER_DEVICE(o), metric.metric));
+    }
+
   // cleanup
   g_object_unref (o);
 }
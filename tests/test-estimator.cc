@@ -0,0 +1,231 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-provider-mock.h"
+#include "estimator.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/***
+****
+***/
+
+namespace
+{
+  struct TracePoint
+  {
+    int seconds;
+    double percentage;
+  };
+
+  // A laptop discharging at about 1% per 75 seconds, as polled
+  // every 30 seconds by UPower with integer percentages
+  const std::vector<TracePoint> discharge_trace = {
+    {0,80}, {30,80}, {60,79}, {90,79}, {120,78}, {150,78}, {180,78}, {210,77}, {240,77}, {270,77}, {300,76}, {330,76}, {360,76}, {390,75}, {420,75}, {450,74}, {480,74}, {510,74}, {540,73}, {570,73}, {600,72}, {630,72}, {660,72}, {690,71}, {720,71}, {750,70}, {780,70}, {810,70}, {840,69}, {870,69}, {900,68}, {930,68}, {960,68}, {990,67}, {1020,67}, {1050,66}, {1080,66}, {1110,66}, {1140,65}, {1170,65}, {1200,65}, {1230,64}, {1260,64}, {1290,63}, {1320,63}, {1350,63}, {1380,62}, {1410,62}, {1440,61}, {1470,61}, {1500,60}, {1530,60}, {1560,60}, {1590,59}, {1620,59}, {1650,58}, {1680,58}, {1710,58}, {1740,57}, {1770,57}
+  };
+
+  // The same, charging at about 1% per 45 seconds
+  const std::vector<TracePoint> charge_trace = {
+    {0,40}, {30,40}, {60,41}, {90,42}, {120,42}, {150,43}, {180,44}, {210,44}, {240,45}, {270,46}, {300,47}, {330,47}, {360,48}, {390,49}, {420,49}, {450,50}, {480,51}, {510,51}, {540,52}, {570,53}, {600,53}, {630,54}, {660,54}, {690,55}, {720,56}, {750,56}, {780,57}, {810,58}, {840,58}, {870,59}, {900,60}, {930,60}, {960,61}, {990,62}, {1020,62}, {1050,63}, {1080,64}, {1110,64}, {1140,65}, {1170,66}, {1200,66}, {1230,67}, {1260,68}, {1290,68}, {1320,69}, {1350,70}, {1380,70}, {1410,71}, {1440,72}, {1470,72}, {1500,73}, {1530,74}, {1560,74}, {1590,75}, {1620,76}, {1650,76}, {1680,77}, {1710,78}, {1740,78}, {1770,79}
+  };
+}
+
+class EstimatorTest: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  void replay(IndicatorPowerEstimator * estimator,
+              const std::vector<TracePoint>& trace,
+              UpDeviceState state,
+              size_t n_points = SIZE_MAX)
+  {
+    for (size_t i=0, n=std::min(n_points, trace.size()); i<n; ++i)
+      indicator_power_estimator_add_sample(estimator,
+                                           gint64(trace[i].seconds) * G_USEC_PER_SEC,
+                                           trace[i].percentage,
+                                           state);
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(EstimatorTest, NoEstimateWithoutRates)
+{
+  auto estimator = indicator_power_estimator_new();
+  EXPECT_EQ(0, indicator_power_estimator_get_time(estimator));
+  EXPECT_EQ(0.0, indicator_power_estimator_get_confidence(estimator));
+
+  // the first change only marks where the first interval starts,
+  // since we don't know how long the battery had been at 80%
+  replay(estimator, discharge_trace, UP_DEVICE_STATE_DISCHARGING, 3);
+  EXPECT_EQ(0, indicator_power_estimator_get_time(estimator));
+  EXPECT_EQ(0.0, indicator_power_estimator_get_confidence(estimator));
+
+  indicator_power_estimator_free(estimator);
+}
+
+TEST_F(EstimatorTest, DischargeTrace)
+{
+  auto estimator = indicator_power_estimator_new();
+  replay(estimator, discharge_trace, UP_DEVICE_STATE_DISCHARGING);
+
+  // 57% left at 75 seconds per percent
+  const double expected = 57 * 75;
+  EXPECT_NEAR(expected, indicator_power_estimator_get_time(estimator), expected * 0.15);
+  EXPECT_LE(0.5, indicator_power_estimator_get_confidence(estimator));
+  EXPECT_GE(1.0, indicator_power_estimator_get_confidence(estimator));
+
+  indicator_power_estimator_free(estimator);
+}
+
+TEST_F(EstimatorTest, ChargeTrace)
+{
+  auto estimator = indicator_power_estimator_new();
+  replay(estimator, charge_trace, UP_DEVICE_STATE_CHARGING);
+
+  // 21% to go at 45 seconds per percent
+  const double expected = 21 * 45;
+  EXPECT_NEAR(expected, indicator_power_estimator_get_time(estimator), expected * 0.15);
+  EXPECT_LE(0.5, indicator_power_estimator_get_confidence(estimator));
+
+  indicator_power_estimator_free(estimator);
+}
+
+TEST_F(EstimatorTest, ConfidenceGrows)
+{
+  auto estimator = indicator_power_estimator_new();
+
+  replay(estimator, discharge_trace, UP_DEVICE_STATE_DISCHARGING, 10);
+  const auto early = indicator_power_estimator_get_confidence(estimator);
+  EXPECT_LT(0.0, early);
+
+  indicator_power_estimator_reset(estimator);
+  replay(estimator, discharge_trace, UP_DEVICE_STATE_DISCHARGING);
+  EXPECT_LT(early, indicator_power_estimator_get_confidence(estimator));
+
+  indicator_power_estimator_free(estimator);
+}
+
+TEST_F(EstimatorTest, NoiseLowersConfidence)
+{
+  auto steady = indicator_power_estimator_new();
+  auto noisy = indicator_power_estimator_new();
+
+  for (int i=0; i<30; ++i)
+    {
+      indicator_power_estimator_add_sample(steady, gint64(i*60) * G_USEC_PER_SEC, 90.0 - i, UP_DEVICE_STATE_DISCHARGING);
+      indicator_power_estimator_add_sample(noisy, gint64(i*60 + (i%2 ? 40 : 0)) * G_USEC_PER_SEC, 90.0 - i, UP_DEVICE_STATE_DISCHARGING);
+    }
+
+  EXPECT_NEAR(60 * 61, indicator_power_estimator_get_time(steady), 1);
+  EXPECT_LT(indicator_power_estimator_get_confidence(noisy), indicator_power_estimator_get_confidence(steady));
+
+  indicator_power_estimator_free(noisy);
+  indicator_power_estimator_free(steady);
+}
+
+TEST_F(EstimatorTest, StateChangeResets)
+{
+  auto estimator = indicator_power_estimator_new();
+  replay(estimator, discharge_trace, UP_DEVICE_STATE_DISCHARGING);
+  EXPECT_LT(0, indicator_power_estimator_get_time(estimator));
+
+  // plugging in makes the discharge rate useless
+  indicator_power_estimator_add_sample(estimator, gint64(1800) * G_USEC_PER_SEC, 57.0, UP_DEVICE_STATE_CHARGING);
+  EXPECT_EQ(0, indicator_power_estimator_get_time(estimator));
+  EXPECT_EQ(0.0, indicator_power_estimator_get_confidence(estimator));
+
+  // and so does a full battery
+  replay(estimator, charge_trace, UP_DEVICE_STATE_CHARGING);
+  EXPECT_LT(0, indicator_power_estimator_get_time(estimator));
+  indicator_power_estimator_add_sample(estimator, gint64(3600) * G_USEC_PER_SEC, 100.0, UP_DEVICE_STATE_FULLY_CHARGED);
+  EXPECT_EQ(0, indicator_power_estimator_get_time(estimator));
+
+  indicator_power_estimator_free(estimator);
+}
+
+TEST_F(EstimatorTest, WrongWayJumpIsIgnored)
+{
+  auto estimator = indicator_power_estimator_new();
+  replay(estimator, discharge_trace, UP_DEVICE_STATE_DISCHARGING);
+  const auto before = indicator_power_estimator_get_time(estimator);
+
+  // a recalibration bumps the percentage up while discharging
+  indicator_power_estimator_add_sample(estimator, gint64(1800) * G_USEC_PER_SEC, 60.0, UP_DEVICE_STATE_DISCHARGING);
+
+  // the rate is unchanged, so only the percentage moves the estimate
+  EXPECT_NEAR(before * 60.0 / 57.0, indicator_power_estimator_get_time(estimator), 2);
+
+  indicator_power_estimator_free(estimator);
+}
+
+/***
+****  A provider that never reports time-remaining
+***/
+
+TEST_F(EstimatorTest, MockProviderDeviceGetsEstimate)
+{
+  auto provider = indicator_power_device_provider_mock_new();
+  auto battery = indicator_power_device_new("/some/path/battery",
+                                            UP_DEVICE_KIND_BATTERY,
+                                            50.0,
+                                            UP_DEVICE_STATE_DISCHARGING,
+                                            0,
+                                            TRUE);
+  indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider), battery);
+
+  EXPECT_EQ(0, indicator_power_device_get_time(battery));
+  EXPECT_EQ(0.0, indicator_power_device_get_time_confidence(battery));
+
+  // a fast trace: 1% per 100 msec
+  for (int i=1; i<=6; ++i)
+    {
+      wait_msec(100);
+      g_object_set(battery, INDICATOR_POWER_DEVICE_PERCENTAGE, 50.0 - i, nullptr);
+    }
+
+  // 44% left at 10% per second
+  auto devices = indicator_power_device_provider_get_devices(provider);
+  ASSERT_EQ(1u, g_list_length(devices));
+  auto device = INDICATOR_POWER_DEVICE(devices->data);
+  EXPECT_LE(0.5, indicator_power_device_get_time_confidence(device));
+  EXPECT_LE(2, indicator_power_device_get_time(device));
+  EXPECT_GE(8, indicator_power_device_get_time(device));
+  g_list_free_full(devices, g_object_unref);
+
+  // a reported time wins over the estimate
+  g_object_set(battery, INDICATOR_POWER_DEVICE_TIME, guint64(60*60), nullptr);
+  EXPECT_EQ(60*60, indicator_power_device_get_time(battery));
+  EXPECT_EQ(1.0, indicator_power_device_get_time_confidence(battery));
+
+  g_object_unref(battery);
+  g_object_unref(provider);
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2017 The UBports project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "flashlight.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/***
+****
+***/
+
+class FlashlightFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * leds_dir = nullptr;
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    leds_dir = g_dir_make_tmp("indicator-power-leds-XXXXXX", nullptr);
+    ASSERT_NE(nullptr, leds_dir);
+  }
+
+  virtual void TearDown()
+  {
+    remove_tree(leds_dir);
+    g_clear_pointer(&leds_dir, g_free);
+
+    super::TearDown();
+  }
+
+  static void remove_tree(const char * path)
+  {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR))
+      {
+        auto dir = g_dir_open(path, 0, nullptr);
+        const char * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+
+    g_remove(path);
+  }
+
+  void write_attr(const char * led, const char * attr, const std::string& value)
+  {
+    auto dir = g_build_filename(leds_dir, led, nullptr);
+    g_mkdir_with_parents(dir, 0700);
+    auto path = g_build_filename(dir, attr, nullptr);
+
+    // write in place, the way the kernel changes sysfs attributes
+    auto fp = fopen(path, "w");
+    ASSERT_NE(nullptr, fp);
+    fputs(value.c_str(), fp);
+    fclose(fp);
+
+    g_free(path);
+    g_free(dir);
+  }
+
+  // set the flashlight's state and wait for the write to finish
+  bool set_active(IndicatorPowerFlashlight * flashlight, gboolean active, GError ** error=nullptr)
+  {
+    struct Data { GMainLoop * loop; bool success; GError * error; } data { loop, false, nullptr };
+
+    indicator_power_flashlight_set_active_async(flashlight, active, nullptr,
+      [](GObject * o, GAsyncResult * res, gpointer gdata) {
+        auto d = static_cast<Data*>(gdata);
+        d->success = indicator_power_flashlight_set_active_finish(INDICATOR_POWER_FLASHLIGHT(o), res, &d->error);
+        g_main_loop_quit(d->loop);
+      }, &data);
+    g_main_loop_run(loop);
+
+    if (error != nullptr)
+      *error = data.error;
+    else
+      g_clear_error(&data.error);
+    return data.success;
+  }
+
+  int read_attr(const char * led, const char * attr)
+  {
+    auto path = g_build_filename(leds_dir, led, attr, nullptr);
+    gchar * contents = nullptr;
+    int ret = -1;
+    // sysfs attributes aren't truncated when rewritten, so only look at the first line
+    if (g_file_get_contents(path, &contents, nullptr, nullptr))
+      {
+        contents[strcspn(contents, "\n")] = '\0';
+        ret = atoi(contents);
+      }
+    g_free(contents);
+    g_free(path);
+    return ret;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(FlashlightFixture, NoLed)
+{
+  write_attr("input0::capslock", "brightness", "0\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  EXPECT_FALSE(indicator_power_flashlight_is_supported(flashlight));
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, KnownLedIsPreferred)
+{
+  write_attr("white:flash", "brightness", "0\n");
+  write_attr("torch-light", "brightness", "0\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+
+  EXPECT_TRUE(set_active(flashlight, TRUE));
+  EXPECT_TRUE(indicator_power_flashlight_get_active(flashlight));
+  EXPECT_EQ(255, read_attr("torch-light", "brightness"));
+  EXPECT_EQ(0, read_attr("white:flash", "brightness"));
+
+  EXPECT_TRUE(set_active(flashlight, FALSE));
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+  EXPECT_EQ(0, read_attr("torch-light", "brightness"));
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, GenericLedDiscovery)
+{
+  write_attr("input0::capslock", "brightness", "0\n");
+  write_attr("white:torch", "brightness", "0\n");
+  write_attr("white:torch", "max_brightness", "100\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+
+  // turning on is capped by the LED's max_brightness
+  EXPECT_TRUE(set_active(flashlight, TRUE));
+  EXPECT_EQ(100, read_attr("white:torch", "brightness"));
+  EXPECT_EQ(0, read_attr("input0::capslock", "brightness"));
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, OnBrightnessIsAtMost255)
+{
+  write_attr("torch-light", "brightness", "0\n");
+  write_attr("torch-light", "max_brightness", "1000\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+
+  EXPECT_TRUE(set_active(flashlight, TRUE));
+  EXPECT_EQ(255, read_attr("torch-light", "brightness"));
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, QcomSwitch)
+{
+  write_attr("led:flash_torch", "brightness", "0\n");
+  write_attr("led:switch", "brightness", "0\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+
+  EXPECT_TRUE(set_active(flashlight, TRUE));
+  EXPECT_EQ(255, read_attr("led:flash_torch", "brightness"));
+  EXPECT_EQ(1, read_attr("led:switch", "brightness"));
+
+  EXPECT_TRUE(set_active(flashlight, FALSE));
+  EXPECT_EQ(0, read_attr("led:switch", "brightness"));
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, QcomSwitchSaysIfItsOn)
+{
+  // turning it off only clears the switch, so the torch's brightness stays put
+  write_attr("led:flash_torch", "brightness", "255\n");
+  write_attr("led:switch", "brightness", "0\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+
+  // so the first tap turns it on
+  EXPECT_TRUE(set_active(flashlight, TRUE));
+  EXPECT_TRUE(indicator_power_flashlight_get_active(flashlight));
+  EXPECT_EQ(1, read_attr("led:switch", "brightness"));
+
+  // the switch is what's watched for other writers, too
+  write_attr("led:switch", "brightness", "0\n");
+  wait_for_signal(flashlight, "notify::" INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE);
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+  EXPECT_EQ(255, read_attr("led:flash_torch", "brightness"));
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, FollowsExternalChanges)
+{
+  write_attr("flashlight", "brightness", "0\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+
+  // someone else turns it on...
+  write_attr("flashlight", "brightness", "128\n");
+  wait_for_signal(flashlight, "notify::" INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE);
+  EXPECT_TRUE(indicator_power_flashlight_get_active(flashlight));
+
+  // ...and off again
+  write_attr("flashlight", "brightness", "0\n");
+  wait_for_signal(flashlight, "notify::" INDICATOR_POWER_FLASHLIGHT_PROP_ACTIVE);
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, WriteErrorsAreReported)
+{
+  // a directory can't be opened for writing, not even by root
+  auto path = g_build_filename(leds_dir, "torch-light", "brightness", nullptr);
+  g_mkdir_with_parents(path, 0700);
+  g_free(path);
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+
+  // confirm the error comes back and the state isn't changed
+  GError * error = nullptr;
+  EXPECT_FALSE(set_active(flashlight, TRUE, &error));
+  ASSERT_NE(nullptr, error);
+  EXPECT_TRUE(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED));
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+  g_clear_error(&error);
+
+  g_object_unref(flashlight);
+}
+
+TEST_F(FlashlightFixture, OneWriteAtATime)
+{
+  write_attr("torch-light", "brightness", "0\n");
+
+  auto flashlight = indicator_power_flashlight_new(leds_dir);
+  ASSERT_TRUE(indicator_power_flashlight_is_supported(flashlight));
+
+  // the state doesn't change until the write's confirmed...
+  indicator_power_flashlight_set_active_async(flashlight, TRUE, nullptr, nullptr, nullptr);
+  EXPECT_FALSE(indicator_power_flashlight_get_active(flashlight));
+
+  // ...and a second write while the first is pending is refused
+  GError * error = nullptr;
+  EXPECT_FALSE(set_active(flashlight, FALSE, &error));
+  EXPECT_TRUE(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_PENDING));
+  g_clear_error(&error);
+
+  wait_msec(200);
+  EXPECT_TRUE(indicator_power_flashlight_get_active(flashlight));
+  EXPECT_EQ(255, read_attr("torch-light", "brightness"));
+
+  g_object_unref(flashlight);
+}
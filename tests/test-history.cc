@@ -0,0 +1,251 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "history.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <cstdio>
+#include <vector>
+
+/***
+****
+***/
+
+class HistoryFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * history_dir = nullptr;
+
+  struct Sample
+  {
+    guint64 time;
+    double percentage;
+    guint32 state;
+  };
+
+  void SetUp()
+  {
+    super::SetUp();
+
+    history_dir = g_dir_make_tmp("indicator-power-history-XXXXXX", nullptr);
+    ASSERT_NE(nullptr, history_dir);
+  }
+
+  virtual void TearDown()
+  {
+    auto dir = g_dir_open(history_dir, 0, nullptr);
+    const char * name;
+    while ((name = g_dir_read_name(dir)))
+      {
+        auto path = g_build_filename(history_dir, name, nullptr);
+        g_remove(path);
+        g_free(path);
+      }
+    g_dir_close(dir);
+    g_remove(history_dir);
+    g_clear_pointer(&history_dir, g_free);
+
+    super::TearDown();
+  }
+
+  std::vector<Sample> get_samples(IndicatorPowerHistory * history, const char * device_id)
+  {
+    std::vector<Sample> samples;
+
+    auto v = g_variant_ref_sink(indicator_power_history_get_samples(history, device_id));
+    EXPECT_TRUE(g_variant_is_of_type(v, G_VARIANT_TYPE("a(tdu)")));
+
+    GVariantIter iter;
+    Sample s;
+    g_variant_iter_init(&iter, v);
+    while (g_variant_iter_next(&iter, "(tdu)", &s.time, &s.percentage, &s.state))
+      samples.push_back(s);
+
+    g_variant_unref(v);
+    return samples;
+  }
+
+  size_t count_files()
+  {
+    size_t n = 0;
+    auto dir = g_dir_open(history_dir, 0, nullptr);
+    if (dir != nullptr)
+      {
+        while (g_dir_read_name(dir))
+          ++n;
+        g_dir_close(dir);
+      }
+    return n;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(HistoryFixture, UnknownDeviceIsEmpty)
+{
+  auto history = indicator_power_history_new(history_dir);
+
+  EXPECT_TRUE(get_samples(history, "/org/freedesktop/UPower/devices/battery_BAT0").empty());
+  EXPECT_TRUE(get_samples(history, "").empty());
+
+  // asking about a device doesn't create a file for it
+  EXPECT_EQ(0u, count_files());
+
+  g_object_unref(history);
+}
+
+TEST_F(HistoryFixture, SamplesAreOldestFirst)
+{
+  const char * device_id = "/org/freedesktop/UPower/devices/battery_BAT0";
+  auto history = indicator_power_history_new(history_dir);
+
+  indicator_power_history_add_sample(history, device_id, 1000, 80.0, UP_DEVICE_STATE_DISCHARGING, 0.0);
+  indicator_power_history_add_sample(history, device_id, 1060, 79.0, UP_DEVICE_STATE_DISCHARGING, 0.0);
+  indicator_power_history_add_sample(history, device_id, 1120, 79.5, UP_DEVICE_STATE_CHARGING, 0.0);
+
+  auto samples = get_samples(history, device_id);
+  ASSERT_EQ(3u, samples.size());
+  EXPECT_EQ(1000u, samples[0].time);
+  EXPECT_EQ(80.0, samples[0].percentage);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_DISCHARGING), samples[0].state);
+  EXPECT_EQ(1120u, samples[2].time);
+  EXPECT_EQ(79.5, samples[2].percentage);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_CHARGING), samples[2].state);
+
+  // devices don't share a history
+  EXPECT_TRUE(get_samples(history, "/org/freedesktop/UPower/devices/battery_BAT1").empty());
+
+  g_object_unref(history);
+}
+
+TEST_F(HistoryFixture, RingWrapsAround)
+{
+  const char * device_id = "/org/freedesktop/UPower/devices/battery_BAT0";
+  const guint64 n_extra = 100;
+  const guint64 n_samples = INDICATOR_POWER_HISTORY_CAPACITY + n_extra;
+  auto history = indicator_power_history_new(history_dir);
+
+  for (guint64 i=0; i<n_samples; ++i)
+    indicator_power_history_add_sample(history, device_id, i, double(i % 100), UP_DEVICE_STATE_DISCHARGING, 0.0);
+
+  // only the newest samples are kept
+  auto samples = get_samples(history, device_id);
+  ASSERT_EQ(size_t(INDICATOR_POWER_HISTORY_CAPACITY), samples.size());
+  for (size_t i=0; i<samples.size(); ++i)
+    EXPECT_EQ(n_extra + i, samples[i].time);
+
+  g_object_unref(history);
+}
+
+TEST_F(HistoryFixture, PersistsAcrossRestarts)
+{
+  const char * device_id = "/org/freedesktop/UPower/devices/battery_BAT0";
+  const guint64 n_samples = INDICATOR_POWER_HISTORY_CAPACITY + 10;
+
+  auto history = indicator_power_history_new(history_dir);
+  for (guint64 i=0; i<n_samples; ++i)
+    indicator_power_history_add_sample(history, device_id, i, 50.0, UP_DEVICE_STATE_CHARGING, 0.0);
+  auto before = get_samples(history, device_id);
+  g_object_unref(history);
+
+  // one file per device
+  EXPECT_EQ(1u, count_files());
+
+  history = indicator_power_history_new(history_dir);
+  auto after = get_samples(history, device_id);
+  ASSERT_EQ(before.size(), after.size());
+  for (size_t i=0; i<after.size(); ++i)
+    {
+      EXPECT_EQ(before[i].time, after[i].time);
+      EXPECT_EQ(before[i].percentage, after[i].percentage);
+      EXPECT_EQ(before[i].state, after[i].state);
+    }
+
+  // new samples go after the reloaded ones
+  indicator_power_history_add_sample(history, device_id, n_samples, 51.0, UP_DEVICE_STATE_CHARGING, 0.0);
+  after = get_samples(history, device_id);
+  ASSERT_EQ(size_t(INDICATOR_POWER_HISTORY_CAPACITY), after.size());
+  EXPECT_EQ(n_samples, after.back().time);
+  EXPECT_EQ(before[1].time, after.front().time);
+
+  g_object_unref(history);
+}
+
+TEST_F(HistoryFixture, CorruptFileIsReset)
+{
+  const char * device_id = "battery";
+  auto path = g_build_filename(history_dir, device_id, nullptr);
+  ASSERT_TRUE(g_file_set_contents(path, "this is not a history file", -1, nullptr));
+  g_free(path);
+
+  auto history = indicator_power_history_new(history_dir);
+  EXPECT_TRUE(get_samples(history, device_id).empty());
+
+  indicator_power_history_add_sample(history, device_id, 1, 10.0, UP_DEVICE_STATE_CHARGING, 0.0);
+  EXPECT_EQ(1u, get_samples(history, device_id).size());
+
+  g_object_unref(history);
+}
+
+TEST_F(HistoryFixture, RecordOnlyKeepsChanges)
+{
+  const char * device_id = "/org/freedesktop/UPower/devices/battery_BAT0";
+  auto history = indicator_power_history_new(history_dir);
+
+  auto battery = indicator_power_device_new(device_id, UP_DEVICE_KIND_BATTERY, 50.0, UP_DEVICE_STATE_DISCHARGING, 60*60, TRUE);
+  EXPECT_TRUE(indicator_power_history_record(history, battery));
+
+  // nothing changed
+  EXPECT_FALSE(indicator_power_history_record(history, battery));
+
+  // a changed percentage is rate-limited...
+  g_object_set(battery, INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0, nullptr);
+  EXPECT_FALSE(indicator_power_history_record(history, battery));
+
+  // ...but a changed state is not
+  g_object_set(battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  EXPECT_TRUE(indicator_power_history_record(history, battery));
+
+  auto samples = get_samples(history, device_id);
+  ASSERT_EQ(2u, samples.size());
+  EXPECT_EQ(50.0, samples[0].percentage);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_DISCHARGING), samples[0].state);
+  EXPECT_EQ(49.0, samples[1].percentage);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_CHARGING), samples[1].state);
+
+  // line power has no history
+  auto line_power = indicator_power_device_new("/org/freedesktop/UPower/devices/line_power_AC", UP_DEVICE_KIND_LINE_POWER, 0.0, UP_DEVICE_STATE_UNKNOWN, 0, TRUE);
+  EXPECT_FALSE(indicator_power_history_record(history, line_power));
+
+  g_object_unref(line_power);
+  g_object_unref(battery);
+  g_object_unref(history);
+}
@@ -0,0 +1,583 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-shared.h"
+#include "device.h"
+#include "device-provider-mock.h"
+#include "service.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+/**
+ * Runs the service against a mock provider on a private bus and watches
+ * its menus and actions the way a panel would, counting the org.gtk.Menus
+ * and org.gtk.Actions bytes that each device update puts on the wire.
+ *
+ * The budgets are ceilings, not targets: lower them as updates get smaller.
+ * INDICATOR_POWER_MAX_UPDATE_BYTES overrides them all, e.g. to measure.
+ */
+
+namespace
+{
+  const char * const MENUS_IFACE = "org.gtk.Menus";
+  const char * const ACTIONS_IFACE = "org.gtk.Actions";
+  const char * const DESKTOP_MENU_PATH = BUS_PATH "/desktop";
+
+  const char * const BAT0 = "/org/freedesktop/UPower/devices/battery_BAT0";
+  const char * const AC = "/org/freedesktop/UPower/devices/line_power_AC";
+
+  /* a laptop with a battery and a charger */
+  const size_t SMALL_UPDATE_BUDGET = 8 * 1024;
+
+  /* ...plus a few dozen peripherals */
+  const size_t N_PERIPHERALS = 24;
+  const size_t LARGE_UPDATE_BUDGET = 32 * 1024;
+
+  size_t get_budget(size_t fallback)
+  {
+    const char * str = g_getenv("INDICATOR_POWER_MAX_UPDATE_BYTES");
+    return str != nullptr ? size_t(g_ascii_strtoull(str, nullptr, 10)) : fallback;
+  }
+
+  void remove_tree(const char * path)
+  {
+    GDir * dir = g_dir_open(path, 0, nullptr);
+    if (dir != nullptr)
+      {
+        const char * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+    g_remove(path);
+  }
+
+  /* A printout of a menu and everything linked from it.
+     If keep isn't null, the linked models are kept there so that
+     their groups stay subscribed, like a panel keeps them */
+  void dump(GMenuModel * model, std::string& out, std::set<GMenuModel*> * keep, int depth=0)
+  {
+    const std::string indent(size_t(depth) * 2, ' ');
+    const int n = g_menu_model_get_n_items(model);
+
+    for (int i=0; i<n; ++i)
+      {
+        // sorted, since the order they're iterated in isn't specified
+        std::map<std::string,std::string> attributes;
+        const char * name;
+        GVariant * value;
+        auto attrs = g_menu_model_iterate_item_attributes(model, i);
+        while (g_menu_attribute_iter_get_next(attrs, &name, &value))
+          {
+            auto printed = g_variant_print(value, TRUE);
+            attributes[name] = printed;
+            g_free(printed);
+            g_variant_unref(value);
+          }
+        g_object_unref(attrs);
+
+        out += indent + "item";
+        for (const auto& kv : attributes)
+          out += ' ' + kv.first + '=' + kv.second;
+        out += '\n';
+
+        GMenuModel * link;
+        auto links = g_menu_model_iterate_item_links(model, i);
+        while (g_menu_link_iter_get_next(links, &name, &link))
+          {
+            out += indent + name + ":\n";
+            dump(link, out, keep, depth+1);
+
+            if (keep != nullptr && !keep->count(link))
+              keep->insert(link);
+            else
+              g_object_unref(link);
+          }
+        g_object_unref(links);
+      }
+  }
+}
+
+/***
+****
+***/
+
+class MenuWireCostFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+  /* runs in GDBus' worker thread */
+  static GDBusMessage * on_panel_message(GDBusConnection * connection G_GNUC_UNUSED,
+                                         GDBusMessage    * message,
+                                         gboolean          incoming,
+                                         gpointer          gself)
+  {
+    if (incoming && (g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_SIGNAL))
+      {
+        const char * iface = g_dbus_message_get_interface(message);
+
+        if (!g_strcmp0(iface, MENUS_IFACE) || !g_strcmp0(iface, ACTIONS_IFACE))
+          {
+            auto self = static_cast<MenuWireCostFixture*>(gself);
+            gsize size = 0;
+            auto blob = g_dbus_message_to_blob(message, &size, G_DBUS_CAPABILITY_FLAGS_NONE, nullptr);
+            g_free(blob);
+
+            const char * path = g_dbus_message_get_path(message);
+            self->n_messages += 1;
+            self->n_bytes += size;
+            if (!g_strcmp0(path, BUS_PATH))
+              self->n_action_bytes += size;
+            else if (!g_strcmp0(path, BUS_HEADER_PATH))
+              self->n_header_bytes += size;
+            else if (!g_strcmp0(path, BUS_ACTIONS_PATH))
+              self->n_headerless_bytes += size;
+          }
+      }
+
+    return message;
+  }
+
+protected:
+
+  static GTestDBus * test_dbus;
+  static gchar * home_dir;
+
+  GDBusConnection * panel_bus = nullptr;
+  guint filter_id = 0;
+  std::atomic<size_t> n_messages { 0 };
+  std::atomic<size_t> n_bytes { 0 };
+  std::atomic<size_t> n_action_bytes { 0 };
+  std::atomic<size_t> n_header_bytes { 0 };
+  std::atomic<size_t> n_headerless_bytes { 0 };
+
+  IndicatorPowerDeviceProvider * provider = nullptr;
+  IndicatorPowerService * service = nullptr;
+  IndicatorPowerDevice * battery = nullptr;
+  GSettings * settings = nullptr;
+
+  /* what the panel's watching */
+  GMenuModel * menu = nullptr;
+  GActionGroup * actions = nullptr;
+  std::set<GMenuModel*> submenus;
+
+  struct Traffic
+  {
+    size_t messages;
+    size_t bytes;
+    size_t action_bytes; /* the part that went to BUS_PATH */
+    size_t header_bytes; /* ...to BUS_HEADER_PATH */
+    size_t headerless_bytes; /* ...and to BUS_ACTIONS_PATH */
+
+    /* what a panel watching BUS_PATH's actions got */
+    size_t legacy_bytes() const { return bytes - header_bytes - headerless_bytes; }
+
+    /* what a panel watching BUS_HEADER_PATH and BUS_ACTIONS_PATH got */
+    size_t opted_in_bytes() const { return bytes - action_bytes; }
+  };
+
+  static void SetUpTestCase()
+  {
+    // keep the service's cache and history out of the real home
+    home_dir = g_dir_make_tmp("indicator-power-wire-cost-XXXXXX", nullptr);
+    g_setenv("HOME", home_dir, TRUE);
+    auto cache_dir = g_build_filename(home_dir, "cache", nullptr);
+    g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+    g_free(cache_dir);
+
+    // the service and the panel share a private bus. The brightness
+    // code looks for powerd on the system bus, so point that there too
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), TRUE);
+  }
+
+  static void TearDownTestCase()
+  {
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    remove_tree(home_dir);
+    g_clear_pointer(&home_dir, g_free);
+  }
+
+  void SetUp()
+  {
+    // use our own schema, with settings that don't touch the real config
+    g_setenv("GSETTINGS_SCHEMA_DIR", SCHEMA_DIR, TRUE);
+    g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+
+    super::SetUp();
+
+    settings = g_settings_new("org.ayatana.indicator.power");
+
+    battery = indicator_power_device_new(BAT0, UP_DEVICE_KIND_BATTERY, 50.0, UP_DEVICE_STATE_DISCHARGING, 60*60, TRUE);
+    auto ac = indicator_power_device_new(AC, UP_DEVICE_KIND_LINE_POWER, 0.0, UP_DEVICE_STATE_UNKNOWN, 0, TRUE);
+    provider = indicator_power_device_provider_mock_new();
+    add_device(battery);
+    add_device(ac);
+    g_object_unref(ac);
+
+    service = indicator_power_service_new(provider);
+    wait_for_signal(service, "notify::bus");
+
+    GError * error = nullptr;
+    panel_bus = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(test_dbus),
+      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+      nullptr, nullptr, &error);
+    ASSERT_EQ(nullptr, error);
+    filter_id = g_dbus_connection_add_filter(panel_bus, on_panel_message, this, nullptr);
+
+    menu = G_MENU_MODEL(g_dbus_menu_model_get(panel_bus, BUS_NAME, DESKTOP_MENU_PATH));
+    actions = G_ACTION_GROUP(g_dbus_action_group_get(panel_bus, BUS_NAME, BUS_PATH));
+    g_strfreev(g_action_group_list_actions(actions)); // subscribes
+    for (int i=0; i<250 && !g_action_group_has_action(actions, "_header"); ++i)
+      wait_msec(20);
+    ASSERT_TRUE(g_action_group_has_action(actions, "_header"));
+    load(menu, &submenus);
+  }
+
+  virtual void TearDown()
+  {
+    for (auto& submenu : submenus)
+      g_object_unref(submenu);
+    submenus.clear();
+    g_clear_object(&menu);
+    g_clear_object(&actions);
+
+    g_dbus_connection_remove_filter(panel_bus, filter_id);
+    g_dbus_connection_close_sync(panel_bus, nullptr, nullptr);
+    g_clear_object(&panel_bus);
+
+    g_clear_object(&service);
+    g_clear_object(&provider);
+    g_clear_object(&battery);
+
+    // the memory backend outlives the test
+    g_settings_reset(settings, "show-time");
+    g_clear_object(&settings);
+
+    // let the service's connection wind down before the next test
+    wait_msec(100);
+
+    super::TearDown();
+  }
+
+  void add_device(IndicatorPowerDevice * device)
+  {
+    indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider), device);
+  }
+
+  /* Waits for a menu and everything linked from it to finish loading */
+  std::string load(GMenuModel * model, std::set<GMenuModel*> * keep)
+  {
+    std::string prev;
+    std::string cur;
+
+    for (int i=0; i<250; ++i)
+      {
+        cur.clear();
+        dump(model, cur, keep);
+        if (!cur.empty() && cur == prev)
+          break;
+        prev = cur;
+        wait_msec(20);
+      }
+
+    return cur;
+  }
+
+  /* Waits until the panel has seen everything the service sent */
+  void settle()
+  {
+    // the exporters batch their changes in idles on this thread
+    while (g_main_context_iteration(nullptr, FALSE))
+      ;
+
+    // the bus keeps the service's messages in order, so once its reply
+    // to this has come back, so has everything it sent before
+    auto reply = g_dbus_connection_call_sync(panel_bus, BUS_NAME, BUS_PATH,
+                                             "org.freedesktop.DBus.Peer", "Ping",
+                                             nullptr, nullptr,
+                                             G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+    g_clear_pointer(&reply, g_variant_unref);
+
+    while (g_main_context_iteration(nullptr, FALSE))
+      ;
+  }
+
+  Traffic measure(const std::function<void()>& update)
+  {
+    settle();
+    n_messages = 0;
+    n_bytes = 0;
+    n_action_bytes = 0;
+    n_header_bytes = 0;
+    n_headerless_bytes = 0;
+
+    update();
+    settle();
+
+    return Traffic { n_messages, n_bytes, n_action_bytes, n_header_bytes, n_headerless_bytes };
+  }
+
+  void report(const char * name, const Traffic& traffic)
+  {
+    std::cout << name << ": " << traffic.messages << " messages, "
+              << traffic.bytes << " bytes" << std::endl;
+  }
+
+  /* The panel's copy of the menus and actions should match both
+     the service's own state and what a newly-started panel sees */
+  void expect_consistent()
+  {
+    settle();
+
+    // the service's own state
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    auto primary = indicator_power_service_choose_primary_device(devices);
+    const guint32 expected_level = primary != nullptr ? guint32(indicator_power_device_get_percentage(primary) + 0.5) : 0;
+    g_clear_object(&primary);
+    g_list_free_full(devices, g_object_unref);
+
+    auto level = g_action_group_get_action_state(actions, "battery-level");
+    ASSERT_NE(nullptr, level);
+    EXPECT_EQ(expected_level, g_variant_get_uint32(level));
+    g_variant_unref(level);
+
+    // the actions, as a newly-started panel sees them
+    auto described = g_dbus_connection_call_sync(panel_bus, BUS_NAME, BUS_PATH,
+                                                 ACTIONS_IFACE, "DescribeAll", nullptr,
+                                                 G_VARIANT_TYPE("(a{s(bgav)})"),
+                                                 G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+    ASSERT_NE(nullptr, described);
+    GVariantIter * iter = nullptr;
+    const char * name = nullptr;
+    GVariant * state = nullptr;
+    g_variant_get(described, "(a{s(bgav)})", &iter);
+    while (g_variant_iter_loop(iter, "{&s(bg@av)}", &name, nullptr, nullptr, &state))
+      {
+        auto remote = g_action_group_get_action_state(actions, name);
+        if (g_variant_n_children(state) == 0)
+          {
+            EXPECT_EQ(nullptr, remote) << name;
+          }
+        else
+          {
+            auto expected = g_variant_get_child_value(state, 0);
+            auto actual = g_variant_get_variant(expected);
+            ASSERT_NE(nullptr, remote) << name;
+            EXPECT_TRUE(g_variant_equal(actual, remote)) << name;
+            g_variant_unref(actual);
+            g_variant_unref(expected);
+          }
+        g_clear_pointer(&remote, g_variant_unref);
+      }
+    g_variant_iter_free(iter);
+    g_variant_unref(described);
+
+    // the menu, as a newly-started panel sees it
+    GError * error = nullptr;
+    auto fresh_bus = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(test_dbus),
+      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+      nullptr, nullptr, &error);
+    ASSERT_EQ(nullptr, error);
+    auto fresh_menu = G_MENU_MODEL(g_dbus_menu_model_get(fresh_bus, BUS_NAME, DESKTOP_MENU_PATH));
+    std::set<GMenuModel*> fresh_submenus;
+    const auto expected_menu = load(fresh_menu, &fresh_submenus);
+    std::string actual_menu;
+    dump(menu, actual_menu, nullptr);
+    EXPECT_EQ(expected_menu, actual_menu);
+
+    for (auto& submenu : fresh_submenus)
+      g_object_unref(submenu);
+    g_object_unref(fresh_menu);
+    g_dbus_connection_close_sync(fresh_bus, nullptr, nullptr);
+    g_object_unref(fresh_bus);
+  }
+};
+
+GTestDBus * MenuWireCostFixture::test_dbus = nullptr;
+gchar * MenuWireCostFixture::home_dir = nullptr;
+
+/***
+****
+***/
+
+TEST_F(MenuWireCostFixture, PanelMatchesService)
+{
+  EXPECT_FALSE(submenus.empty());
+  expect_consistent();
+}
+
+TEST_F(MenuWireCostFixture, PercentageUpdate)
+{
+  auto traffic = measure([this](){
+    g_object_set(battery, INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0, nullptr);
+  });
+  report("percentage update", traffic);
+
+  EXPECT_LT(0u, traffic.messages);
+  EXPECT_GE(get_budget(SMALL_UPDATE_BUDGET), traffic.bytes);
+  expect_consistent();
+}
+
+TEST_F(MenuWireCostFixture, TimeLeftUpdate)
+{
+  // with show-time on, each minute changes the header's label
+  g_settings_set_boolean(settings, "show-time", TRUE);
+  settle();
+
+  auto traffic = measure([this](){
+    g_object_set(battery, INDICATOR_POWER_DEVICE_TIME, guint64(59*60), nullptr);
+  });
+  report("time-left update", traffic);
+
+  EXPECT_LT(0u, traffic.messages);
+  EXPECT_GE(get_budget(SMALL_UPDATE_BUDGET), traffic.bytes);
+  expect_consistent();
+}
+
+TEST_F(MenuWireCostFixture, PeripheralUpdate)
+{
+  std::vector<IndicatorPowerDevice*> peripherals;
+  for (size_t i=0; i<N_PERIPHERALS; ++i)
+    {
+      const UpDeviceKind kinds[] = { UP_DEVICE_KIND_MOUSE, UP_DEVICE_KIND_KEYBOARD, UP_DEVICE_KIND_PHONE, UP_DEVICE_KIND_MEDIA_PLAYER };
+      auto path = g_strdup_printf("/org/freedesktop/UPower/devices/peripheral_%zu", i);
+      auto device = indicator_power_device_new(path, kinds[i % G_N_ELEMENTS(kinds)], 80.0, UP_DEVICE_STATE_DISCHARGING, 0, FALSE);
+      add_device(device);
+      peripherals.push_back(device);
+      g_free(path);
+    }
+  indicator_power_device_provider_emit_devices_changed(provider);
+  load(menu, &submenus);
+  expect_consistent();
+
+  auto traffic = measure([&peripherals](){
+    g_object_set(peripherals.front(), INDICATOR_POWER_DEVICE_PERCENTAGE, 79.0, nullptr);
+  });
+  report("peripheral update", traffic);
+
+  EXPECT_LT(0u, traffic.messages);
+  EXPECT_GE(get_budget(LARGE_UPDATE_BUDGET), traffic.bytes);
+  expect_consistent();
+
+  for (auto& device : peripherals)
+    g_object_unref(device);
+}
+
+TEST_F(MenuWireCostFixture, HeaderActions)
+{
+  // a panel that opts in watches the header's parts separately,
+  // and the rest of the actions in a group without "_header".
+  // The filter counts each path on its own, so the fixture's panel
+  // can stand in for both kinds of panel
+  auto header = G_ACTION_GROUP(g_dbus_action_group_get(panel_bus, BUS_NAME, BUS_HEADER_PATH));
+  g_strfreev(g_action_group_list_actions(header)); // subscribes
+  auto headerless = G_ACTION_GROUP(g_dbus_action_group_get(panel_bus, BUS_NAME, BUS_ACTIONS_PATH));
+  g_strfreev(g_action_group_list_actions(headerless)); // subscribes
+  for (int i=0; i<250 && !(g_action_group_has_action(header, "icon") && g_action_group_has_action(headerless, "battery-level")); ++i)
+    wait_msec(20);
+  ASSERT_TRUE(g_action_group_has_action(header, "icon"));
+  ASSERT_TRUE(g_action_group_has_action(headerless, "battery-level"));
+  EXPECT_FALSE(g_action_group_has_action(headerless, "_header"));
+
+  g_settings_set_boolean(settings, "show-time", TRUE);
+  settle();
+
+  auto expect_same_header = [this, header](){
+    settle();
+    auto legacy = g_action_group_get_action_state(actions, "_header");
+    ASSERT_NE(nullptr, legacy);
+    for (const auto& key : { "title", "label", "accessible-desc" })
+      {
+        const char * expected = "";
+        g_variant_lookup(legacy, key, "&s", &expected);
+        auto actual = g_action_group_get_action_state(header, key);
+        ASSERT_NE(nullptr, actual) << key;
+        EXPECT_STREQ(expected, g_variant_get_string(actual, nullptr)) << key;
+        g_variant_unref(actual);
+      }
+    gboolean expected_visible = FALSE;
+    g_variant_lookup(legacy, "visible", "b", &expected_visible);
+    auto visible = g_action_group_get_action_state(header, "visible");
+    ASSERT_NE(nullptr, visible);
+    EXPECT_EQ(expected_visible, g_variant_get_boolean(visible));
+    g_variant_unref(visible);
+    auto expected_icon = g_variant_lookup_value(legacy, "icon", nullptr);
+    auto icon = g_action_group_get_action_state(header, "icon");
+    ASSERT_NE(nullptr, icon);
+    auto maybe = g_variant_get_maybe(icon);
+    auto actual_icon = maybe ? g_variant_get_variant(maybe) : nullptr;
+    EXPECT_TRUE((expected_icon == nullptr && actual_icon == nullptr) ||
+                (expected_icon != nullptr && actual_icon != nullptr && g_variant_equal(expected_icon, actual_icon)));
+    g_clear_pointer(&actual_icon, g_variant_unref);
+    g_clear_pointer(&maybe, g_variant_unref);
+    g_clear_pointer(&expected_icon, g_variant_unref);
+    g_variant_unref(icon);
+    g_variant_unref(legacy);
+  };
+  expect_same_header();
+
+  // a minute's change touches the label, but not the icon
+  auto traffic = measure([this](){
+    g_object_set(battery, INDICATOR_POWER_DEVICE_TIME, guint64(59*60), nullptr);
+  });
+  report("time-left update", traffic);
+  std::cout << "  legacy panel: " << traffic.legacy_bytes() << " bytes, "
+            << "opted-in panel: " << traffic.opted_in_bytes() << " bytes" << std::endl;
+  EXPECT_LT(0u, traffic.header_bytes);
+  EXPECT_LT(traffic.opted_in_bytes(), traffic.legacy_bytes());
+  expect_same_header();
+
+  // ...and gets the other actions' changes just the same
+  traffic = measure([this](){
+    g_object_set(battery, INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0, nullptr);
+  });
+  EXPECT_LT(0u, traffic.headerless_bytes);
+  auto level = g_action_group_get_action_state(headerless, "battery-level");
+  ASSERT_NE(nullptr, level);
+  EXPECT_EQ(49u, g_variant_get_uint32(level));
+  g_variant_unref(level);
+
+  g_object_unref(headerless);
+  g_object_unref(header);
+}
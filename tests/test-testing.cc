@@ -0,0 +1,419 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-shared.h"
+#include "device.h"
+#include "service.h"
+#include "testing.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <map>
+#include <string>
+
+/***
+****
+***/
+
+/**
+ * Runs the service and its Testing interface on a private bus
+ * and drives them over the bus the way a test harness would.
+ */
+
+namespace
+{
+  const char * const TESTING_PATH = BUS_PATH "/Testing";
+  const char * const TESTING_IFACE = "org.ayatana.indicator.power.Testing";
+  const char * const DEVICES_PATH = BUS_PATH "/devices";
+  const char * const DEVICE_IFACE = "org.ayatana.indicator.power.Device";
+  const char * const MOCK_PREFIX = "/org/ayatana/indicator/power/mock/";
+
+  struct Device
+  {
+    guint32 kind;
+    guint32 state;
+    gdouble percentage;
+    guint64 time_remaining;
+  };
+
+  void remove_tree(const char * path)
+  {
+    GDir * dir = g_dir_open(path, 0, nullptr);
+    if (dir != nullptr)
+      {
+        const char * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+    g_remove(path);
+  }
+}
+
+class TestingFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+  struct CallData
+  {
+    GMainLoop * loop;
+    GVariant * result;
+    GError * error;
+  };
+
+  static void on_call_done(GObject * o, GAsyncResult * res, gpointer gdata)
+  {
+    auto data = static_cast<CallData*>(gdata);
+    data->result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(o), res, &data->error);
+    g_main_loop_quit(data->loop);
+  }
+
+protected:
+
+  static GTestDBus * test_dbus;
+  static gchar * home_dir;
+
+  GDBusConnection * client_bus = nullptr;
+  gchar * service_name = nullptr;
+  IndicatorPowerService * service = nullptr;
+  IndicatorPowerTesting * testing = nullptr;
+
+  static void SetUpTestCase()
+  {
+    // keep the service's cache and history out of the real home
+    home_dir = g_dir_make_tmp("indicator-power-testing-XXXXXX", nullptr);
+    g_setenv("HOME", home_dir, TRUE);
+    auto cache_dir = g_build_filename(home_dir, "cache", nullptr);
+    g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+    g_free(cache_dir);
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), TRUE);
+  }
+
+  static void TearDownTestCase()
+  {
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    remove_tree(home_dir);
+    g_clear_pointer(&home_dir, g_free);
+  }
+
+  void SetUp()
+  {
+    // use our own schema, with settings that don't touch the real config
+    g_setenv("GSETTINGS_SCHEMA_DIR", SCHEMA_DIR, TRUE);
+    g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+
+    super::SetUp();
+
+    service = indicator_power_service_new(nullptr);
+    testing = indicator_power_testing_new(service);
+    wait_for_signal(service, "notify::bus");
+
+    GDBusConnection * service_bus = nullptr;
+    g_object_get(service, "bus", &service_bus, nullptr);
+    ASSERT_NE(nullptr, service_bus);
+    service_name = g_strdup(g_dbus_connection_get_unique_name(service_bus));
+    g_object_unref(service_bus);
+
+    GError * error = nullptr;
+    client_bus = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(test_dbus),
+      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+      nullptr, nullptr, &error);
+    ASSERT_EQ(nullptr, error);
+
+    set_mock_battery_enabled(true);
+  }
+
+  virtual void TearDown()
+  {
+    g_dbus_connection_close_sync(client_bus, nullptr, nullptr);
+    g_clear_object(&client_bus);
+    g_clear_pointer(&service_name, g_free);
+
+    g_clear_object(&testing);
+    g_clear_object(&service);
+
+    // let the service's connection wind down before the next test
+    wait_msec(100);
+
+    super::TearDown();
+  }
+
+  /* The service answers from this thread's main loop, so the call
+     has to be async. Returns the reply, or nullptr and sets error */
+  GVariant * call(const char * path, const char * iface, const char * method,
+                  GVariant * parameters, GError ** error = nullptr)
+  {
+    CallData data { loop, nullptr, nullptr };
+
+    g_dbus_connection_call(client_bus, service_name, path, iface, method, parameters,
+                           nullptr, G_DBUS_CALL_FLAGS_NONE, 5000, nullptr,
+                           on_call_done, &data);
+    g_main_loop_run(loop);
+
+    if (error != nullptr)
+      *error = data.error;
+    else
+      g_clear_error(&data.error);
+    return data.result;
+  }
+
+  /* Calls a Testing method that's expected to succeed */
+  GVariant * call_testing(const char * method, GVariant * parameters)
+  {
+    GError * error = nullptr;
+    auto result = call(TESTING_PATH, TESTING_IFACE, method, parameters, &error);
+    EXPECT_EQ(nullptr, error) << (error ? error->message : "");
+    g_clear_error(&error);
+    return result;
+  }
+
+  /* Calls a Testing method that's expected to fail with code */
+  void expect_testing_error(const char * method, GVariant * parameters, GDBusError code)
+  {
+    GError * error = nullptr;
+    auto result = call(TESTING_PATH, TESTING_IFACE, method, parameters, &error);
+    EXPECT_EQ(nullptr, result);
+    EXPECT_TRUE(g_error_matches(error, G_DBUS_ERROR, code)) << (error ? error->message : "no error");
+    g_clear_pointer(&result, g_variant_unref);
+    g_clear_error(&error);
+  }
+
+  void set_mock_battery_enabled(bool enabled)
+  {
+    auto result = call(TESTING_PATH, "org.freedesktop.DBus.Properties", "Set",
+                       g_variant_new("(ssv)", TESTING_IFACE, "MockBatteryEnabled", g_variant_new_boolean(enabled)));
+    ASSERT_NE(nullptr, result);
+    g_variant_unref(result);
+  }
+
+  void set_mock_device(const char * name, UpDeviceKind kind, UpDeviceState state,
+                       gdouble percentage, gint64 seconds_left)
+  {
+    auto result = call_testing("SetMockDevice",
+                               g_variant_new("(suudx)", name, guint32(kind), guint32(state), percentage, seconds_left));
+    g_clear_pointer(&result, g_variant_unref);
+  }
+
+  /* The service's exported devices, keyed by their source's object path */
+  std::map<std::string,Device> get_devices()
+  {
+    std::map<std::string,Device> devices;
+
+    auto result = call(DEVICES_PATH, "org.freedesktop.DBus.ObjectManager", "GetManagedObjects", nullptr);
+    EXPECT_NE(nullptr, result);
+    if (result == nullptr)
+      return devices;
+
+    GVariantIter * objects;
+    GVariant * ifaces;
+    g_variant_get(result, "(a{oa{sa{sv}}})", &objects);
+    while (g_variant_iter_next(objects, "{&o@a{sa{sv}}}", nullptr, &ifaces))
+      {
+        auto props = g_variant_lookup_value(ifaces, DEVICE_IFACE, G_VARIANT_TYPE_VARDICT);
+        if (props != nullptr)
+          {
+            const char * source = "";
+            Device device {};
+            g_variant_lookup(props, "Source", "&s", &source);
+            g_variant_lookup(props, "Kind", "u", &device.kind);
+            g_variant_lookup(props, "State", "u", &device.state);
+            g_variant_lookup(props, "Percentage", "d", &device.percentage);
+            g_variant_lookup(props, "TimeRemaining", "t", &device.time_remaining);
+            devices[source] = device;
+            g_variant_unref(props);
+          }
+        g_variant_unref(ifaces);
+      }
+    g_variant_iter_free(objects);
+    g_variant_unref(result);
+
+    return devices;
+  }
+
+  static std::string mock_path(const char * name)
+  {
+    return std::string(MOCK_PREFIX) + name;
+  }
+
+  static guint32 get_uint32(GVariant * dict, const char * key)
+  {
+    guint32 val = G_MAXUINT32;
+    EXPECT_TRUE(g_variant_lookup(dict, key, "u", &val)) << key;
+    return val;
+  }
+
+  static gint64 get_int64(GVariant * dict, const char * key)
+  {
+    gint64 val = -1;
+    EXPECT_TRUE(g_variant_lookup(dict, key, "x", &val)) << key;
+    return val;
+  }
+};
+
+GTestDBus * TestingFixture::test_dbus = nullptr;
+gchar * TestingFixture::home_dir = nullptr;
+
+/***
+****
+***/
+
+TEST_F(TestingFixture, SetMockDevice)
+{
+  set_mock_device("mouse", UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_DISCHARGING, 40.0, 0);
+
+  auto devices = get_devices();
+  ASSERT_EQ(1u, devices.count(mock_path("mouse")));
+  auto& mouse = devices[mock_path("mouse")];
+  EXPECT_EQ(guint32(UP_DEVICE_KIND_MOUSE), mouse.kind);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_DISCHARGING), mouse.state);
+  EXPECT_EQ(40.0, mouse.percentage);
+
+  // a second call updates the same device, clamping what's out of range
+  set_mock_device("mouse", UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_CHARGING, 140.0, 600);
+  devices = get_devices();
+  ASSERT_EQ(1u, devices.count(mock_path("mouse")));
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_CHARGING), devices[mock_path("mouse")].state);
+  EXPECT_EQ(100.0, devices[mock_path("mouse")].percentage);
+  EXPECT_EQ(600u, devices[mock_path("mouse")].time_remaining);
+
+  // unknown kinds and states are refused
+  expect_testing_error("SetMockDevice",
+                       g_variant_new("(suudx)", "mouse", guint32(UP_DEVICE_KIND_LAST), guint32(UP_DEVICE_STATE_CHARGING), 50.0, gint64(0)),
+                       G_DBUS_ERROR_INVALID_ARGS);
+  expect_testing_error("SetMockDevice",
+                       g_variant_new("(suudx)", "mouse", guint32(UP_DEVICE_KIND_MOUSE), guint32(UP_DEVICE_STATE_LAST), 50.0, gint64(0)),
+                       G_DBUS_ERROR_INVALID_ARGS);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_CHARGING), get_devices()[mock_path("mouse")].state);
+}
+
+TEST_F(TestingFixture, RemoveMockDevice)
+{
+  set_mock_device("mouse", UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_DISCHARGING, 40.0, 0);
+  set_mock_device("keyboard", UP_DEVICE_KIND_KEYBOARD, UP_DEVICE_STATE_DISCHARGING, 60.0, 0);
+  EXPECT_EQ(1u, get_devices().count(mock_path("mouse")));
+
+  auto result = call_testing("RemoveMockDevice", g_variant_new("(s)", "mouse"));
+  g_clear_pointer(&result, g_variant_unref);
+  auto devices = get_devices();
+  EXPECT_EQ(0u, devices.count(mock_path("mouse")));
+  EXPECT_EQ(1u, devices.count(mock_path("keyboard")));
+
+  // neither a name that's been removed nor one that never existed can be removed
+  expect_testing_error("RemoveMockDevice", g_variant_new("(s)", "mouse"), G_DBUS_ERROR_INVALID_ARGS);
+  expect_testing_error("RemoveMockDevice", g_variant_new("(s)", "no-such-device"), G_DBUS_ERROR_INVALID_ARGS);
+
+  // a removed name can be used again
+  set_mock_device("mouse", UP_DEVICE_KIND_MOUSE, UP_DEVICE_STATE_CHARGING, 10.0, 0);
+  devices = get_devices();
+  ASSERT_EQ(1u, devices.count(mock_path("mouse")));
+  EXPECT_EQ(10.0, devices[mock_path("mouse")].percentage);
+}
+
+TEST_F(TestingFixture, RunScenario)
+{
+  GVariantBuilder b;
+  g_variant_builder_init(&b, G_VARIANT_TYPE("a(usuudx)"));
+  g_variant_builder_add(&b, "(usuudx)", 0u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_DISCHARGING), 80.0, gint64(3600));
+  g_variant_builder_add(&b, "(usuudx)", 10u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_DISCHARGING), 79.0, gint64(3500));
+  g_variant_builder_add(&b, "(usuudx)", 20u, "mouse", guint32(UP_DEVICE_KIND_MOUSE), guint32(UP_DEVICE_STATE_DISCHARGING), 40.0, gint64(0));
+  // a step that changes nothing doesn't cause a rebuild
+  g_variant_builder_add(&b, "(usuudx)", 30u, "mouse", guint32(UP_DEVICE_KIND_MOUSE), guint32(UP_DEVICE_STATE_DISCHARGING), 40.0, gint64(0));
+
+  // as fast as possible
+  auto result = call_testing("RunScenario", g_variant_new("(@a(usuudx)d)", g_variant_builder_end(&b), 0.0));
+  ASSERT_NE(nullptr, result);
+  auto timings = g_variant_get_child_value(result, 0);
+
+  // each step that changes something is one rebuild, however many properties it sets
+  EXPECT_EQ(4u, get_uint32(timings, "updates"));
+  EXPECT_EQ(3u, get_uint32(timings, "rebuilds"));
+  EXPECT_LE(0, get_int64(timings, "elapsed-usec"));
+  const auto total = get_int64(timings, "apply-usec-total");
+  const auto max = get_int64(timings, "apply-usec-max");
+  const auto p50 = get_int64(timings, "apply-usec-p50");
+  const auto p95 = get_int64(timings, "apply-usec-p95");
+  const auto p99 = get_int64(timings, "apply-usec-p99");
+  EXPECT_LE(0, p50);
+  EXPECT_LE(p50, p95);
+  EXPECT_LE(p95, p99);
+  EXPECT_LE(p99, max);
+  EXPECT_LE(max, total);
+  EXPECT_LE(0, get_int64(timings, "lag-usec-max"));
+  g_variant_unref(timings);
+  g_variant_unref(result);
+
+  // the devices end up where the scenario left them
+  auto devices = get_devices();
+  ASSERT_EQ(1u, devices.count(mock_path("bat")));
+  EXPECT_EQ(79.0, devices[mock_path("bat")].percentage);
+  EXPECT_EQ(3500u, devices[mock_path("bat")].time_remaining);
+  ASSERT_EQ(1u, devices.count(mock_path("mouse")));
+  EXPECT_EQ(40.0, devices[mock_path("mouse")].percentage);
+}
+
+TEST_F(TestingFixture, RunScenarioInRealTime)
+{
+  GVariantBuilder b;
+  g_variant_builder_init(&b, G_VARIANT_TYPE("a(usuudx)"));
+  g_variant_builder_add(&b, "(usuudx)", 0u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_DISCHARGING), 80.0, gint64(3600));
+  g_variant_builder_add(&b, "(usuudx)", 200u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_CHARGING), 81.0, gint64(1800));
+
+  // at twice the speed, the last update is due 100 msec in
+  auto result = call_testing("RunScenario", g_variant_new("(@a(usuudx)d)", g_variant_builder_end(&b), 2.0));
+  ASSERT_NE(nullptr, result);
+  auto timings = g_variant_get_child_value(result, 0);
+  EXPECT_EQ(2u, get_uint32(timings, "updates"));
+  EXPECT_EQ(2u, get_uint32(timings, "rebuilds"));
+  EXPECT_LE(100 * 1000, get_int64(timings, "elapsed-usec"));
+  g_variant_unref(timings);
+  g_variant_unref(result);
+
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_CHARGING), get_devices()[mock_path("bat")].state);
+}
+
+TEST_F(TestingFixture, RunScenarioRefusesBadInput)
+{
+  // an invalid step anywhere refuses the whole scenario
+  GVariantBuilder b;
+  g_variant_builder_init(&b, G_VARIANT_TYPE("a(usuudx)"));
+  g_variant_builder_add(&b, "(usuudx)", 0u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_DISCHARGING), 80.0, gint64(3600));
+  g_variant_builder_add(&b, "(usuudx)", 10u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_LAST), 79.0, gint64(3500));
+  expect_testing_error("RunScenario", g_variant_new("(@a(usuudx)d)", g_variant_builder_end(&b), 0.0), G_DBUS_ERROR_INVALID_ARGS);
+  EXPECT_EQ(0u, get_devices().count(mock_path("bat")));
+
+  // mock devices are only shown with the mock battery
+  set_mock_battery_enabled(false);
+  g_variant_builder_init(&b, G_VARIANT_TYPE("a(usuudx)"));
+  g_variant_builder_add(&b, "(usuudx)", 0u, "bat", guint32(UP_DEVICE_KIND_BATTERY), guint32(UP_DEVICE_STATE_DISCHARGING), 80.0, gint64(3600));
+  expect_testing_error("RunScenario", g_variant_new("(@a(usuudx)d)", g_variant_builder_end(&b), 0.0), G_DBUS_ERROR_FAILED);
+}
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "uevent.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+namespace
+{
+  // what a laptop battery's uevent looks like
+  const std::vector<std::string> BAT0 {
+    "POWER_SUPPLY_NAME=BAT0",
+    "POWER_SUPPLY_TYPE=Battery",
+    "POWER_SUPPLY_STATUS=Discharging",
+    "POWER_SUPPLY_PRESENT=1",
+    "POWER_SUPPLY_TECHNOLOGY=Li-ion",
+    "POWER_SUPPLY_CYCLE_COUNT=312",
+    "POWER_SUPPLY_VOLTAGE_MIN_DESIGN=11400000",
+    "POWER_SUPPLY_VOLTAGE_NOW=11972000",
+    "POWER_SUPPLY_POWER_NOW=8417000",
+    "POWER_SUPPLY_ENERGY_FULL_DESIGN=57000000",
+    "POWER_SUPPLY_ENERGY_FULL=50310000",
+    "POWER_SUPPLY_ENERGY_NOW=28640000",
+    "POWER_SUPPLY_CAPACITY=56",
+    "POWER_SUPPLY_CAPACITY_LEVEL=Normal",
+    "POWER_SUPPLY_MODEL_NAME=5B10W13930",
+    "POWER_SUPPLY_MANUFACTURER=SMP",
+    "POWER_SUPPLY_SERIAL_NUMBER=  805"
+  };
+
+  std::string join(const std::vector<std::string>& props, char separator, const std::string& header="")
+  {
+    std::string buf = header;
+    if (!header.empty())
+      buf.push_back(separator);
+    for (const auto& prop : props)
+      {
+        buf += prop;
+        buf.push_back(separator);
+      }
+    return buf;
+  }
+
+  // a netlink message: an ACTION@DEVPATH header, then NUL-separated properties
+  std::string netlink_message(const char * action, const std::vector<std::string>& props)
+  {
+    const std::string devpath {"/devices/LNXSYSTM:00/LNXSYBUS:00/PNP0C0A:00/power_supply/BAT0"};
+    std::vector<std::string> all {
+      std::string("ACTION=") + action,
+      "DEVPATH=" + devpath,
+      "SUBSYSTEM=power_supply",
+      "SEQNUM=4711"
+    };
+    all.insert(all.end(), props.begin(), props.end());
+    return join(all, '\0', std::string(action) + "@" + devpath);
+  }
+
+  // the parser writes a NUL at buf[len], so keep a spare byte
+  std::vector<char> make_buffer(const std::string& str)
+  {
+    std::vector<char> buf(str.begin(), str.end());
+    buf.push_back('\0');
+    return buf;
+  }
+
+  void parse(IndicatorPowerUevent * uevent, std::vector<char>& buf, char separator)
+  {
+    indicator_power_uevent_parse(uevent, buf.data(), buf.size()-1, separator);
+  }
+
+  gint64 get_int(const IndicatorPowerUevent& uevent, IndicatorPowerUeventKey key)
+  {
+    gint64 i = -1;
+    EXPECT_TRUE(indicator_power_uevent_get_int(&uevent, key, &i));
+    return i;
+  }
+}
+
+/***
+****
+***/
+
+TEST(UeventTest, ParsesAttributeFile)
+{
+  auto buf = make_buffer(join(BAT0, '\n'));
+  IndicatorPowerUevent uevent;
+  parse(&uevent, buf, '\n');
+
+  EXPECT_STREQ("BAT0", uevent.name);
+  EXPECT_EQ(nullptr, uevent.action);
+  EXPECT_EQ(UP_DEVICE_KIND_BATTERY, uevent.kind);
+  EXPECT_EQ(UP_DEVICE_STATE_DISCHARGING, uevent.state);
+  EXPECT_FALSE(uevent.device_scope);
+  EXPECT_FALSE(indicator_power_uevent_has(&uevent, INDICATOR_POWER_UEVENT_SCOPE));
+  EXPECT_EQ(1, get_int(uevent, INDICATOR_POWER_UEVENT_PRESENT));
+  EXPECT_EQ(56, get_int(uevent, INDICATOR_POWER_UEVENT_CAPACITY));
+  EXPECT_EQ(28640000, get_int(uevent, INDICATOR_POWER_UEVENT_ENERGY_NOW));
+  EXPECT_EQ(50310000, get_int(uevent, INDICATOR_POWER_UEVENT_ENERGY_FULL));
+  EXPECT_EQ(57000000, get_int(uevent, INDICATOR_POWER_UEVENT_ENERGY_FULL_DESIGN));
+  EXPECT_EQ(8417000, get_int(uevent, INDICATOR_POWER_UEVENT_POWER_NOW));
+  EXPECT_EQ(11972000, get_int(uevent, INDICATOR_POWER_UEVENT_VOLTAGE_NOW));
+
+  // the strings point into the buffer
+  EXPECT_GE(uevent.name, buf.data());
+  EXPECT_LT(uevent.name, buf.data() + buf.size());
+
+  gint64 i;
+  EXPECT_FALSE(indicator_power_uevent_get_int(&uevent, INDICATOR_POWER_UEVENT_CHARGE_NOW, &i));
+  EXPECT_FALSE(indicator_power_uevent_get_int(&uevent, INDICATOR_POWER_UEVENT_TEMP, &i));
+}
+
+TEST(UeventTest, ParsesNetlinkMessage)
+{
+  auto buf = make_buffer(netlink_message("change", {
+    "POWER_SUPPLY_NAME=hidpp_battery_0",
+    "POWER_SUPPLY_TYPE=Battery",
+    "POWER_SUPPLY_SCOPE=Device",
+    "POWER_SUPPLY_STATUS=Charging",
+    "POWER_SUPPLY_CURRENT_NOW=-1250000"
+  }));
+  IndicatorPowerUevent uevent;
+  parse(&uevent, buf, '\0');
+
+  EXPECT_STREQ("change", uevent.action);
+  EXPECT_STREQ("power_supply", uevent.subsystem);
+  EXPECT_STREQ("/devices/LNXSYSTM:00/LNXSYBUS:00/PNP0C0A:00/power_supply/BAT0", uevent.devpath);
+  EXPECT_STREQ("hidpp_battery_0", uevent.name);
+  EXPECT_EQ(UP_DEVICE_STATE_CHARGING, uevent.state);
+  EXPECT_TRUE(uevent.device_scope);
+  EXPECT_EQ(-1250000, get_int(uevent, INDICATOR_POWER_UEVENT_CURRENT_NOW));
+}
+
+TEST(UeventTest, MapsTypesAndStatuses)
+{
+  const struct {
+    const char * type;
+    UpDeviceKind kind;
+  } types[] = {
+    { "Battery", UP_DEVICE_KIND_BATTERY },
+    { "UPS", UP_DEVICE_KIND_UPS },
+    { "Mains", UP_DEVICE_KIND_LINE_POWER },
+    { "USB", UP_DEVICE_KIND_LINE_POWER },
+    { "USB_PD", UP_DEVICE_KIND_LINE_POWER },
+    { "Wireless", UP_DEVICE_KIND_UNKNOWN },
+    { "Batteryx", UP_DEVICE_KIND_UNKNOWN },
+    { "", UP_DEVICE_KIND_UNKNOWN }
+  };
+  for (const auto& test : types)
+    EXPECT_EQ(test.kind, indicator_power_uevent_parse_type(test.type, strlen(test.type))) << test.type;
+
+  const struct {
+    const char * status;
+    UpDeviceState state;
+  } statuses[] = {
+    { "Charging", UP_DEVICE_STATE_CHARGING },
+    { "Discharging", UP_DEVICE_STATE_DISCHARGING },
+    { "Full", UP_DEVICE_STATE_FULLY_CHARGED },
+    { "Not charging", UP_DEVICE_STATE_PENDING_CHARGE },
+    { "Unknown", UP_DEVICE_STATE_UNKNOWN },
+    { "Fullish", UP_DEVICE_STATE_UNKNOWN }
+  };
+  for (const auto& test : statuses)
+    {
+      auto buf = make_buffer(std::string("POWER_SUPPLY_STATUS=") + test.status);
+      IndicatorPowerUevent uevent;
+      parse(&uevent, buf, '\n');
+      EXPECT_EQ(test.state, uevent.state) << test.status;
+    }
+}
+
+TEST(UeventTest, SkipsMalformedInput)
+{
+  auto buf = make_buffer(join({
+    "",
+    "NO_EQUALS_SIGN",
+    "=no key",
+    "POWER_SUPPLY_=empty key",
+    "POWER_SUPPLY_CAPACITY=12abc",
+    "POWER_SUPPLY_ENERGY_NOW=",
+    "POWER_SUPPLY_ENERGY_FULL=-",
+    "POWER_SUPPLY_POWER_NOW=99999999999999999999",
+    "POWER_SUPPLY_TEMP=+215",
+    "POWER_SUPPLY_NAME=a=b",
+    "power_supply_capacity=40"
+  }, '\n'));
+  IndicatorPowerUevent uevent;
+  parse(&uevent, buf, '\n');
+
+  EXPECT_FALSE(indicator_power_uevent_has(&uevent, INDICATOR_POWER_UEVENT_CAPACITY));
+  EXPECT_FALSE(indicator_power_uevent_has(&uevent, INDICATOR_POWER_UEVENT_ENERGY_NOW));
+  EXPECT_FALSE(indicator_power_uevent_has(&uevent, INDICATOR_POWER_UEVENT_ENERGY_FULL));
+  EXPECT_FALSE(indicator_power_uevent_has(&uevent, INDICATOR_POWER_UEVENT_POWER_NOW));
+  EXPECT_EQ(215, get_int(uevent, INDICATOR_POWER_UEVENT_TEMP));
+  EXPECT_STREQ("a=b", uevent.name);
+}
+
+TEST(UeventTest, LastLineNeedsNoSeparator)
+{
+  auto buf = make_buffer("POWER_SUPPLY_NAME=AC\nPOWER_SUPPLY_TYPE=Mains");
+  IndicatorPowerUevent uevent;
+  parse(&uevent, buf, '\n');
+
+  EXPECT_STREQ("AC", uevent.name);
+  EXPECT_EQ(UP_DEVICE_KIND_LINE_POWER, uevent.kind);
+}
+
+/* A cheap in-tree fuzz pass: parse randomly mutated and truncated
+   messages. Under ASan this catches reads or writes outside the buffer.
+   tests/fuzz-uevent.cc is the coverage-guided version. */
+TEST(UeventTest, MutatedInputIsSafe)
+{
+  const auto seed = netlink_message("change", BAT0);
+  std::mt19937 rng(20260412);
+  const char alphabet[] = { '\0', '\n', '=', '@', '-', '0', '9', 'P', '_' };
+
+  for (int i=0; i<20000; ++i)
+    {
+      std::string msg = seed.substr(0, rng() % (seed.size() + 1));
+      const auto n_mutations = rng() % 8;
+      for (size_t j=0; j<n_mutations && !msg.empty(); ++j)
+        msg[rng() % msg.size()] = (rng() & 1) ? char(rng()) : alphabet[rng() % sizeof(alphabet)];
+
+      // exactly-sized heap buffer so ASan sees any overrun
+      const auto len = msg.size();
+      auto buf = static_cast<char*>(g_malloc(len + 1));
+      memcpy(buf, msg.data(), len);
+
+      IndicatorPowerUevent uevent;
+      indicator_power_uevent_parse(&uevent, buf, len, (i & 1) ? '\n' : '\0');
+
+      for (const auto str : { uevent.action, uevent.devpath, uevent.subsystem, uevent.name })
+        if (str != nullptr)
+          {
+            ASSERT_GE(str, buf);
+            ASSERT_LE(str + strlen(str), buf + len);
+          }
+
+      g_free(buf);
+    }
+}
+
+/* Not a pass/fail test: prints how many messages per second each
+   approach handles, for comparing against the g_strsplit() version. */
+TEST(UeventTest, Throughput)
+{
+  const auto msg = netlink_message("change", BAT0);
+  const int n_iterations = 50000;
+  std::vector<char> buf(msg.size() + 1);
+  gint64 checksum = 0;
+
+  auto begin = std::chrono::steady_clock::now();
+  for (int i=0; i<n_iterations; ++i)
+    {
+      memcpy(buf.data(), msg.data(), msg.size());
+      IndicatorPowerUevent uevent;
+      indicator_power_uevent_parse(&uevent, buf.data(), msg.size(), '\0');
+      checksum += uevent.values[INDICATOR_POWER_UEVENT_ENERGY_NOW];
+    }
+  const std::chrono::duration<double> parser_secs = std::chrono::steady_clock::now() - begin;
+  EXPECT_EQ(gint64(n_iterations) * 28640000, checksum);
+
+  // the approach this replaced: split into strings, then look them up
+  checksum = 0;
+  begin = std::chrono::steady_clock::now();
+  for (int i=0; i<n_iterations; ++i)
+    {
+      auto props = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+      const char * const end = msg.data() + msg.size();
+      for (const char * line = msg.data(); line < end; line += strlen(line) + 1)
+        {
+          auto kv = g_strsplit(line, "=", 2);
+          if (kv[0] != nullptr && kv[1] != nullptr)
+            g_hash_table_insert(props, g_strdup(kv[0]), g_strdup(kv[1]));
+          g_strfreev(kv);
+        }
+      checksum += g_ascii_strtoll(static_cast<const char*>(g_hash_table_lookup(props, "POWER_SUPPLY_ENERGY_NOW")), nullptr, 10);
+      g_hash_table_destroy(props);
+    }
+  const std::chrono::duration<double> strsplit_secs = std::chrono::steady_clock::now() - begin;
+  EXPECT_EQ(gint64(n_iterations) * 28640000, checksum);
+
+  const auto mb = double(msg.size()) * n_iterations / (1024*1024);
+  std::cout << "in-place parser: " << int(n_iterations / parser_secs.count()) << " msgs/s, "
+            << int(mb / parser_secs.count()) << " MiB/s" << std::endl;
+  std::cout << "g_strsplit():    " << int(n_iterations / strsplit_secs.count()) << " msgs/s, "
+            << int(mb / strsplit_secs.count()) << " MiB/s" << std::endl;
+  RecordProperty("parser_msgs_per_sec", int(n_iterations / parser_secs.count()));
+  RecordProperty("strsplit_msgs_per_sec", int(n_iterations / strsplit_secs.count()));
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include <string>
+#include <vector>
+
+#define UPOWER_LOG_RECORD_TYPE "(ytssssvv)"
+#define UPOWER_LOG_TYPE "(sua" UPOWER_LOG_RECORD_TYPE ")"
+
+/**
+ * A capture of the D-Bus traffic between UPower (and logind) and a client.
+ *
+ * It's stored as one serialized GVariant of type UPOWER_LOG_TYPE:
+ * a magic string, a format version, then the records in time order.
+ * Each record is (kind, usec since the capture began, the service's
+ * well-known name, object path, interface, member, args, reply):
+ *
+ *  - 'c' is a method call. args are its parameters, reply is its answer.
+ *  - 's' is a signal. args are its parameters, reply is unused.
+ *
+ * Written by upower-record and replayed by UPowerReplay.
+ */
+class UPowerLog
+{
+public:
+
+  static constexpr const char * MAGIC = "ayatana-indicator-power/upower-log";
+  static constexpr guint32 VERSION = 1;
+
+  static constexpr char CALL = 'c';
+  static constexpr char SIGNAL = 's';
+
+  struct Record
+  {
+    char kind;
+    guint64 time;
+    std::string name;
+    std::string path;
+    std::string iface;
+    std::string member;
+    GVariant * args;  /* never floating or NULL */
+    GVariant * reply; /* never floating or NULL */
+  };
+
+  UPowerLog() =default;
+  UPowerLog(const UPowerLog&) =delete;
+  UPowerLog& operator=(const UPowerLog&) =delete;
+
+  ~UPowerLog()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    for (auto& record : m_records)
+      {
+        g_variant_unref(record.args);
+        g_variant_unref(record.reply);
+      }
+    m_records.clear();
+  }
+
+  const std::vector<Record>& records() const
+  {
+    return m_records;
+  }
+
+  /* args and reply may be floating or NULL */
+  void add(char kind, guint64 time, const char * name, const char * path,
+           const char * iface, const char * member, GVariant * args, GVariant * reply)
+  {
+    Record record;
+    record.kind = kind;
+    record.time = time;
+    record.name = name;
+    record.path = path;
+    record.iface = iface;
+    record.member = member;
+    record.args = g_variant_ref_sink(args ? args : g_variant_new("()"));
+    record.reply = g_variant_ref_sink(reply ? reply : g_variant_new("()"));
+
+    /* keep them in time order, even if a call's answer came in late */
+    auto it = m_records.end();
+    while ((it != m_records.begin()) && ((it-1)->time > time))
+      --it;
+    m_records.insert(it, record);
+  }
+
+  void add_call(guint64 time, const char * name, const char * path,
+                const char * iface, const char * member, GVariant * args, GVariant * reply)
+  {
+    add(CALL, time, name, path, iface, member, args, reply);
+  }
+
+  void add_signal(guint64 time, const char * name, const char * path,
+                  const char * iface, const char * member, GVariant * args)
+  {
+    add(SIGNAL, time, name, path, iface, member, args, nullptr);
+  }
+
+  /* Returns a new floating variant of type UPOWER_LOG_TYPE */
+  GVariant * serialize() const
+  {
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE("a" UPOWER_LOG_RECORD_TYPE));
+    for (const auto& r : m_records)
+      g_variant_builder_add(&b, UPOWER_LOG_RECORD_TYPE,
+                            guchar(r.kind), r.time,
+                            r.name.c_str(), r.path.c_str(),
+                            r.iface.c_str(), r.member.c_str(),
+                            r.args, r.reply);
+    return g_variant_new("(su@a" UPOWER_LOG_RECORD_TYPE ")", MAGIC, VERSION, g_variant_builder_end(&b));
+  }
+
+  bool save(const char * filename, GError ** error) const
+  {
+    auto v = g_variant_ref_sink(serialize());
+    const bool ok = g_file_set_contents(filename,
+                                        static_cast<const gchar*>(g_variant_get_data(v)),
+                                        gssize(g_variant_get_size(v)),
+                                        error);
+    g_variant_unref(v);
+    return ok;
+  }
+
+  bool load(GVariant * v)
+  {
+    clear();
+
+    const char * magic = nullptr;
+    guint32 version = 0;
+    GVariant * records = nullptr;
+    g_variant_get(v, "(&su@a" UPOWER_LOG_RECORD_TYPE ")", &magic, &version, &records);
+
+    const bool ok = !g_strcmp0(magic, MAGIC) && (version == VERSION);
+    if (ok)
+      {
+        GVariantIter iter;
+        guchar kind;
+        guint64 time;
+        const char * name;
+        const char * path;
+        const char * iface;
+        const char * member;
+        GVariant * args;
+        GVariant * reply;
+
+        g_variant_iter_init(&iter, records);
+        while (g_variant_iter_loop(&iter, "(yt&s&s&s&svv)", &kind, &time, &name, &path, &iface, &member, &args, &reply))
+          add(char(kind), time, name, path, iface, member, args, reply);
+      }
+
+    g_variant_unref(records);
+    return ok;
+  }
+
+  bool load(const char * filename, GError ** error)
+  {
+    gchar * contents = nullptr;
+    gsize length = 0;
+    if (!g_file_get_contents(filename, &contents, &length, error))
+      return false;
+
+    auto bytes = g_bytes_new_take(contents, length);
+    auto v = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(UPOWER_LOG_TYPE), bytes, FALSE));
+    const bool ok = load(v);
+    g_variant_unref(v);
+    g_bytes_unref(bytes);
+
+    if (!ok)
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a UPower log", filename);
+    return ok;
+  }
+
+  /* The log's duration, in usec */
+  guint64 duration() const
+  {
+    return m_records.empty() ? 0 : m_records.back().time;
+  }
+
+private:
+
+  std::vector<Record> m_records;
+};
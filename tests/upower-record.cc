@@ -0,0 +1,253 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Records UPower's traffic into a log that test-device-provider-upower
+ * can replay.
+ *
+ * It asks UPower for the same things the UPower device provider does,
+ * so that the replay can answer them: EnumerateDevices, then GetAll for
+ * each device, plus GetAll again whenever a device is added or changed
+ * or the system resumes. Along the way it logs UPower's signals and
+ * logind's PrepareForSleep. When it's done, it enumerates and fetches
+ * every device once more so that the log ends with the final state.
+ *
+ *   upower-record [-d seconds] log-file
+ *
+ * It stops after the given number of seconds, or on SIGINT.
+ */
+
+#include "upower-log.h"
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+
+#include <csignal>
+#include <cstdio>
+#include <set>
+#include <string>
+
+namespace
+{
+  const char * const UPOWER_NAME = "org.freedesktop.UPower";
+  const char * const UPOWER_PATH = "/org/freedesktop/UPower";
+  const char * const UPOWER_IFACE = "org.freedesktop.UPower";
+  const char * const DEVICE_IFACE = "org.freedesktop.UPower.Device";
+  const char * const PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
+
+  const char * const LOGIND_NAME = "org.freedesktop.login1";
+  const char * const LOGIND_PATH = "/org/freedesktop/login1";
+  const char * const LOGIND_IFACE = "org.freedesktop.login1.Manager";
+
+  struct Recorder
+  {
+    GDBusConnection * bus = nullptr;
+    GMainLoop * loop = nullptr;
+    UPowerLog log;
+    gint64 start_time = 0;
+    std::set<std::string> devices;
+  };
+
+  guint64 now(const Recorder& r)
+  {
+    return guint64(g_get_monotonic_time() - r.start_time);
+  }
+
+  GVariant * call(Recorder& r, const char * path, const char * iface, const char * member, GVariant * args, const GVariantType * reply_type)
+  {
+    GError * error = nullptr;
+    if (args != nullptr)
+      g_variant_ref_sink(args);
+    auto reply = g_dbus_connection_call_sync(r.bus, UPOWER_NAME, path, iface, member,
+                                             args, reply_type,
+                                             G_DBUS_CALL_FLAGS_NO_AUTO_START, -1,
+                                             nullptr, &error);
+    if (reply != nullptr)
+      {
+        r.log.add_call(now(r), UPOWER_NAME, path, iface, member, args, reply);
+      }
+    else
+      {
+        g_printerr("%s.%s on %s failed: %s\n", iface, member, path, error->message);
+        g_error_free(error);
+      }
+
+    if (args != nullptr)
+      g_variant_unref(args);
+    return reply;
+  }
+
+  void get_all(Recorder& r, const char * path)
+  {
+    auto reply = call(r, path, PROPERTIES_IFACE, "GetAll", g_variant_new("(s)", DEVICE_IFACE), G_VARIANT_TYPE("(a{sv})"));
+    g_clear_pointer(&reply, g_variant_unref);
+  }
+
+  void enumerate(Recorder& r)
+  {
+    auto reply = call(r, UPOWER_PATH, UPOWER_IFACE, "EnumerateDevices", nullptr, G_VARIANT_TYPE("(ao)"));
+    if (reply == nullptr)
+      return;
+
+    GVariantIter * iter = nullptr;
+    const char * path = nullptr;
+    r.devices.clear();
+    g_variant_get(reply, "(ao)", &iter);
+    while (g_variant_iter_loop(iter, "&o", &path))
+      r.devices.insert(path);
+    g_variant_iter_free(iter);
+    g_variant_unref(reply);
+
+    for (const auto& device : r.devices)
+      get_all(r, device.c_str());
+  }
+
+  const char * nth_path(GVariant * parameters, gsize i)
+  {
+    const char * path = nullptr;
+    if (g_variant_n_children(parameters) > i)
+      {
+        auto v = g_variant_get_child_value(parameters, i);
+        if (g_variant_is_of_type(v, G_VARIANT_TYPE_STRING) || g_variant_is_of_type(v, G_VARIANT_TYPE_OBJECT_PATH))
+          path = g_variant_get_string(v, nullptr);
+        g_variant_unref(v);
+      }
+    return path;
+  }
+
+  bool is_wakeup(const char * member, GVariant * parameters)
+  {
+    if (!g_strcmp0(member, "Resuming")) // UPower < 0.99
+      return true;
+
+    gboolean going_to_sleep = TRUE;
+    if (!g_strcmp0(member, "PrepareForSleep") && g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+      g_variant_get(parameters, "(b)", &going_to_sleep);
+    return !going_to_sleep;
+  }
+
+  void on_signal(GDBusConnection * connection G_GNUC_UNUSED,
+                 const gchar     * sender     G_GNUC_UNUSED,
+                 const gchar     * path,
+                 const gchar     * iface,
+                 const gchar     * member,
+                 GVariant        * parameters,
+                 gpointer          gr)
+  {
+    auto& r = *static_cast<Recorder*>(gr);
+    const bool is_logind = !g_strcmp0(iface, LOGIND_IFACE);
+
+    r.log.add_signal(now(r), is_logind ? LOGIND_NAME : UPOWER_NAME, path, iface, member, parameters);
+
+    // fetch what the provider would fetch in response
+    if (!g_strcmp0(member, "DeviceAdded") || !g_strcmp0(member, "DeviceChanged"))
+      {
+        const char * device = nth_path(parameters, 0);
+        if (device != nullptr)
+          {
+            r.devices.insert(device);
+            get_all(r, device);
+          }
+      }
+    else if (!g_strcmp0(member, "DeviceRemoved"))
+      {
+        const char * device = nth_path(parameters, 0);
+        if (device != nullptr)
+          r.devices.erase(device);
+      }
+    else if (is_wakeup(member, parameters))
+      {
+        for (const auto& device : r.devices)
+          get_all(r, device.c_str());
+      }
+  }
+
+  gboolean on_done(gpointer gr)
+  {
+    g_main_loop_quit(static_cast<Recorder*>(gr)->loop);
+    return G_SOURCE_REMOVE;
+  }
+}
+
+int
+main(int argc, char ** argv)
+{
+  gint seconds = 0;
+  GOptionEntry entries[] = {
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &seconds, "Stop after this many seconds", "SECONDS" },
+    { nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr }
+  };
+
+  GError * error = nullptr;
+  auto context = g_option_context_new("LOG-FILE - record UPower's D-Bus traffic");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  if (!g_option_context_parse(context, &argc, &argv, &error) || (argc != 2))
+    {
+      g_printerr("%s\n", error ? error->message : "expected one log file");
+      g_clear_error(&error);
+      g_option_context_free(context);
+      return 1;
+    }
+  g_option_context_free(context);
+
+  Recorder r;
+  r.bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, &error);
+  if (r.bus == nullptr)
+    {
+      g_printerr("unable to get the system bus: %s\n", error->message);
+      g_error_free(error);
+      return 1;
+    }
+
+  r.loop = g_main_loop_new(nullptr, FALSE);
+  r.start_time = g_get_monotonic_time();
+
+  const guint subscriptions[] = {
+    g_dbus_connection_signal_subscribe(r.bus, UPOWER_NAME, nullptr, nullptr, nullptr, nullptr,
+                                       G_DBUS_SIGNAL_FLAGS_NONE, on_signal, &r, nullptr),
+    g_dbus_connection_signal_subscribe(r.bus, LOGIND_NAME, LOGIND_IFACE, "PrepareForSleep", LOGIND_PATH, nullptr,
+                                       G_DBUS_SIGNAL_FLAGS_NONE, on_signal, &r, nullptr)
+  };
+
+  enumerate(r);
+
+  g_unix_signal_add(SIGINT, on_done, &r);
+  if (seconds > 0)
+    g_timeout_add_seconds(guint(seconds), on_done, &r);
+  g_main_loop_run(r.loop);
+
+  for (const auto& id : subscriptions)
+    g_dbus_connection_signal_unsubscribe(r.bus, id);
+
+  // end with the final state
+  enumerate(r);
+
+  int ret = 0;
+  if (!r.log.save(argv[1], &error))
+    {
+      g_printerr("unable to save %s: %s\n", argv[1], error->message);
+      g_error_free(error);
+      ret = 1;
+    }
+  else
+    {
+      g_print("%zu records over %.1f seconds\n", r.log.records().size(), r.log.duration() / double(G_USEC_PER_SEC));
+    }
+
+  g_main_loop_unref(r.loop);
+  g_object_unref(r.bus);
+  return ret;
+}
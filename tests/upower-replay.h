@@ -0,0 +1,281 @@
+/*
+ * Copyright 2026 AyatanaIndicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "upower-log.h"
+
+#include <gio/gio.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Plays back a UPowerLog on a bus connection, standing in for UPower.
+ *
+ * It owns every name that's in the log and answers method calls with
+ * the logged replies. When a call was logged more than once, the answer
+ * is the first one logged at or after the replay's position, or else the
+ * last one before it. Signals are emitted at their logged times, scaled
+ * by the replay speed, or back-to-back if the speed is 0.
+ *
+ * When the last signal's been emitted, a DONE_MEMBER signal is emitted
+ * on DONE_PATH. Since a connection dispatches signals in order, a client
+ * that sees it has also seen everything before it.
+ */
+class UPowerReplay
+{
+public:
+
+  static constexpr const char * DONE_PATH = "/org/ayatana/indicator/power/Replay";
+  static constexpr const char * DONE_IFACE = "org.ayatana.indicator.power.Replay";
+  static constexpr const char * DONE_MEMBER = "Done";
+
+  UPowerReplay(GDBusConnection * connection, const UPowerLog& log):
+    m_connection(G_DBUS_CONNECTION(g_object_ref(connection))),
+    m_log(log)
+  {
+    g_mutex_init(&m_mutex);
+
+    std::set<std::string> names { "org.freedesktop.UPower" };
+    for (const auto& record : m_log.records())
+      {
+        if (record.kind == UPowerLog::CALL)
+          m_calls[call_key(record.path.c_str(), record.iface.c_str(), record.member.c_str(), record.args)].push_back(&record);
+        else
+          ++m_n_signals;
+
+        names.insert(record.name);
+      }
+
+    m_filter_id = g_dbus_connection_add_filter(m_connection, on_message, this, nullptr);
+
+    for (const auto& name : names)
+      request_name(name.c_str());
+  }
+
+  UPowerReplay(const UPowerReplay&) =delete;
+  UPowerReplay& operator=(const UPowerReplay&) =delete;
+
+  ~UPowerReplay()
+  {
+    if (m_timer != 0)
+      g_source_remove(m_timer);
+
+    g_dbus_connection_remove_filter(m_connection, m_filter_id);
+    g_object_unref(m_connection);
+    g_mutex_clear(&m_mutex);
+  }
+
+  /* speed is a multiple of the original pace; 0 means as fast as possible */
+  void start(double speed)
+  {
+    m_speed = speed;
+    m_start_time = g_get_monotonic_time();
+
+    if (m_speed > 0)
+      schedule_next();
+    else
+      emit_until(G_MAXUINT64);
+  }
+
+  bool is_done() const { return m_done; }
+
+  size_t n_signals() const { return m_n_signals; }
+
+  size_t n_calls_answered() const { return size_t(g_atomic_int_get(&m_n_answered)); }
+
+  size_t n_calls_unanswered() const { return size_t(g_atomic_int_get(&m_n_unanswered)); }
+
+  /* when start() was called, from g_get_monotonic_time() */
+  gint64 start_time() const { return m_start_time; }
+
+private:
+
+  static std::string call_key(const char * path, const char * iface, const char * member, GVariant * args)
+  {
+    auto printed = g_variant_print(args, FALSE);
+    std::string key = std::string(path) + '\n' + iface + '\n' + member + '\n' + printed;
+    g_free(printed);
+    return key;
+  }
+
+  void request_name(const char * name)
+  {
+    GError * error = nullptr;
+    auto v = g_dbus_connection_call_sync(m_connection,
+                                         "org.freedesktop.DBus",
+                                         "/org/freedesktop/DBus",
+                                         "org.freedesktop.DBus",
+                                         "RequestName",
+                                         g_variant_new("(su)", name, 4u /* DBUS_NAME_FLAG_DO_NOT_QUEUE */),
+                                         G_VARIANT_TYPE("(u)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         nullptr,
+                                         &error);
+    if (error != nullptr)
+      {
+        g_warning("unable to own %s: %s", name, error->message);
+        g_error_free(error);
+      }
+    g_clear_pointer(&v, g_variant_unref);
+  }
+
+  /* runs in GDBus' worker thread */
+  GVariant * find_reply(const std::string& key)
+  {
+    auto it = m_calls.find(key);
+    if (it == m_calls.end())
+      return nullptr;
+
+    g_mutex_lock(&m_mutex);
+    const auto position = m_position;
+    g_mutex_unlock(&m_mutex);
+
+    for (const auto& record : it->second)
+      if (record->time >= position)
+        return record->reply;
+
+    return it->second.back()->reply;
+  }
+
+  /* runs in GDBus' worker thread */
+  static GDBusMessage * on_message(GDBusConnection * connection,
+                                   GDBusMessage    * message,
+                                   gboolean          incoming,
+                                   gpointer          gself)
+  {
+    if (!incoming || (g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL))
+      return message;
+
+    auto self = static_cast<UPowerReplay*>(gself);
+    auto args = g_dbus_message_get_body(message);
+    auto empty = g_variant_ref_sink(g_variant_new("()"));
+    const char * path = g_dbus_message_get_path(message);
+    const char * iface = g_dbus_message_get_interface(message);
+    const char * member = g_dbus_message_get_member(message);
+    auto reply_body = self->find_reply(call_key(path ? path : "",
+                                                iface ? iface : "",
+                                                member ? member : "",
+                                                args ? args : empty));
+    g_variant_unref(empty);
+
+    GDBusMessage * reply;
+    if (reply_body != nullptr)
+      {
+        reply = g_dbus_message_new_method_reply(message);
+        g_dbus_message_set_body(reply, reply_body);
+        g_atomic_int_inc(&self->m_n_answered);
+      }
+    else
+      {
+        reply = g_dbus_message_new_method_error(message,
+                                                "org.freedesktop.DBus.Error.UnknownMethod",
+                                                "%s.%s on %s isn't in the log",
+                                                iface, member, path);
+        g_atomic_int_inc(&self->m_n_unanswered);
+      }
+
+    g_dbus_connection_send_message(connection, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, nullptr, nullptr);
+    g_object_unref(reply);
+    g_object_unref(message);
+    return nullptr;
+  }
+
+  void set_position(guint64 position)
+  {
+    g_mutex_lock(&m_mutex);
+    m_position = position;
+    g_mutex_unlock(&m_mutex);
+  }
+
+  /* emits the signals logged up to log time 'until' */
+  void emit_until(guint64 until)
+  {
+    const auto& records = m_log.records();
+
+    for (; m_next < records.size() && records[m_next].time <= until; ++m_next)
+      {
+        const auto& record = records[m_next];
+
+        set_position(record.time);
+
+        if (record.kind == UPowerLog::SIGNAL)
+          g_dbus_connection_emit_signal(m_connection,
+                                        nullptr,
+                                        record.path.c_str(),
+                                        record.iface.c_str(),
+                                        record.member.c_str(),
+                                        record.args,
+                                        nullptr);
+      }
+
+    if (m_next >= records.size() && !m_done)
+      {
+        set_position(m_log.duration());
+        g_dbus_connection_emit_signal(m_connection, nullptr, DONE_PATH, DONE_IFACE, DONE_MEMBER, nullptr, nullptr);
+        m_done = true;
+      }
+  }
+
+  void schedule_next()
+  {
+    const auto& records = m_log.records();
+    if (m_next >= records.size())
+      {
+        emit_until(G_MAXUINT64);
+        return;
+      }
+
+    const auto due = m_start_time + gint64(records[m_next].time / m_speed);
+    const auto msec = MAX(gint64(0), (due - g_get_monotonic_time()) / 1000);
+    m_timer = g_timeout_add(guint(msec), on_timer, this);
+  }
+
+  static gboolean on_timer(gpointer gself)
+  {
+    auto self = static_cast<UPowerReplay*>(gself);
+
+    self->m_timer = 0;
+    self->emit_until(guint64((g_get_monotonic_time() - self->m_start_time) * self->m_speed));
+    if (!self->m_done)
+      self->schedule_next();
+
+    return G_SOURCE_REMOVE;
+  }
+
+  GDBusConnection * m_connection = nullptr;
+  const UPowerLog& m_log;
+
+  /* call key -> the logged calls, oldest first */
+  std::map<std::string,std::vector<const UPowerLog::Record*>> m_calls;
+
+  GMutex m_mutex;
+  guint64 m_position = 0; /* guarded by m_mutex */
+
+  guint m_filter_id = 0;
+  guint m_timer = 0;
+  size_t m_next = 0;
+  size_t m_n_signals = 0;
+  gint m_n_answered = 0;
+  gint m_n_unanswered = 0;
+  double m_speed = 0;
+  gint64 m_start_time = 0;
+  bool m_done = false;
+};